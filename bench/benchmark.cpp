@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "audio/fm_audio_source.h"
+#include "audio/keyboard.h"
+#include "audio/parameter/parameter_change_queue.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+/// Length of rendered audio in each rendering benchmark.
+constexpr double kRenderingSeconds{5.};
+
+/// Block sizes of rendering benchmarks.
+constexpr std::array<int, 6> kBlockSizes{32, 64, 128, 256, 512, 2048};
+
+/// Voice counts of rendering benchmarks.
+constexpr std::array<int, 4> kVoiceCounts{0, 1, 6, 12};
+
+/// The number of MIDI messages reserved in a block of MIDI benchmarks.
+constexpr int kMessagesPerBlock{256};
+
+/// The number of blocks of MIDI benchmarks.
+constexpr int kMidiBlockCount{1000};
+
+/// Block size of MIDI benchmarks.
+constexpr int kMidiBlockSize{512};
+
+/// The number of operations of keyboard and queue benchmarks.
+constexpr std::uint64_t kOperationCount{1'000'000};
+
+/// Lowest note number used to note on.
+constexpr int kBaseNoteNumber{36};
+
+/**
+ * @brief Result of a benchmark.
+ */
+struct Result {
+  std::string name;                  ///< Benchmark name.
+  int blockSize{};                   ///< Block size, or 0 if not applicable.
+  int voiceCount{};                  ///< The number of sounding voices.
+  std::uint64_t iterationCount{};    ///< The number of measured iterations.
+  double nanosecondsPerIteration{};  ///< Average time of an iteration.
+  double realtimeFactor{};  ///< Audio time per wall time, or 0 if unused.
+};
+
+/**
+ * @brief Get elapsed time in nanoseconds.
+ * @param[in] begin Start time.
+ * @return Nanoseconds from @c begin.
+ */
+double elapsedNanoseconds(Clock::time_point begin) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - begin)
+      .count();
+}
+
+/**
+ * @brief Note on voices and apply them immediately.
+ * @param[in] source Audio source.
+ * @param[in] voiceCount The number of voices.
+ */
+void noteOnVoices(audio::FmAudioSource& source, int voiceCount) {
+  for (int i = 0; i < voiceCount; ++i) {
+    source.tryReserveChangeFromMidiMessage(
+        juce::MidiMessage::noteOn(1, kBaseNoteNumber + i, std::uint8_t{100}));
+  }
+  source.triggerReservedChanges();
+}
+
+/**
+ * @brief Measure throughput of @c getNextAudioBlock().
+ * @param[in] blockSize Block size.
+ * @param[in] voiceCount The number of sounding voices.
+ * @return Result.
+ */
+Result benchmarkRendering(int blockSize, int voiceCount) {
+  audio::FmAudioSource source(audio::FmAudioSource::kDefaultChipCount);
+  const double rate = source.synthesisRate();
+  source.prepareToPlay(blockSize, rate);
+  noteOnVoices(source, voiceCount);
+
+  juce::AudioBuffer<float> buffer(2, blockSize);
+  const juce::AudioSourceChannelInfo channelInfo(&buffer, 0, blockSize);
+
+  // Warm up caches and let envelopes pass their attack.
+  for (int i = 0; i < 16; ++i) {
+    source.getNextAudioBlock(channelInfo);
+  }
+
+  const auto blockCount =
+      static_cast<std::uint64_t>(kRenderingSeconds * rate / blockSize) + 1u;
+  const auto begin = Clock::now();
+  for (std::uint64_t i = 0; i < blockCount; ++i) {
+    source.getNextAudioBlock(channelInfo);
+  }
+  const double elapsed = elapsedNanoseconds(begin);
+
+  const double audioNanoseconds = blockCount * blockSize / rate * 1e9;
+  return {.name{"render"},
+          .blockSize{blockSize},
+          .voiceCount{voiceCount},
+          .iterationCount{blockCount},
+          .nanosecondsPerIteration{elapsed / blockCount},
+          .realtimeFactor{audioNanoseconds / elapsed}};
+}
+
+/**
+ * @brief Measure latency of @c tryReserveChangeFromMidiMessage().
+ * @details Messages are reserved at consecutive samples and drained by
+ * rendering a block, which is not measured.
+ * @param[in] name Benchmark name.
+ * @param[in] voiceCount The number of voices held during the benchmark.
+ * @param[in] messageAt Function to make the n-th message.
+ * @return Result.
+ */
+template <class F>
+Result benchmarkMidi(const char* name, int voiceCount, F&& messageAt) {
+  audio::FmAudioSource source(audio::FmAudioSource::kDefaultChipCount);
+  source.prepareToPlay(kMidiBlockSize, source.synthesisRate());
+  noteOnVoices(source, voiceCount);
+
+  std::vector<ymfm::ym2608::output_data> output(kMidiBlockSize);
+  std::vector<juce::MidiMessage> messages;
+  messages.reserve(kMessagesPerBlock);
+
+  double elapsed{};
+  std::uint64_t index{};
+  for (int block = 0; block < kMidiBlockCount; ++block) {
+    messages.clear();
+    for (int i = 0; i < kMessagesPerBlock; ++i) {
+      messages.push_back(messageAt(index++));
+    }
+
+    const std::uint64_t top = source.renderedSampleCount();
+    const auto begin = Clock::now();
+    for (int i = 0; i < kMessagesPerBlock; ++i) {
+      source.setReservationTimestamp(top + static_cast<std::uint64_t>(i));
+      source.tryReserveChangeFromMidiMessage(messages[i]);
+    }
+    elapsed += elapsedNanoseconds(begin);
+
+    source.render(output.data(), output.size());
+  }
+
+  return {.name{name},
+          .voiceCount{voiceCount},
+          .iterationCount{index},
+          .nanosecondsPerIteration{elapsed / index}};
+}
+
+/**
+ * @brief Measure note-on and -off of @c Keyboard.
+ * @param[in] name Benchmark name.
+ * @param[in] polyphony Polyphony.
+ * @param[in] policy Policy to steal voices.
+ * @return Result.
+ */
+Result benchmarkKeyboard(const char* name, int polyphony,
+                         audio::StealPolicy policy) {
+  audio::Keyboard keyboard(static_cast<std::size_t>(polyphony));
+  keyboard.setStealPolicy(policy);
+  std::array<audio::NoteAssignment, audio::Keyboard::kMaxNoteOnChangeCount>
+      changes;
+
+  // Note on twice as many notes as polyphony to steal voices.
+  const auto begin = Clock::now();
+  std::uint64_t checksum{};
+  for (std::uint64_t i = 0; i < kOperationCount; i += 2u) {
+    const int noteNumber =
+        kBaseNoteNumber + static_cast<int>(i / 2u % (polyphony * 2));
+    const auto velocity = static_cast<std::uint8_t>(1u + i % 127u);
+    // Levels are pseudo-random as envelopes of voices progress.
+    const auto assignId = static_cast<std::size_t>(i / 2u % polyphony);
+    keyboard.setLevel(assignId, static_cast<std::uint8_t>(assignId * 37u + i));
+    checksum += keyboard
+                    .tryNoteOn(audio::Note::noteOn(1, noteNumber, velocity),
+                               changes)
+                    .size();
+    if (const auto noteOff = keyboard.tryNoteOff(
+            audio::Note::noteOff(1, noteNumber - polyphony))) {
+      checksum += noteOff->assignId;
+    }
+  }
+  const double elapsed = elapsedNanoseconds(begin);
+
+  // Keep the loop from being optimized out.
+  if (checksum == ~std::uint64_t{}) {
+    std::fputs("", stderr);
+  }
+
+  return {.name{name},
+          .voiceCount{polyphony},
+          .iterationCount{kOperationCount},
+          .nanosecondsPerIteration{elapsed / kOperationCount}};
+}
+
+/**
+ * @brief Measure enqueue and dequeue of @c ParameterChangeQueue.
+ * @details Each round enqueues changes of all slot parameters and then drains
+ * the queue, which follows the way the processor uses it.
+ * @return Result.
+ */
+Result benchmarkParameterQueue() {
+  namespace ap = audio::parameter;
+
+  audio::parameter::ParameterChangeQueue queue;
+  std::uint64_t count{};
+  std::uint64_t checksum{};
+
+  const auto begin = Clock::now();
+  while (count < kOperationCount) {
+    for (std::size_t slot = 0; slot < audio::kSlotCount; ++slot) {
+      const auto value = static_cast<int>(count % 128u);
+      queue.enqueue(ap::SlotAndValue{
+          slot, ap::parameterCast<ap::TotalLevelValue>(value)});
+      queue.enqueue(ap::SlotAndValue{
+          slot, ap::parameterCast<ap::AttackRateValue>(value % 32)});
+      queue.enqueue(ap::SlotAndValue{
+          slot, ap::parameterCast<ap::MultipleValue>(value % 16)});
+      count += 3u;
+    }
+    queue.enqueue(ap::parameterCast<ap::FeedbackValue>(count % 8u));
+    ++count;
+
+    while (!queue.empty()) {
+      checksum += queue.dequeue().index();
+    }
+  }
+  const double elapsed = elapsedNanoseconds(begin);
+
+  if (checksum == ~std::uint64_t{}) {
+    std::fputs("", stderr);
+  }
+
+  return {.name{"parameter_queue_enqueue_dequeue"},
+          .iterationCount{count},
+          .nanosecondsPerIteration{elapsed / count}};
+}
+
+/**
+ * @brief Print results as CSV.
+ * @param[in] results Results.
+ */
+void printCsv(const std::vector<Result>& results) {
+  std::puts(
+      "name,block_size,voice_count,iterations,ns_per_iteration,"
+      "realtime_factor");
+  for (const auto& result : results) {
+    std::printf("%s,%d,%d,%llu,%.3f,%.3f\n", result.name.c_str(),
+                result.blockSize, result.voiceCount,
+                static_cast<unsigned long long>(result.iterationCount),
+                result.nanosecondsPerIteration, result.realtimeFactor);
+  }
+}
+
+/**
+ * @brief Print results as JSON.
+ * @param[in] results Results.
+ */
+void printJson(const std::vector<Result>& results) {
+  std::puts("[");
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const auto& result = results[i];
+    std::printf(
+        "  {\"name\": \"%s\", \"block_size\": %d, \"voice_count\": %d, "
+        "\"iterations\": %llu, \"ns_per_iteration\": %.3f, "
+        "\"realtime_factor\": %.3f}%s\n",
+        result.name.c_str(), result.blockSize, result.voiceCount,
+        static_cast<unsigned long long>(result.iterationCount),
+        result.nanosecondsPerIteration, result.realtimeFactor,
+        i + 1u < results.size() ? "," : "");
+  }
+  std::puts("]");
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool isJson = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg(argv[i]);
+    if (arg == "--json") {
+      isJson = true;
+    } else if (arg == "--csv") {
+      isJson = false;
+    } else {
+      std::fprintf(stderr, "Usage: %s [--csv | --json]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<Result> results;
+
+  for (const int blockSize : kBlockSizes) {
+    for (const int voiceCount : kVoiceCounts) {
+      results.push_back(benchmarkRendering(blockSize, voiceCount));
+    }
+  }
+
+  results.push_back(
+      benchmarkMidi("midi_dense_notes", 0, [](std::uint64_t index) {
+        // Note on and off alternately over two octaves.
+        const int noteNumber =
+            kBaseNoteNumber + static_cast<int>(index / 2u % 24u);
+        return index % 2u ? juce::MidiMessage::noteOff(1, noteNumber)
+                          : juce::MidiMessage::noteOn(1, noteNumber,
+                                                      std::uint8_t{100});
+      }));
+
+  results.push_back(
+      benchmarkMidi("midi_pitch_wheel_storm", 12, [](std::uint64_t index) {
+        // Sweep the whole range of pitch bend.
+        return juce::MidiMessage::pitchWheel(
+            1, static_cast<int>(index * 127u % 16384u));
+      }));
+
+  results.push_back(benchmarkKeyboard("keyboard_note_on_off", 12,
+                                      audio::StealPolicy::Oldest));
+  results.push_back(benchmarkKeyboard("keyboard_steal_lowest_velocity", 12,
+                                      audio::StealPolicy::LowestVelocity));
+  results.push_back(benchmarkKeyboard("keyboard_steal_quietest", 12,
+                                      audio::StealPolicy::Quietest));
+  results.push_back(benchmarkParameterQueue());
+
+  if (isJson) {
+    printJson(results);
+  } else {
+    printCsv(results);
+  }
+
+  return 0;
+}
@@ -0,0 +1,390 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "audio/fm_audio_source.h"
+#include "audio/midi_event_batch.h"
+#include "audio/parameter/state_chunk.h"
+#include "audio/patch_bank.h"
+#include "audio/polyphase_resampler.h"
+#include "audio/register_trace.h"
+#include "audio/sample_conversion.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+/// The number of frames rendered and written to a file at once.
+constexpr int kChunkFrameCount{1 << 15};
+
+/// Size of the buffer of an output stream in bytes.
+constexpr std::size_t kStreamBufferSize{std::size_t{1} << 20};
+
+/// The number of output channels.
+constexpr unsigned int kChannelCount{2};
+
+/// Bit depth of WAV files.
+constexpr int kBitsPerSample{24};
+
+/**
+ * @brief Settings shared by all rendering jobs.
+ */
+struct Settings {
+  /// Patch applied before rendering, or @c std::nullopt to use the default.
+  std::optional<audio::PatchBank::Patch> patch;
+
+  /// Patches switched by program change, or @c nullptr to ignore it.
+  std::unique_ptr<audio::PatchBank> bank;
+
+  /// Directory of WAV files. If it is empty, they are put next to inputs.
+  juce::File outputDirectory;
+
+  double sampleRate{48000.};  ///< Sample rate of WAV files.
+  double tailSeconds{2.};     ///< Length rendered after the last event.
+
+  /// The number of emulator instances.
+  std::size_t chipCount{audio::FmAudioSource::kDefaultChipCount};
+
+  /// Whether register writes are recorded next to WAV files.
+  bool isTraceEnabled{};
+
+  /// Output stage applied before resampling.
+  audio::sample_conversion::OutputStageSettings outputStage;
+};
+
+/**
+ * @brief Print usage.
+ * @param[in] command Name of the command.
+ */
+void printUsage(const char* command) {
+  std::fprintf(stderr,
+               "Usage: %s [options] <input.mid>...\n"
+               "  --patch <file>       Patch file applied before rendering\n"
+               "  --bank <directory>   Patch files switched by program "
+               "change\n"
+               "  --output-dir <dir>   Directory of WAV files (default: next "
+               "to inputs)\n"
+               "  --rate <hz>          Sample rate (default: 48000)\n"
+               "  --tail <seconds>     Length after the last event (default: "
+               "2)\n"
+               "  --jobs <n>           Files rendered in parallel, 0 for all "
+               "cores (default: 1)\n"
+               "  --chips <n>          Emulator instances, 6 voices each "
+               "(default: 2)\n"
+               "  --trace              Record register writes to .opntrace "
+               "files\n"
+               "  --gain <db>          Master gain (default: 0)\n"
+               "  --dc-blocker         Remove DC offset\n"
+               "  --soft-clip          Saturate peaks smoothly\n",
+               command);
+}
+
+/**
+ * @brief Load a patch from a file.
+ * @param[in] file Patch file which has a binary state chunk.
+ * @return Patch, or @c std::nullopt if the file cannot be decoded.
+ */
+std::optional<audio::PatchBank::Patch> loadPatch(const juce::File& file) {
+  juce::MemoryBlock data;
+  if (!file.loadFileAsData(data)) {
+    return std::nullopt;
+  }
+
+  const auto chunk =
+      audio::parameter::decode(data.getData(), data.getSize());
+  if (!chunk) {
+    return std::nullopt;
+  }
+
+  return audio::PatchBank::Patch{
+      .name{file.getFileNameWithoutExtension()},
+      .parameters{chunk->fmParameters},
+      .image{audio::ToneRegisterImage(chunk->fmParameters)}};
+}
+
+/**
+ * @brief Read all tracks of a MIDI file into a sequence.
+ * @param[in] file MIDI file.
+ * @return Events sorted by time in seconds, or @c std::nullopt if the file
+ * cannot be read.
+ */
+std::optional<juce::MidiMessageSequence> readSequence(const juce::File& file) {
+  juce::FileInputStream stream(file);
+  juce::MidiFile midiFile;
+  if (!stream.openedOk() || !midiFile.readFrom(stream)) {
+    return std::nullopt;
+  }
+  midiFile.convertTimestampTicksToSeconds();
+
+  juce::MidiMessageSequence sequence;
+  for (int i = 0; i < midiFile.getNumTracks(); ++i) {
+    sequence.addSequence(*midiFile.getTrack(i), 0.);
+  }
+  sequence.sort();
+
+  return sequence;
+}
+
+/**
+ * @brief Render a MIDI file into a WAV file.
+ * @details Samples are written every @c kChunkFrameCount frames, so memory
+ * does not grow with the length of the file. Events in a chunk are reserved
+ * with their timestamps before the chunk is rendered at once.
+ * @param[in] input MIDI file.
+ * @param[in] output WAV file. It is overwritten, and so is a trace file next
+ * to it if tracing is enabled.
+ * @param[in] settings Settings.
+ * @param[in] isParallelRenderingEnabled Whether chips are rendered on worker
+ * threads.
+ * @return @c true if the file is rendered.
+ */
+bool render(const juce::File& input, const juce::File& output,
+            const Settings& settings, bool isParallelRenderingEnabled) {
+  const auto sequence = readSequence(input);
+  if (!sequence) {
+    std::fprintf(stderr, "Cannot read %s\n",
+                 input.getFullPathName().toRawUTF8());
+    return false;
+  }
+
+  output.deleteFile();
+  auto stream =
+      std::make_unique<juce::FileOutputStream>(output, kStreamBufferSize);
+  if (!stream->openedOk()) {
+    std::fprintf(stderr, "Cannot open %s\n",
+                 output.getFullPathName().toRawUTF8());
+    return false;
+  }
+
+  juce::WavAudioFormat format;
+  std::unique_ptr<juce::AudioFormatWriter> writer(
+      format.createWriterFor(stream.get(), settings.sampleRate, kChannelCount,
+                             kBitsPerSample, {}, 0));
+  if (!writer) {
+    std::fprintf(stderr, "Cannot write WAV to %s\n",
+                 output.getFullPathName().toRawUTF8());
+    return false;
+  }
+  // The writer owns the stream from now on.
+  stream.release();
+
+  // The recorder outlives the audio source which refers to it.
+  audio::RegisterTraceRecorder recorder;
+  audio::FmAudioSource source(settings.chipCount);
+  if (isParallelRenderingEnabled) {
+    source.spawnWorkers();
+    source.setParallelRenderingEnabled(true);
+  }
+
+  // The resampler prepares the audio source at synthesis rate.
+  audio::PolyphaseResampler resampler(
+      &source, audio::PolyphaseResampler::kHighQualityTapCount);
+  resampler.prepareToPlay(kChunkFrameCount, settings.sampleRate);
+  resampler.setOutputStage(settings.outputStage);
+
+  if (settings.patch) {
+    source.applyPatch(settings.patch->parameters, settings.patch->image);
+    source.triggerReservedChanges();
+  }
+
+  const auto traceFile = output.withFileExtension(".opntrace");
+  if (settings.isTraceEnabled) {
+    if (!recorder.start(traceFile, source.traceFormat())) {
+      std::fprintf(stderr, "Cannot open %s\n",
+                   traceFile.getFullPathName().toRawUTF8());
+      return false;
+    }
+    source.setTraceRecorder(&recorder);
+  }
+
+  const auto frameCount = static_cast<std::int64_t>(std::ceil(
+      (sequence->getEndTime() + settings.tailSeconds) * settings.sampleRate));
+
+  const auto begin = Clock::now();
+  juce::AudioBuffer<float> buffer(kChannelCount, kChunkFrameCount);
+  int eventIndex{};
+  for (std::int64_t top = 0; top < frameCount; top += kChunkFrameCount) {
+    const auto chunkFrameCount = static_cast<int>(
+        std::min<std::int64_t>(kChunkFrameCount, frameCount - top));
+
+    for (; eventIndex < sequence->getNumEvents(); ++eventIndex) {
+      const auto& message = sequence->getEventPointer(eventIndex)->message;
+      const auto position = std::max(
+          top, static_cast<std::int64_t>(message.getTimeStamp() *
+                                         settings.sampleRate));
+      if (top + chunkFrameCount <= position) {
+        break;
+      }
+
+      source.setReservationTimestamp(
+          resampler.sourceFrameAt(static_cast<std::size_t>(position - top)));
+
+      if (message.isProgramChange()) {
+        if (settings.bank) {
+          const auto& patch = settings.bank->patch(
+              static_cast<std::size_t>(message.getProgramChangeNumber()));
+          source.applyPatch(patch.parameters, patch.image);
+        }
+        continue;
+      }
+
+      if (const auto event = audio::MidiEvent::decode(
+              message.getRawData(), message.getRawDataSize(), 0)) {
+        source.tryReserveMidiEvent(event.value());
+      }
+    }
+
+    const juce::AudioSourceChannelInfo channelInfo(&buffer, 0,
+                                                   chunkFrameCount);
+    resampler.getNextAudioBlock(channelInfo);
+
+    if (!writer->writeFromAudioSampleBuffer(buffer, 0, chunkFrameCount)) {
+      std::fprintf(stderr, "Cannot write %s\n",
+                   output.getFullPathName().toRawUTF8());
+      return false;
+    }
+  }
+
+  const double elapsedSeconds =
+      std::chrono::duration<double>(Clock::now() - begin).count();
+
+  if (settings.isTraceEnabled) {
+    source.setTraceRecorder(nullptr);
+    recorder.stop();
+    if (const auto count = recorder.droppedWriteCount()) {
+      std::fprintf(stderr, "%llu writes are missing in %s\n",
+                   static_cast<unsigned long long>(count),
+                   traceFile.getFullPathName().toRawUTF8());
+    }
+  }
+
+  std::printf("%s -> %s (%.1fx realtime)\n",
+              input.getFullPathName().toRawUTF8(),
+              output.getFullPathName().toRawUTF8(),
+              frameCount / settings.sampleRate /
+                  std::max(elapsedSeconds, 1e-9));
+
+  return true;
+}
+
+/**
+ * @brief Get the WAV file of an input.
+ * @param[in] input MIDI file.
+ * @param[in] settings Settings.
+ * @return WAV file.
+ */
+juce::File outputFileOf(const juce::File& input, const Settings& settings) {
+  if (settings.outputDirectory == juce::File()) {
+    return input.withFileExtension(".wav");
+  }
+  return settings.outputDirectory.getChildFile(
+      input.getFileNameWithoutExtension() + ".wav");
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Settings settings;
+  std::vector<juce::File> inputs;
+  unsigned int jobCount{1};
+
+  const auto currentDirectory = juce::File::getCurrentWorkingDirectory();
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg(argv[i]);
+    const bool hasValue = i + 1 < argc;
+
+    if (arg == "--patch" && hasValue) {
+      const auto file = currentDirectory.getChildFile(argv[++i]);
+      settings.patch = loadPatch(file);
+      if (!settings.patch) {
+        std::fprintf(stderr, "Cannot load patch %s\n",
+                     file.getFullPathName().toRawUTF8());
+        return 1;
+      }
+    } else if (arg == "--bank" && hasValue) {
+      settings.bank = std::make_unique<audio::PatchBank>();
+      settings.bank->loadDirectory(currentDirectory.getChildFile(argv[++i]));
+    } else if (arg == "--output-dir" && hasValue) {
+      settings.outputDirectory = currentDirectory.getChildFile(argv[++i]);
+    } else if (arg == "--rate" && hasValue) {
+      settings.sampleRate = std::strtod(argv[++i], nullptr);
+    } else if (arg == "--tail" && hasValue) {
+      settings.tailSeconds = std::max(0., std::strtod(argv[++i], nullptr));
+    } else if (arg == "--jobs" && hasValue) {
+      jobCount =
+          static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--chips" && hasValue) {
+      using ChipCount = audio::parameter::ChipCountValue;
+      settings.chipCount = std::clamp<std::size_t>(
+          std::strtoul(argv[++i], nullptr, 10), ChipCount::kMinimum,
+          ChipCount::kMaximum);
+    } else if (arg == "--trace") {
+      settings.isTraceEnabled = true;
+    } else if (arg == "--gain" && hasValue) {
+      settings.outputStage.gainDecibels = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--dc-blocker") {
+      settings.outputStage.isDcBlockerEnabled = true;
+    } else if (arg == "--soft-clip") {
+      settings.outputStage.isSoftClipEnabled = true;
+    } else if (!arg.empty() && arg.front() != '-') {
+      inputs.push_back(currentDirectory.getChildFile(argv[i]));
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (inputs.empty() || settings.sampleRate <= 0.) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (settings.outputDirectory != juce::File() &&
+      !settings.outputDirectory.createDirectory()) {
+    std::fprintf(stderr, "Cannot create %s\n",
+                 settings.outputDirectory.getFullPathName().toRawUTF8());
+    return 1;
+  }
+
+  if (!jobCount) {
+    jobCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  jobCount = std::min(jobCount, static_cast<unsigned int>(inputs.size()));
+
+  // Each job has its own engine. A single job renders chips in parallel
+  // instead.
+  const bool isParallelRenderingEnabled = jobCount == 1u;
+  std::atomic_size_t nextInput{};
+  std::atomic_bool isFailed{};
+  const auto work = [&] {
+    for (std::size_t i = nextInput++; i < inputs.size(); i = nextInput++) {
+      if (!render(inputs[i], outputFileOf(inputs[i], settings), settings,
+                  isParallelRenderingEnabled)) {
+        isFailed = true;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int i = 1; i < jobCount; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  return isFailed ? 1 : 0;
+}
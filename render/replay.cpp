@@ -0,0 +1,274 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include <JuceHeader.h>
+#include <ymfm_opn.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "audio/fm_chip.h"
+#include "audio/register_trace.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+/// The number of samples rendered at once.
+constexpr std::size_t kBlockSampleCount{1024};
+
+/// Sample rate of waits in VGM.
+constexpr std::uint64_t kVgmSampleRate{44100};
+
+/// Size of a VGM 1.51 header in bytes.
+constexpr std::size_t kVgmHeaderSize{0x80};
+
+/// The number of chips which VGM can hold.
+constexpr std::uint8_t kMaxVgmChipCount{2};
+
+/// Initial value of FNV-1a hash.
+constexpr std::uint64_t kFnvOffsetBasis{0xcbf29ce484222325u};
+
+/// Multiplier of FNV-1a hash.
+constexpr std::uint64_t kFnvPrime{0x100000001b3u};
+
+/**
+ * @brief Print usage.
+ * @param[in] command Name of the command.
+ */
+void printUsage(const char* command) {
+  std::fprintf(stderr,
+               "Usage: %s [options] <input.opntrace>\n"
+               "  --tail <seconds>     Length after the last write (default: "
+               "2)\n"
+               "  --vgm <file>         Export writes to a VGM file\n",
+               command);
+}
+
+/**
+ * @brief Mix a 32-bit value into FNV-1a hash.
+ * @param[in] seed Current hash.
+ * @param[in] value Value.
+ * @return New hash.
+ */
+std::uint64_t fnv1a(std::uint64_t seed, std::int32_t value) noexcept {
+  const auto bits = static_cast<std::uint32_t>(value);
+  for (std::size_t i = 0; i < 4; ++i) {
+    seed = (seed ^ ((bits >> (8u * i)) & 0xffu)) * kFnvPrime;
+  }
+  return seed;
+}
+
+/**
+ * @brief Append waits to VGM commands.
+ * @param[out] commands Commands.
+ * @param[in] sampleCount Length of waits in VGM samples.
+ */
+void appendVgmWait(std::vector<std::uint8_t>& commands,
+                   std::uint64_t sampleCount) {
+  while (sampleCount) {
+    if (sampleCount <= 16u) {
+      commands.push_back(static_cast<std::uint8_t>(0x70u + sampleCount - 1u));
+      return;
+    }
+
+    const auto count = std::min<std::uint64_t>(sampleCount, 0xffffu);
+    commands.insert(commands.end(), {0x61u, static_cast<std::uint8_t>(count),
+                                     static_cast<std::uint8_t>(count >> 8u)});
+    sampleCount -= count;
+  }
+}
+
+/**
+ * @brief Export writes of a trace to a VGM 1.51 file.
+ * @param[in] trace Trace, which has at most 2 chips.
+ * @param[in] origin Sample index of the top of the file.
+ * @param[in] endSampleIndex Sample index of the end of the file.
+ * @param[in] file VGM file. It is overwritten.
+ * @return @c true if the file is written.
+ */
+bool exportVgm(const audio::RegisterTrace& trace, std::uint64_t origin,
+               std::uint64_t endSampleIndex, const juce::File& file) {
+  const auto toVgmSample = [&](std::uint64_t sampleIndex) {
+    return (sampleIndex - origin) * kVgmSampleRate / trace.format.sampleRate;
+  };
+
+  // Writes of different chips are merged in the order of time.
+  auto writes = trace.writes;
+  std::stable_sort(writes.begin(), writes.end(),
+                   [](const auto& a, const auto& b) {
+                     return a.sampleIndex < b.sampleIndex;
+                   });
+
+  std::vector<std::uint8_t> data(kVgmHeaderSize);
+  std::uint64_t position{};
+  for (const auto& write : writes) {
+    const auto time = toVgmSample(write.sampleIndex);
+    appendVgmWait(data, time - position);
+    position = time;
+
+    // 0x56 and 0x57 are ports of the first chip, and 0xa6 and 0xa7 are ones of
+    // the second.
+    const auto command = static_cast<std::uint8_t>(
+        (write.chip ? 0xa6u : 0x56u) + (write.change.pinA1 ? 1u : 0u));
+    data.insert(data.end(),
+                {command, write.change.address, write.change.data});
+  }
+  const auto totalSampleCount = toVgmSample(endSampleIndex);
+  appendVgmWait(data, totalSampleCount - position);
+  data.push_back(0x66u);
+
+  const auto put32 = [&data](std::size_t offset, std::uint32_t value) {
+    for (std::size_t i = 0; i < 4; ++i) {
+      data[offset + i] = static_cast<std::uint8_t>(value >> (8u * i));
+    }
+  };
+  data[0] = 'V';
+  data[1] = 'g';
+  data[2] = 'm';
+  data[3] = ' ';
+  put32(0x04, static_cast<std::uint32_t>(data.size() - 0x04));
+  put32(0x08, 0x151u);
+  put32(0x18, static_cast<std::uint32_t>(totalSampleCount));
+  put32(0x34, static_cast<std::uint32_t>(kVgmHeaderSize - 0x34));
+  // Bit 30 of the clock enables the second chip.
+  put32(0x48,
+        trace.format.clockHz |
+            (trace.format.chipCount == kMaxVgmChipCount ? 1u << 30u : 0u));
+
+  return file.replaceWithData(data.data(), data.size());
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::optional<juce::File> input;
+  std::optional<juce::File> vgmFile;
+  double tailSeconds{2.};
+
+  const auto currentDirectory = juce::File::getCurrentWorkingDirectory();
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg(argv[i]);
+    const bool hasValue = i + 1 < argc;
+
+    if (arg == "--tail" && hasValue) {
+      tailSeconds = std::max(0., std::strtod(argv[++i], nullptr));
+    } else if (arg == "--vgm" && hasValue) {
+      vgmFile = currentDirectory.getChildFile(argv[++i]);
+    } else if (!arg.empty() && arg.front() != '-' && !input) {
+      input = currentDirectory.getChildFile(argv[i]);
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!input) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  const auto trace = audio::readRegisterTrace(input.value());
+  if (!trace || !trace->format.chipCount) {
+    std::fprintf(stderr, "Cannot read %s\n",
+                 input->getFullPathName().toRawUTF8());
+    return 1;
+  }
+
+  const auto& format = trace->format;
+  if (audio::FmChip(0).sampleRate(format.clockHz) != format.sampleRate) {
+    std::fprintf(stderr, "Chips do not output %u Hz\n", format.sampleRate);
+    return 1;
+  }
+
+  // Timestamps are shifted so that the first write is at the top.
+  std::uint64_t origin{};
+  std::uint64_t lastSampleIndex{};
+  std::vector<std::size_t> writeCounts(format.chipCount);
+  if (!trace->writes.empty()) {
+    origin = trace->writes.front().sampleIndex;
+  }
+  for (const auto& write : trace->writes) {
+    if (format.chipCount <= write.chip) {
+      std::fprintf(stderr, "Invalid chip %u\n", write.chip);
+      return 1;
+    }
+    origin = std::min(origin, write.sampleIndex);
+    lastSampleIndex = std::max(lastSampleIndex, write.sampleIndex);
+    ++writeCounts[write.chip];
+  }
+  const std::uint64_t endSampleIndex =
+      lastSampleIndex +
+      static_cast<std::uint64_t>(tailSeconds * format.sampleRate);
+
+  if (vgmFile) {
+    if (format.chipCount > kMaxVgmChipCount) {
+      std::fprintf(stderr, "VGM holds at most %u chips\n", kMaxVgmChipCount);
+      return 1;
+    }
+    if (!exportVgm(trace.value(), origin, endSampleIndex, vgmFile.value())) {
+      std::fprintf(stderr, "Cannot write %s\n",
+                   vgmFile->getFullPathName().toRawUTF8());
+      return 1;
+    }
+  }
+
+  // Chips go through the same path as the plugin, including skipping idle
+  // emulation, so the output is identical to the recorded session.
+  std::vector<std::unique_ptr<audio::FmChip>> chips;
+  for (const std::size_t count : writeCounts) {
+    auto& chip = chips.emplace_back(std::make_unique<audio::FmChip>(count));
+    chip->reset();
+  }
+  for (const auto& write : trace->writes) {
+    auto& chip = *chips[write.chip];
+    chip.setReservationTimestamp(write.sampleIndex - origin);
+    chip.reserveUncoalescedWrite(write.change);
+  }
+
+  const std::uint64_t sampleCount = endSampleIndex - origin;
+  std::vector<ymfm::ym2608::output_data> mix(kBlockSampleCount);
+  std::vector<ymfm::ym2608::output_data> output(kBlockSampleCount);
+  std::uint64_t checksum{kFnvOffsetBasis};
+
+  const auto begin = Clock::now();
+  for (std::uint64_t top = 0; top < sampleCount; top += kBlockSampleCount) {
+    const auto count = static_cast<std::size_t>(
+        std::min<std::uint64_t>(kBlockSampleCount, sampleCount - top));
+
+    chips.front()->render(mix.data(), count);
+    for (std::size_t i = 1; i < chips.size(); ++i) {
+      chips[i]->render(output.data(), count);
+      for (std::size_t j = 0; j < count; ++j) {
+        for (std::size_t ch = 0; ch < 2; ++ch) {
+          mix[j].data[ch] += output[j].data[ch];
+        }
+      }
+    }
+
+    for (std::size_t j = 0; j < count; ++j) {
+      checksum = fnv1a(fnv1a(checksum, mix[j].data[0]), mix[j].data[1]);
+    }
+  }
+  const double elapsedSeconds =
+      std::chrono::duration<double>(Clock::now() - begin).count();
+
+  std::printf(
+      "samples: %llu\n"
+      "writes: %zu\n"
+      "elapsed: %.3f s (%.1fx realtime)\n"
+      "checksum: %016llx\n",
+      static_cast<unsigned long long>(sampleCount), trace->writes.size(),
+      elapsedSeconds,
+      static_cast<double>(sampleCount) / format.sampleRate /
+          std::max(elapsedSeconds, 1e-9),
+      static_cast<unsigned long long>(checksum));
+
+  return 0;
+}
@@ -3,22 +3,17 @@
 
 #pragma once
 
-#include <any>
+#include <cstddef>
+#include <variant>
 
+namespace action {
 /**
- * @brief Action data.
+ * @brief Action that the operator which is edited is changed.
  */
-struct PluginAction {
-  /// Enumeration of action type.
-  enum class Type {
-    InvalidAction,
-
-    CurrentEditingOperatorChanged,
-  };
-
-  /// Type of action.
-  Type type{Type::InvalidAction};
-
-  /// Payload stored data which is related to its action.
-  std::any payload{};
+struct CurrentEditingOperatorChanged {
+  std::size_t slot{};  ///< Slot number of the operator.
 };
+}  // namespace action
+
+/// Action data. Each alternative is a type of action which has its payload.
+using PluginAction = std::variant<action::CurrentEditingOperatorChanged>;
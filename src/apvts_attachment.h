@@ -5,12 +5,20 @@
 
 #include <JuceHeader.h>
 
+#include <atomic>
 #include <functional>
+#include <optional>
+#include <type_traits>
+#include <variant>
+
+#include "ui_sync_hub.h"
 
 /**
  * @brief Attachment for a parameter of @c juce::AudioProcessorValueTreeState.
  * @tparam ExecuteCallbackInMessageThread Whether callback for parameter change
- * should be executed in the message thread.
+ * should be executed in the message thread. Changes from other threads are
+ * coalesced by @c UiSyncHub and the callback is called with the latest value
+ * once a frame.
  */
 template <bool ExecuteCallbackInMessageThread>
 class AudioParameterValueTreeStateAttachment
@@ -30,23 +38,35 @@ class AudioParameterValueTreeStateAttachment
       : parameters_(parameters),
         parameterId_(parameterId),
         callback_(callback) {
+    if constexpr (ExecuteCallbackInMessageThread) {
+      value_ = parameters.getRawParameterValue(parameterId);
+      if (value_ && callback_) {
+        hubIndex_ = hub_->add([this] { callback_(value_->load()); });
+      }
+    }
     parameters.addParameterListener(parameterId, this);
   }
 
   ~AudioParameterValueTreeStateAttachment() {
     parameters_.removeParameterListener(parameterId_, this);
+    if constexpr (ExecuteCallbackInMessageThread) {
+      if (hubIndex_) {
+        hub_->remove(*hubIndex_);
+      }
+    }
   }
 
   void parameterChanged(const String& /*parameterID*/,
                         float newValue) override {
     if constexpr (ExecuteCallbackInMessageThread) {
-      // TODO: Prefer using juce::ChangerBroadCaster to get juce::MessageManager
-      // for frequent updates.
       auto* messageManager = juce::MessageManager::getInstanceWithoutCreating();
       if (messageManager && callback_) {
         if (messageManager->isThisTheMessageThread()) {
           callback_(newValue);
+        } else if (hubIndex_) {
+          hub_->markDirty(*hubIndex_);
         } else {
+          // The hub is full.
           juce::MessageManager::callAsync(
               [newValue, f = callback_] { f(newValue); });
         }
@@ -63,6 +83,18 @@ class AudioParameterValueTreeStateAttachment
   const juce::String parameterId_;
   const std::function<void(float)> callback_;
 
+  /// Hub shared by attachments for UI.
+  [[no_unique_address]] std::conditional_t<
+      ExecuteCallbackInMessageThread, juce::SharedResourcePointer<UiSyncHub>,
+      std::monostate>
+      hub_;
+
+  /// Entry in the hub.
+  std::optional<std::size_t> hubIndex_;
+
+  /// Current value of the parameter.
+  std::atomic<float>* value_{};
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(
       AudioParameterValueTreeStateAttachment)
 };
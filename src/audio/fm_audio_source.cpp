@@ -4,14 +4,17 @@
 #include "fm_audio_source.h"
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
 #include <limits>
-#include <numeric>
+#include <stdexcept>
 #include <utility>
+#include <variant>
 
-#include "../util.h"
 #include "pitch_util.h"
-#include "register.h"
+#include "sample_conversion.h"
+#include "tone_register_image.h"
 
 namespace audio {
 namespace {
@@ -21,50 +24,90 @@ namespace {
  */
 constexpr unsigned int kChipClockHz{3993600 * 2};
 
-/// Maximum number of channel.
-constexpr std::size_t kMaxChannelCount{6};
+/// Maximum number of channel in a chip.
+constexpr std::size_t kMaxChannelCount{FmChip::kChannelCount};
+static_assert(kMaxChannelCount == kFmChannelCount);
+static_assert(parameter::ChipCountValue::kMaximum * kMaxChannelCount <=
+              Keyboard::kMaxPolyphony);
+
+/// Addresses of F-number registers ($a0). The index is channel number.
+constexpr ChannelAddresses kFNumberAddressTable = [] {
+  ChannelAddresses table{};
+  for (std::size_t channel = 0; channel < kMaxChannelCount; ++channel) {
+    table[channel] = addressOfChannel(channel, 0xa0u);
+  }
+  return table;
+}();
 
 /**
- * @brief Calculate address added channel offset.
- * @param[in] channel Number of channel.
- * @param[in] baseAddress Address where @c channel is 0.
- * @return Address added offset, or @c baseAddress if @c channel is invalid
- * value.
+ * @brief Call a function with each layout selected by a mask.
+ * @tparam Mask Bits of indices of layouts.
+ * @param[in] layouts Layouts.
+ * @param[in] function Function called with an index and a layout.
  */
-constexpr std::uint16_t addressOfChannel(std::size_t channel,
-                                         std::uint16_t baseAddress) noexcept {
-  constexpr std::uint16_t kOffset[kMaxChannelCount]{0x0u,   0x1u,   0x2u,
-                                                    0x100u, 0x101u, 0x102u};
-  return (channel < kMaxChannelCount) ? (baseAddress + kOffset[channel])
-                                      : baseAddress;
+template <std::uint32_t Mask, class Layouts, class F>
+void forEachLayoutIn(const Layouts& layouts, F&& function) {
+  for (std::size_t i = 0; i < layouts.size(); ++i) {
+    if ((Mask >> i) & 1u) {
+      function(i, layouts[i]);
+    }
+  }
 }
 
+/// Control index of feedback in @c ModulationScheduler. The indices of total
+/// level are slot numbers.
+constexpr std::size_t kFeedbackControl{kSlotCount};
+static_assert(kFeedbackControl < ModulationScheduler::kMaxControlCount);
+
+/// Index of the layout of total level in @c kOperatorRegisterLayouts.
+constexpr std::size_t kTotalLevelLayoutIndex{static_cast<std::size_t>(
+    std::countr_zero(
+        ToneParameterMapping<parameter::TotalLevelValue>::kLayoutMask))};
+
+/// Index of the layout of feedback in @c kChannelRegisterLayouts.
+constexpr std::size_t kFeedbackLayoutIndex{static_cast<std::size_t>(
+    std::countr_zero(
+        ToneParameterMapping<parameter::FeedbackValue>::kLayoutMask))};
+
 /**
- * @brief Calculate address added operator offset.
- * @param[in] slot Operator (slot) number.
- * @param[in] baseAddress Address where @c slot is 0.
- * @return Address added offset, or @c baseAddress if @c slot is invalid.
+ * @brief Get index of the tone register which a ramped parameter is written.
+ * @param[in] control Control index.
+ * @return Index in @c kToneRegisterAddresses.
  */
-constexpr std::uint16_t addressOfOperator(std::size_t slot,
-                                          std::uint16_t baseAddress) noexcept {
-  constexpr std::uint16_t kOffset[]{0u, 8u, 4u, 12u};
-  return (slot < std::size(kOffset)) ? (baseAddress + kOffset[slot])
-                                     : baseAddress;
+constexpr std::size_t toneRegisterIndexOfControl(std::size_t control) noexcept {
+  return control == kFeedbackControl
+             ? channelToneRegisterIndexOf(kFeedbackLayoutIndex)
+             : operatorToneRegisterIndexOf(control, kTotalLevelLayoutIndex);
 }
 
 /**
- * @brief Convert detune value from signed to unsigned.
- * @param[in] value Signed detune value.
- * @return Unsigned detune value.
+ * @brief Get the value of a ramped parameter.
+ * @param[in] parameters Tone parameters.
+ * @param[in] control Control index.
+ * @return Raw value.
  */
-inline std::uint8_t convertDetuneAsRegisterValue(
-    const parameter::DetuneValue& value) {
-  return (value.rawValue() < 0 ? 4u : 0u) |
-         static_cast<std::uint8_t>(std::abs(value.rawValue()));
+std::uint8_t modulationValueOf(const FmParameters& parameters,
+                               std::size_t control) noexcept {
+  return control == kFeedbackControl ? parameters.fb.rawValue()
+                                     : parameters.slot[control].tl.rawValue();
 }
 
-/// Mask of panning set at $b4-$b6. This means "we set panning to center."
-constexpr std::uint8_t kPanningMask{0xf0u};
+/// Mask of all channels in a chip.
+constexpr std::uint8_t kAllChannelMask{(1u << kMaxChannelCount) - 1u};
+
+/**
+ * @brief Call a function with each channel selected by a mask.
+ * @param[in] mask Bits of channels.
+ * @param[in] function Function called with a channel number.
+ */
+template <class F>
+void forEachChannelIn(std::uint8_t mask, F&& function) {
+  for (std::size_t channel = 0; mask; ++channel, mask >>= 1u) {
+    if (mask & 1u) {
+      function(channel);
+    }
+  }
+}
 
 /**
  * @brief Look-up table used to control note on/off control in the low nibble of
@@ -73,69 +116,134 @@ constexpr std::uint8_t kPanningMask{0xf0u};
 constexpr std::uint8_t kNoteOnChannelTable[kMaxChannelCount]{
     0b000u, 0b001u, 0b010u, 0b100u, 0b101u, 0b110u};
 
-/// Default polyphony number.
-constexpr std::size_t kDefaultPolyphony{kMaxChannelCount};
+/**
+ * @brief Minimum capacity of register write queue of a chip. It can hold writes
+ * to update all tone parameters of all channels several times.
+ */
+constexpr std::size_t kMinRegisterQueueCapacity{1024};
 
 /**
- * @brief Calculate F-Number of given frequency.
- * @param[in] hz Frequency.
- * @return F-Number.
+ * @brief Estimated number of register writes per sample used to allocate
+ * register write queue. It is enough for a pitch bend message per sample.
  */
-auto calculateFNumber(double hz) {
-  return static_cast<std::uint16_t>(
-      std::round(hz * 2304. / (kChipClockHz >> 13)));
-}
+constexpr std::size_t kRegisterWritesPerSample{2 * kMaxChannelCount};
+
+/// Cent of an octave.
+constexpr int kOctaveCent{pitch_util::kSemitoneCountInOctave *
+                          pitch_util::kSemitoneCent};
+
+/// Fractional bits of F-Number in @c kFNumberTable.
+constexpr int kFNumberFractionBits{16};
 
 /**
- * @brief Calculate Block and F-Number from cent.
- * @param[in] cent Cent from MIDI note number 0.
- * @return 2 bytes data which contains Block and F-Number.
+ * @brief Look-up table of F-Number in block 4 (C4-C5). The index is cent in
+ * the octave, and values have @c kFNumberFractionBits fractional bits. It has
+ * an extra entry of C5 for interpolation.
  */
-std::uint16_t calculateFNumberAndBlockFromCent(int cent) {
+const auto kFNumberTable = [] {
   constexpr int kC4Cent = pitch_util::kC4NoteNumber * pitch_util::kSemitoneCent;
-  constexpr int kOctaveCent =
-      pitch_util::kSemitoneCountInOctave * pitch_util::kSemitoneCent;
-  const int block = cent / kOctaveCent - 1;
-  const int centInOctave = cent % kOctaveCent;
+  std::array<std::uint32_t, kOctaveCent + 1> table{};
+  for (int cent = 0; cent <= kOctaveCent; ++cent) {
+    const double hz = pitch_util::calculateHzFromCent(kC4Cent + cent);
+    table[cent] = static_cast<std::uint32_t>(std::round(
+        hz * 2304. / (kChipClockHz >> 13) * (1u << kFNumberFractionBits)));
+  }
+  return table;
+}();
 
-  const double baseHz = pitch_util::calculateHzFromCent(kC4Cent + centInOctave);
-  const auto baseFNum = calculateFNumber(baseHz);
+/**
+ * @brief Calculate Block and F-Number from fine cent.
+ * @param[in] fineCent Fine cent from MIDI note number 0. It is clamped to
+ * block 0-7.
+ * @return 2 bytes data which contains Block and F-Number.
+ */
+std::uint16_t calculateFNumberAndBlockFromFineCent(int fineCent) {
+  constexpr int kOctaveFineCent =
+      kOctaveCent * pitch_util::kFineCentResolution;
+  constexpr int kMaxBlock{7};
+  fineCent = std::clamp(fineCent, kOctaveFineCent,
+                        (kMaxBlock + 2) * kOctaveFineCent - 1);
+
+  const int block = fineCent / kOctaveFineCent - 1;
+  const int fineCentInOctave = fineCent % kOctaveFineCent;
+  const int cent = fineCentInOctave / pitch_util::kFineCentResolution;
+  const auto fraction = static_cast<std::uint64_t>(
+      fineCentInOctave % pitch_util::kFineCentResolution);
+
+  // Interpolate linearly between cents.
+  const std::uint64_t interpolated =
+      (kFNumberTable[cent] * (pitch_util::kFineCentResolution - fraction) +
+       kFNumberTable[cent + 1] * fraction) /
+      pitch_util::kFineCentResolution;
+  const auto baseFNum = static_cast<std::uint16_t>(
+      (interpolated + (1u << (kFNumberFractionBits - 1))) >>
+      kFNumberFractionBits);
 
   return (static_cast<std::uint8_t>(block) << 11) | baseFNum;
 }
-
-// /**
-//  * @brief Calculate Block and F-Number from MIDI note number.
-//  * @param[in] noteNumber Note number.
-//  * @return 2 bytes data which contains Block and F-Number.
-//  */
-// std::uint16_t calculateFNumberAndBlockFromNoteNumber(int noteNumber) {
-//   const int block = noteNumber / pitch_util::kSemitoneCountInOctave - 1;
-//   const int noteNumberInOctave =
-//       noteNumber % pitch_util::kSemitoneCountInOctave;
-
-//   const double baseHz = juce::MidiMessage::getMidiNoteInHertz(
-//       pitch_util::kC4NoteNumber + noteNumberInOctave);
-//   const auto baseFNum = calculateFNumber(baseHz);
-
-//   return (static_cast<std::uint8_t>(block) << 11) | baseFNum;
-// }
 }  // namespace
 
-FmAudioSource::FmAudioSource() : keyboard_(kDefaultPolyphony) {
-  ym2608_ = std::make_unique<ymfm::ym2608>(interface_);
-  ym2608_->set_fidelity(ymfm::opn_fidelity::OPN_FIDELITY_MIN);
+FmAudioSource::FmAudioSource(std::size_t chipCount)
+    : keyboard_(chipCount * kMaxChannelCount) {
+  if (!chipCount) {
+    throw std::invalid_argument("Chip count must be greater than zero.");
+  }
+
+  chips_.resize(chipCount);
+  for (auto& voices : chips_) {
+    voices.chip = std::make_unique<FmChip>(kMinRegisterQueueCapacity);
+  }
+  chipOutputBuffers_.resize(chipCount - 1);
 }
 
 FmAudioSource ::~FmAudioSource() = default;
 
-double FmAudioSource::synthesisRate() const { return kChipClockHz / 144; }
+void FmAudioSource::setChipCount(std::size_t chipCount) {
+  if (!chipCount) {
+    throw std::invalid_argument("Chip count must be greater than zero.");
+  }
+  if (chipCount == chips_.size()) {
+    return;
+  }
+
+  // Voices of removed chips are released without note-off because their
+  // chips are destroyed.
+  std::array<NoteAssignment, Keyboard::kMaxPolyphony> noteOffs;
+  keyboard_.setPolyphony(chipCount * kMaxChannelCount, noteOffs);
+
+  chips_.resize(chipCount);
+  for (auto& voices : chips_) {
+    if (!voices.chip) {
+      voices.chip = std::make_unique<FmChip>(kMinRegisterQueueCapacity);
+    }
+  }
+  chipOutputBuffers_.resize(chipCount - 1);
+
+  // Workers are spawned per chip.
+  if (workerPool_) {
+    spawnWorkers();
+  }
+}
+
+double FmAudioSource::synthesisRate() const {
+  return chips_.front().chip->sampleRate(kChipClockHz);
+}
 
 void FmAudioSource::prepareToPlay(int samplesPerBlockExpected,
                                   double /*sampleRate*/) {
+  for (auto& voices : chips_) {
+    voices.chip->allocate(
+        std::max(kMinRegisterQueueCapacity,
+                 kRegisterWritesPerSample *
+                     static_cast<std::size_t>(samplesPerBlockExpected)));
+  }
+
   reset();
 
   outputDataBuffer_.resize(samplesPerBlockExpected);
+  for (auto& buffer : chipOutputBuffers_) {
+    buffer.resize(samplesPerBlockExpected);
+  }
 }
 
 void FmAudioSource::getNextAudioBlock(
@@ -144,610 +252,677 @@ void FmAudioSource::getNextAudioBlock(
     outputDataBuffer_.resize(bufferToFill.numSamples);
   }
 
-  ym2608_->generate_fm_adpcm(
-      outputDataBuffer_.data(),
-      static_cast<std::uint32_t>(bufferToFill.numSamples));
+  render(outputDataBuffer_.data(),
+         static_cast<std::size_t>(bufferToFill.numSamples));
+
+  constexpr float kGain{1.f / std::numeric_limits<std::int16_t>::max()};
+  const auto numSamples = static_cast<std::size_t>(bufferToFill.numSamples);
+  auto* buffer = bufferToFill.buffer;
 
-  if (bufferToFill.buffer->getNumChannels() == 1) {
+  sample_conversion::StereoLevel level;
+  if (buffer->getNumChannels() == 1) {
     // Mono
-    std::transform(
-        outputDataBuffer_.begin(),
-        outputDataBuffer_.begin() + bufferToFill.numSamples,
-        bufferToFill.buffer->getWritePointer(0, bufferToFill.startSample),
-        [](const ymfm::ym2608::output_data& output) {
-          return std::midpoint(static_cast<float>(output.data[0]),
-                               static_cast<float>(output.data[1])) /
-                 (std::numeric_limits<std::int16_t>::max());
-        });
+    sample_conversion::mixDown(
+        outputDataBuffer_.data(), numSamples,
+        buffer->getWritePointer(0, bufferToFill.startSample), kGain / 2.f,
+        level);
   } else {
     // Stereo
-    for (int ch = 0; ch < bufferToFill.buffer->getNumChannels(); ++ch) {
-      std::transform(
-          outputDataBuffer_.begin(),
-          outputDataBuffer_.begin() + bufferToFill.numSamples,
-          bufferToFill.buffer->getWritePointer(ch, bufferToFill.startSample),
-          [ch](const ymfm::ym2608::output_data& output) {
-            const auto a = output.data[ch];
-            return static_cast<float>(a) /
-                   (std::numeric_limits<std::int16_t>::max());
-          });
+    sample_conversion::deinterleave(
+        outputDataBuffer_.data(), numSamples,
+        buffer->getWritePointer(0, bufferToFill.startSample),
+        buffer->getWritePointer(1, bufferToFill.startSample), kGain, level);
+
+    for (int ch = 2; ch < buffer->getNumChannels(); ++ch) {
+      buffer->clear(ch, bufferToFill.startSample, bufferToFill.numSamples);
     }
   }
-}
 
-void FmAudioSource::reset() {
-  ym2608_->reset();
+  measure(level, numSamples);
+}
 
-  for (const auto& assignment : keyboard_.forceAllNoteOff()) {
-    reserveNoteOff(assignment);
+void FmAudioSource::render(ymfm::ym2608::output_data* output,
+                           std::size_t numSamples) {
+  for (auto& buffer : chipOutputBuffers_) {
+    if (buffer.size() < numSamples) {
+      buffer.resize(numSamples);
+    }
   }
 
-  {
-    const std::lock_guard guard(reservedChangesMutex_);
-
-    // Initialise interruption / YM2608 mode
-    reservedChanges_.emplace_back(0x29u, 0x80u);
+  if (numSamples) {
+    modulation_.refillBudget();
+    reserveModulationUntil(renderedSampleCount() + numSamples - 1u);
   }
 
-  reserveUpdatingAllToneParameter();
-
-  triggerReservedChanges();
-
-  rpnDetector_.reset();
-}
+  // The first chip renders into the output directly.
+  auto renderChip = [&](std::size_t index) {
+    auto* destination = index ? chipOutputBuffers_[index - 1].data() : output;
+    chips_[index].chip->render(destination, numSamples);
+  };
 
-// [Changes] -------------------------------------------------------------------
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::PitchBendSensitivityValue& value) {
-  if (std::lock_guard guard(parameterMutex_);
-      std::exchange(pitchBendSensitivity_, value) == value) {
-    return false;
+  if (isParallelRenderingEnabled()) {
+    workerPool_->run(chips_.size(), renderChip);
+  } else {
+    for (std::size_t i = 0; i < chips_.size(); ++i) {
+      renderChip(i);
+    }
   }
 
-  return reservePitchChange();
-}
-
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::FeedbackValue& value) {
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
-
-  if (std::exchange(toneParameterState_.fb, value) == value) {
-    return false;
+  // Mix the other chips into the output in one pass.
+  // Channels which have finished release no longer receive tone changes.
+  for (auto& voices : chips_) {
+    voices.activeChannelMask =
+        voices.noteOnChannelMask | voices.chip->soundingChannelMask();
   }
 
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
+  for (std::size_t n = 0; n < numSamples; ++n) {
+    auto& data = output[n].data;
+    for (const auto& buffer : chipOutputBuffers_) {
+      for (std::size_t ch = 0; ch < std::size(data); ++ch) {
+        data[ch] += buffer[n].data[ch];
+      }
     }
-
-    reservedChanges_.emplace_back(
-        addressOfChannel(channel, 0xb0u),
-        (value.rawValue() << 3) | toneParameterState_.al.rawValue());
   }
-  return true;
 }
 
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::AlgorithmValue& value) {
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
+void FmAudioSource::measure(const sample_conversion::StereoLevel& level,
+                            std::size_t numSamples) noexcept {
+  if (keyboard_.stealPolicy() == StealPolicy::Quietest) {
+    // Levels are updated once per block instead of compared on each steal.
+    for (auto mask = keyboard_.noteOnAssignIdMask(); mask; mask &= mask - 1u) {
+      const auto assignId = static_cast<std::size_t>(std::countr_zero(mask));
+      if (const auto* voices = chipOf(assignId)) {
+        const std::size_t channel = assignId % kMaxChannelCount;
+        const auto level = voices->chip->envelopeLevelOf(channel) >> 2u;
+        keyboard_.setLevel(assignId, static_cast<std::uint8_t>(level));
+      }
+    }
+  }
 
-  if (std::exchange(toneParameterState_.al, value) == value) {
-    return false;
+  if (!meter_.add(level, numSamples)) {
+    return;
   }
 
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
+  auto& frame = meter_.pendingFrame();
+  frame.keyOnVoiceMask = 0u;
+  frame.voiceCount = std::min(chips_.size() * kMaxChannelCount,
+                              frame.voiceLevels.size());
+  for (std::size_t voice = 0; voice < frame.voiceCount; ++voice) {
+    const auto& chip = *chips_[voice / kMaxChannelCount].chip;
+    const std::size_t channel = voice % kMaxChannelCount;
+    if ((chip.keyOnChannelMask() >> channel) & 1u) {
+      frame.keyOnVoiceMask |= std::uint64_t{1} << voice;
     }
-
-    reservedChanges_.emplace_back(
-        addressOfChannel(channel, 0xb0u),
-        (toneParameterState_.fb.rawValue() << 3) | value.rawValue());
+    frame.voiceLevels[voice] =
+        static_cast<std::uint8_t>(chip.envelopeLevelOf(channel) >> 2u);
   }
 
-  return true;
+  meter_.publish();
 }
 
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::SlotAndValue<parameter::OperatorEnabledValue>&
-        slotAndValue) {
-  const auto slot = slotAndValue.slot.rawValue();
-  const auto& value = slotAndValue.value;
+void FmAudioSource::spawnWorkers() {
+  const std::size_t workerCount = chips_.size() - 1u;
+  if (!workerCount) {
+    workerPool_.reset();
+  } else if (!workerPool_ || workerPool_->workerCount() != workerCount) {
+    // Join the old workers before spawning new ones.
+    workerPool_.reset();
+    workerPool_ = std::make_unique<RenderWorkerPool>(workerCount);
+  }
+}
 
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
+bool FmAudioSource::isIdle() const noexcept {
+  return std::all_of(chips_.begin(), chips_.end(),
+                     [](const ChipVoices& voices) {
+                       return voices.chip->isIdle();
+                     });
+}
 
-  auto& slotParameters = toneParameterState_.slot[slot];
+std::uint64_t FmAudioSource::renderedSampleCount() const noexcept {
+  return chips_.front().chip->renderedSampleCount();
+}
 
-  if (std::exchange(slotParameters.isEnabled, value) == value) {
-    return false;
+void FmAudioSource::reset() {
+  for (auto& voices : chips_) {
+    voices.chip->reset();
   }
 
-  const std::uint8_t mask = 1u << (slot + 4u);
-  if (value) {
-    noteOnMask_.fetch_or(mask);
-  } else {
-    noteOnMask_.fetch_and(~mask);
+  std::array<NoteAssignment, Keyboard::kMaxPolyphony> noteOffs;
+  for (const auto& assignment : keyboard_.forceAllNoteOff(noteOffs)) {
+    reserveNoteOff(assignment);
   }
 
-  for ([[maybe_unused]] const auto& [channel, _] : keyboard_.noteOns()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
-    }
+  for (auto& voices : chips_) {
+    voices.noteOnChannelMask = 0u;
 
-    reservedChanges_.emplace_back(
-        0x28u, kNoteOnChannelTable[channel] | noteOnMask_.load());
+    // Initialise interruption / YM2608 mode
+    voices.chip->reserveRegisterWrite(0x29u, 0x80u);
   }
 
-  return true;
+  reserveUpdatingAllToneParameter();
+
+  triggerReservedChanges();
+
+  rpnDetector_.reset();
 }
 
+// [Changes] -------------------------------------------------------------------
 bool FmAudioSource::tryReserveParameterChange(
-    const parameter::SlotAndValue<parameter::AttackRateValue>& slotAndValue) {
-  const auto slot = slotAndValue.slot.rawValue();
-  const auto& value = slotAndValue.value;
-
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
+    const parameter::ParameterVariant& parameter) {
+  return std::visit(
+      [this](const auto& value) { return tryReserveChange(value); },
+      parameter);
+}
 
-  auto& slotParameters = toneParameterState_.slot[slot];
+bool FmAudioSource::applyPatch(const FmParameters& parameters) {
+  return applyPatch(parameters, ToneRegisterImage(parameters));
+}
 
-  if (std::exchange(slotParameters.ar, value) == value) {
-    return false;
+bool FmAudioSource::applyPatch(const FmParameters& parameters,
+                               const ToneRegisterImage& image) {
+  const ToneRegisterImage oldImage(toneParameterState_);
+  const auto& oldData = oldImage.channelData();
+  const auto& newData = image.channelData();
+  const bool isLfoChanged = oldImage.lfoData() != image.lfoData();
+
+  toneParameterState_ = parameters;
+  const std::uint8_t oldNoteOnMask =
+      std::exchange(noteOnMask_, image.noteOnMask());
+
+  // Registers in the middle of ramps differ from both images.
+  const std::uint32_t rampedMask = resetModulation();
+  std::uint64_t rampedRegisterMask{};
+  for (std::size_t i = 0; i < ModulationScheduler::kMaxControlCount; ++i) {
+    if ((rampedMask >> i) & 1u) {
+      rampedRegisterMask |= std::uint64_t{1} << toneRegisterIndexOfControl(i);
+    }
   }
 
-  if (slotParameters.ssgeg.isEnabled) {
-    // No need to change register.
-    return true;
+  // Collect registers whose data differ.
+  std::array<std::uint8_t, kChannelToneRegisterCount> changedIndices;
+  std::size_t changeCount{};
+  for (std::size_t i = 0; i < newData.size(); ++i) {
+    if (oldData[i] != newData[i] || ((rampedRegisterMask >> i) & 1u)) {
+      changedIndices[changeCount++] = static_cast<std::uint8_t>(i);
+    }
   }
 
-  const std::uint16_t address = addressOfOperator(slot, 0x50u);
-  const std::uint8_t registerValue =
-      (slotParameters.ks.rawValue() << 6) | value.rawValue();
+  if (changeCount) {
+    for (auto& voices : chips_) {
+      // Update the other channels when a note is assigned to them.
+      const std::uint8_t activeMask = voices.activeChannelMask;
+      voices.staleChannelMask |= ~activeMask & kAllChannelMask;
+      if (!activeMask) {
+        continue;
+      }
 
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
+      auto& chip = *voices.chip;
+      for (std::size_t i = 0; i < changeCount; ++i) {
+        const std::size_t index = changedIndices[i];
+        forEachChannelIn(activeMask, [&](std::size_t channel) {
+          chip.reserveRegisterWrite(kToneRegisterAddresses[index][channel],
+                                    newData[index]);
+        });
+      }
     }
-
-    reservedChanges_.emplace_back(addressOfChannel(channel, address),
-                                  registerValue);
   }
 
-  return true;
-}
-
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::SlotAndValue<parameter::DecayRateValue>& slotAndValue) {
-  const auto slot = slotAndValue.slot.rawValue();
-  const auto& value = slotAndValue.value;
-
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
+  if (isLfoChanged) {
+    reserveChipParameterWrite(0x22u, image.lfoData());
+  }
 
-  auto& slotParameters = toneParameterState_.slot[slot];
+  const bool isToneChanged = changeCount || isLfoChanged;
 
-  if (std::exchange(slotParameters.dr, value) == value) {
-    return false;
+  if (oldNoteOnMask != noteOnMask_) {
+    reserveNoteOnMaskWrite();
+    return true;
   }
 
-  const std::uint16_t address = addressOfOperator(slot, 0x60u);
-  const std::uint8_t registerValue =
-      (static_cast<uint8_t>(slotParameters.am) << 7) | value.rawValue();
+  return isToneChanged;
+}
+
+bool FmAudioSource::tryReserveChangeFromMidiMessage(
+    const juce::MidiMessage& message) {
+  const auto event =
+      MidiEvent::decode(message.getRawData(), message.getRawDataSize(), 0);
+  return event.has_value() && tryReserveMidiEvent(event.value());
+}
 
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
+bool FmAudioSource::tryReserveMidiEvent(const MidiEvent& event) {
+  if (event.type == MidiEvent::Type::Controller) {
+    // Check pitch bend sensitivity.
+    const auto parseResult =
+        rpnDetector_.tryParse(event.channel, event.number, event.value);
+    if (!parseResult.has_value()) {
+      return false;
     }
 
-    reservedChanges_.emplace_back(addressOfChannel(channel, address),
-                                  registerValue);
-  }
+    const auto rpnMessage = parseResult.value();
+    if (rpnMessage.isNRPN || rpnMessage.parameterNumber != 0) {
+      return false;
+    }
 
-  return true;
-}
+    // RPN 0 is pitch bend sensitivity, whose MSB is semitones.
+    const int semitones =
+        rpnMessage.is14BitValue ? rpnMessage.value >> 7 : rpnMessage.value;
+    channelPitchBends_[static_cast<std::size_t>(rpnMessage.channel - 1)]
+        .sensitivity = parameter::PitchBendSensitivityValue{semitones};
 
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::SlotAndValue<parameter::SustainRateValue>& slotAndValue) {
-  const auto slot = slotAndValue.slot.rawValue();
-  const auto& value = slotAndValue.value;
+    rpnDetector_.reset();
 
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
+    return reservePitchChange(rpnMessage.channel);
+  }
 
-  auto& slotParameters = toneParameterState_.slot[slot];
+  rpnDetector_.reset();
 
-  if (std::exchange(slotParameters.sr, value) == value) {
-    return false;
-  }
+  bool isSuccess{};
 
-  const std::uint16_t address = addressOfOperator(slot, 0x70u);
+  if (event.type == MidiEvent::Type::NoteOn) {
+    std::array<NoteAssignment, Keyboard::kMaxNoteOnChangeCount> changes;
+    const auto note = Note::noteOn(event.channel, event.number,
+                                   static_cast<std::uint8_t>(event.value));
+    const auto assignments = keyboard_.tryNoteOn(note, changes);
+    isSuccess = !assignments.empty();
 
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
+    for (const auto& assignment : assignments) {
+      if (assignment.note.isNoteOn()) {
+        isSuccess &= reservePitchChange(assignment);
+        isSuccess &= reserveNoteOn(assignment);
+      } else {
+        isSuccess &= reserveNoteOff(assignment);
+      }
     }
-
-    reservedChanges_.emplace_back(addressOfChannel(channel, address),
-                                  value.rawValue());
+  } else if (event.type == MidiEvent::Type::NoteOff) {
+    const auto&& assignment =
+        keyboard_.tryNoteOff(Note::noteOff(event.channel, event.number));
+    isSuccess =
+        assignment.has_value() ? reserveNoteOff(assignment.value()) : false;
+  } else if (event.type == MidiEvent::Type::PitchWheel) {
+    channelPitchBends_[event.channel - 1u].pitchBend =
+        event.value + pitch_util::kMinPitchBend;
+    isSuccess = reservePitchChange(event.channel);
   }
 
-  return true;
+  return isSuccess;
 }
 
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::SlotAndValue<parameter::ReleaseRateValue>& slotAndValue) {
-  const auto slot = slotAndValue.slot.rawValue();
-  const auto& value = slotAndValue.value;
+void FmAudioSource::triggerReservedChanges() {
+  // Ramps make no sense without timestamps, so parameters reach targets.
+  const std::uint32_t rampedMask = resetModulation();
+  for (std::size_t i = 0; i < ModulationScheduler::kMaxControlCount; ++i) {
+    if ((rampedMask >> i) & 1u) {
+      reserveModulationWrite(i, modulationValueOf(toneParameterState_, i));
+    }
+  }
 
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
+  for (auto& voices : chips_) {
+    voices.chip->triggerReservedChanges();
+  }
+}
 
-  auto& slotParameters = toneParameterState_.slot[slot];
+void FmAudioSource::setReservationTimestamp(
+    std::uint64_t sampleIndex) noexcept {
+  // Ticks of ramps before the time are reserved first to keep the order.
+  reserveModulationUntil(sampleIndex);
 
-  if (std::exchange(slotParameters.rr, value) == value) {
-    return false;
+  for (auto& voices : chips_) {
+    voices.chip->setReservationTimestamp(sampleIndex);
   }
+}
 
-  const std::uint16_t address = addressOfOperator(slot, 0x80u);
-  const std::uint8_t registerValue =
-      (slotParameters.sl.rawValue() << 4) | value.rawValue();
+std::uint64_t FmAudioSource::overflowedRegisterWriteCount() const noexcept {
+  std::uint64_t count{};
+  for (const auto& voices : chips_) {
+    count += voices.chip->overflowedRegisterWriteCount();
+  }
+  return count;
+}
 
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
-    }
+std::uint64_t FmAudioSource::appliedRegisterWriteCount() const noexcept {
+  std::uint64_t count{};
+  for (const auto& voices : chips_) {
+    count += voices.chip->appliedRegisterWriteCount();
+  }
+  return count;
+}
 
-    reservedChanges_.emplace_back(addressOfChannel(channel, address),
-                                  registerValue);
+std::uint64_t FmAudioSource::renderSplitCount() const noexcept {
+  std::uint64_t count{};
+  for (const auto& voices : chips_) {
+    count += voices.chip->renderSplitCount();
   }
+  return count;
+}
 
-  return true;
+TraceFormat FmAudioSource::traceFormat() const {
+  return {.chipCount{static_cast<std::uint8_t>(chips_.size())},
+          .clockHz{kChipClockHz},
+          .sampleRate{chips_.front().chip->sampleRate(kChipClockHz)}};
 }
 
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::SlotAndValue<parameter::SustainLevelValue>& slotAndValue) {
-  const auto slot = slotAndValue.slot.rawValue();
-  const auto& value = slotAndValue.value;
+void FmAudioSource::setTraceRecorder(RegisterTraceRecorder* recorder) {
+  triggerReservedChanges();
 
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
+  for (std::size_t i = 0; i < chips_.size(); ++i) {
+    chips_[i].chip->setTraceRecorder(recorder, static_cast<std::uint8_t>(i));
+  }
+}
 
-  auto& slotParameters = toneParameterState_.slot[slot];
+FmAudioSource::ChipVoices* FmAudioSource::chipOf(
+    std::size_t assignId) noexcept {
+  const std::size_t index = assignId / kMaxChannelCount;
+  return index < chips_.size() ? &chips_[index] : nullptr;
+}
 
-  if (std::exchange(slotParameters.sl, value) == value) {
+bool FmAudioSource::tryReserveChange(
+    const parameter::PitchBendSensitivityValue& value) {
+  bool isChanged{};
+  for (auto& pitchBend : channelPitchBends_) {
+    isChanged |= std::exchange(pitchBend.sensitivity, value) != value;
+  }
+  if (!isChanged) {
     return false;
   }
 
-  const std::uint16_t address = addressOfOperator(slot, 0x80u);
-  const std::uint8_t registerValue =
-      (value.rawValue() << 4) | slotParameters.rr.rawValue();
-
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
-    }
+  return reservePitchChange();
+}
 
-    reservedChanges_.emplace_back(addressOfChannel(channel, address),
-                                  registerValue);
+bool FmAudioSource::tryReserveChange(const parameter::FeedbackValue& value) {
+  if (std::exchange(toneParameterState_.fb, value) == value) {
+    return false;
   }
 
+  modulation_.rampTo(kFeedbackControl, value.rawValue());
+
   return true;
 }
 
-bool FmAudioSource::tryReserveParameterChange(
+bool FmAudioSource::tryReserveChange(
     const parameter::SlotAndValue<parameter::TotalLevelValue>& slotAndValue) {
   const auto slot = slotAndValue.slot.rawValue();
   const auto& value = slotAndValue.value;
 
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
-
-  auto& slotParameters = toneParameterState_.slot[slot];
-
-  if (std::exchange(slotParameters.tl, value) == value) {
+  if (std::exchange(toneParameterState_.slot[slot].tl, value) == value) {
     return false;
   }
 
-  const std::uint16_t address = addressOfOperator(slot, 0x40u);
-
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
-    }
-
-    reservedChanges_.emplace_back(addressOfChannel(channel, address),
-                                  value.rawValue());
-  }
+  modulation_.rampTo(slot, value.rawValue());
 
   return true;
 }
 
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::SlotAndValue<parameter::KeyScaleValue>& slotAndValue) {
+bool FmAudioSource::tryReserveChange(
+    const parameter::SlotAndValue<parameter::OperatorEnabledValue>&
+        slotAndValue) {
   const auto slot = slotAndValue.slot.rawValue();
   const auto& value = slotAndValue.value;
 
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
-
   auto& slotParameters = toneParameterState_.slot[slot];
 
-  if (std::exchange(slotParameters.ks, value) == value) {
+  if (std::exchange(slotParameters.isEnabled, value) == value) {
     return false;
   }
 
-  const std::uint16_t address = addressOfOperator(slot, 0x50u);
-  const std::uint8_t rawAr = slotParameters.ssgeg.isEnabled
-                                 ? parameter::AttackRateValue::kMaximum
-                                 : slotParameters.ar.rawValue();
-  const std::uint8_t registerValue = (value.rawValue() << 6) | rawAr;
-
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
-    }
-
-    reservedChanges_.emplace_back(addressOfChannel(channel, address),
-                                  registerValue);
+  const std::uint8_t mask = 1u << (slot + 4u);
+  if (value) {
+    noteOnMask_ |= mask;
+  } else {
+    noteOnMask_ &= ~mask;
   }
 
+  reserveNoteOnMaskWrite();
+
   return true;
 }
 
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::SlotAndValue<parameter::MultipleValue>& slotAndValue) {
-  const auto slot = slotAndValue.slot.rawValue();
-  const auto& value = slotAndValue.value;
-
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
-
-  auto& slotParameters = toneParameterState_.slot[slot];
+template <MappedToneParameter T>
+  requires(ToneParameterMapping<T>::kScope != ToneRegisterScope::Operator)
+bool FmAudioSource::tryReserveChange(const T& value) {
+  using Mapping = ToneParameterMapping<T>;
 
-  if (std::exchange(slotParameters.ml, value) == value) {
+  if (std::exchange(Mapping::field(toneParameterState_), value) == value) {
     return false;
   }
 
-  const std::uint16_t address = addressOfOperator(slot, 0x30u);
-  const std::uint8_t rawDt = convertDetuneAsRegisterValue(slotParameters.dt);
-  const std::uint8_t registerValue = (rawDt << 4) | value.rawValue();
-
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
-    }
-
-    reservedChanges_.emplace_back(addressOfChannel(channel, address),
-                                  registerValue);
+  if constexpr (Mapping::kScope == ToneRegisterScope::Channel) {
+    forEachLayoutIn<Mapping::kLayoutMask>(
+        kChannelRegisterLayouts, [this](std::size_t i, const auto& layout) {
+          reserveToneRegisterWrite(channelToneRegisterIndexOf(i),
+                                   layout.dataOf(toneParameterState_));
+        });
+  } else {
+    forEachLayoutIn<Mapping::kLayoutMask>(
+        kChipRegisterLayouts, [this](std::size_t, const auto& layout) {
+          reserveChipParameterWrite(layout.address,
+                                    layout.dataOf(toneParameterState_));
+        });
   }
 
   return true;
 }
 
-bool FmAudioSource::tryReserveParameterChange(
-    const parameter::SlotAndValue<parameter::DetuneValue>& slotAndValue) {
+template <MappedToneParameter T>
+  requires(ToneParameterMapping<T>::kScope == ToneRegisterScope::Operator)
+bool FmAudioSource::tryReserveChange(
+    const parameter::SlotAndValue<T>& slotAndValue) {
+  using Mapping = ToneParameterMapping<T>;
+
   const auto slot = slotAndValue.slot.rawValue();
   const auto& value = slotAndValue.value;
-
-  const std::scoped_lock guard{parameterMutex_, reservedChangesMutex_};
-
   auto& slotParameters = toneParameterState_.slot[slot];
 
-  if (std::exchange(slotParameters.dt, value) == value) {
+  if (std::exchange(Mapping::field(slotParameters), value) == value) {
     return false;
   }
 
-  const std::uint16_t address = addressOfOperator(slot, 0x30u);
-  const std::uint8_t rawDt = convertDetuneAsRegisterValue(value);
-  const std::uint8_t registerValue =
-      (rawDt << 4) | slotParameters.ml.rawValue();
-
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      continue;
-    }
-
-    reservedChanges_.emplace_back(addressOfChannel(channel, address),
-                                  registerValue);
-  }
+  forEachLayoutIn<Mapping::kLayoutMask>(
+      kOperatorRegisterLayouts, [&](std::size_t i, const auto& layout) {
+        reserveToneRegisterWrite(operatorToneRegisterIndexOf(slot, i),
+                                 layout.dataOf(slotParameters));
+      });
 
   return true;
 }
 
-bool FmAudioSource::tryReserveChangeFromMidiMessage(
-    const juce::MidiMessage& message) {
-  DBG(message.getDescription());
-
-  if (message.isController()) {
-    // Check pitch bend sensitivity.
-    const auto parseResult = rpnDetector_.tryParse(
-        message.getChannel(), message.getControllerNumber(),
-        message.getControllerValue());
-    if (!parseResult.has_value()) {
-      return false;
-    }
-
-    const auto rpnMessage = parseResult.value();
-    if (rpnMessage.isNRPN || rpnMessage.parameterNumber != 0) {
-      return false;
-    }
-
-    {
-      // Pitch bend is insensitive on channel.
-      std::lock_guard pbsGuard(parameterMutex_);
-      pitchBendSensitivity_ =
-          parameter::PitchBendSensitivityValue{rpnMessage.parameterNumber};
-    }
-
-    rpnDetector_.reset();
-
-    return reservePitchChange();
-  }
-
-  rpnDetector_.reset();
-
-  bool isSuccess{};
-
-  if (message.isNoteOn()) {
-    const auto&& assignments = keyboard_.tryNoteOn(Note(message));
-    isSuccess = !assignments.empty();
+void FmAudioSource::reserveToneRegisterWrite(std::size_t registerIndex,
+                                             std::uint8_t data) noexcept {
+  const auto& addresses = kToneRegisterAddresses[registerIndex];
+  for (auto& voices : chips_) {
+    // Update the other channels when a note is assigned to them.
+    voices.staleChannelMask |= ~voices.activeChannelMask & kAllChannelMask;
 
-    for (const auto& assignment : assignments) {
-      if (assignment.note.isNoteOn()) {
-        isSuccess &= reservePitchChange(assignment);
-        isSuccess &= reserveNoteOn(assignment);
-      } else {
-        isSuccess &= reserveNoteOff(assignment);
-      }
-    }
-  } else if (message.isNoteOff()) {
-    const auto&& assignment = keyboard_.tryNoteOff(Note(message));
-    isSuccess =
-        assignment.has_value() ? reserveNoteOff(assignment.value()) : false;
-  } else if (message.isPitchWheel()) {
-    // Pitch bend is insensitive on channel.
-    pitchBend_ = message.getPitchWheelValue() + pitch_util::kMinPitchBend;
-    isSuccess = reservePitchChange();
+    forEachChannelIn(voices.activeChannelMask, [&](std::size_t channel) {
+      voices.chip->reserveRegisterWrite(addresses[channel], data);
+    });
   }
-
-  return isSuccess;
 }
 
-void FmAudioSource::triggerReservedChanges() {
-  const std::lock_guard guard(reservedChangesMutex_);
-
-  for (const auto& change : reservedChanges_) {
-    if (change.pinA1) {
-      ym2608_->write_address_hi(change.address);
-      ym2608_->write_data_hi(change.data);
+void FmAudioSource::reserveChipParameterWrite(std::uint16_t address,
+                                              std::uint8_t data) noexcept {
+  for (auto& voices : chips_) {
+    if (voices.activeChannelMask) {
+      voices.chip->reserveRegisterWrite(address, data);
     } else {
-      ym2608_->write_address(change.address);
-      ym2608_->write_data(change.data);
+      voices.isChipParameterOutdated = true;
     }
   }
 }
 
 bool FmAudioSource::reserveNoteOn(const NoteAssignment& assignment) {
-  if (kMaxChannelCount < assignment.assignId) {
+  auto* voices = chipOf(assignment.assignId);
+  if (!voices) {
     return false;
   }
 
+  const std::size_t channel = assignment.assignId % kMaxChannelCount;
+  reserveCatchingUpToneParameter(*voices, channel);
+
+  const std::uint8_t bit = 1u << channel;
+  voices->noteOnChannelMask |= bit;
+  voices->activeChannelMask |= bit;
+
   // Set note-on.
-  const std::lock_guard guard(reservedChangesMutex_);
-  reservedChanges_.emplace_back(
-      0x28u, kNoteOnChannelTable[assignment.assignId] | noteOnMask_.load());
+  voices->chip->reserveRegisterWrite(
+      0x28u, kNoteOnChannelTable[channel] | noteOnMask_);
 
   return true;
 }
 
 bool FmAudioSource::reserveNoteOff(const NoteAssignment& assignment) {
-  if (kMaxChannelCount < assignment.assignId) {
+  auto* voices = chipOf(assignment.assignId);
+  if (!voices) {
     return false;
   }
 
-  const std::lock_guard guard(reservedChangesMutex_);
-  reservedChanges_.emplace_back(0x28u,
-                                kNoteOnChannelTable[assignment.assignId]);
+  // The channel stays active while it may be in release.
+  const std::size_t channel = assignment.assignId % kMaxChannelCount;
+  voices->noteOnChannelMask &= ~(1u << channel);
+
+  voices->chip->reserveRegisterWrite(0x28u, kNoteOnChannelTable[channel]);
 
   return true;
 }
 
 bool FmAudioSource::reservePitchChange() {
   bool isSuccess{true};
-  for (const auto& assignment : keyboard_.noteOns()) {
+  keyboard_.forEachNoteOn([&](const NoteAssignment& assignment) {
     isSuccess &= reservePitchChange(assignment);
-  }
+  });
+  return isSuccess;
+}
+
+bool FmAudioSource::reservePitchChange(int midiChannel) {
+  bool isSuccess{true};
+  keyboard_.forEachNoteOn([&](const NoteAssignment& assignment) {
+    if (assignment.note.channel == midiChannel) {
+      isSuccess &= reservePitchChange(assignment);
+    }
+  });
   return isSuccess;
 }
 
 bool FmAudioSource::reservePitchChange(const NoteAssignment& assignment) {
-  if (kMaxChannelCount < assignment.assignId) {
+  auto* voices = chipOf(assignment.assignId);
+  if (!voices) {
     return false;
   }
-  const auto pbs = [&] {
-    std::lock_guard guard(parameterMutex_);
-    return pitchBendSensitivity_.rawValue();
-  }();
-  const int cent =
-      pitch_util::calculateCent(assignment.note.noteNumber, pitchBend_, pbs);
-  const std::uint16_t blockAndFNum = calculateFNumberAndBlockFromCent(cent);
-
-  static const std::uint16_t kFNum1AddressTable[kMaxChannelCount]{
-      0xa0u, 0xa1u, 0xa2u, 0x1a0u, 0x1a1u, 0x1a2u};
-  const auto fNum1Address = kFNum1AddressTable[assignment.assignId];
-  constexpr std::uint16_t kBlockFNum2AddressOffset{4};
-  const std::lock_guard guard(reservedChangesMutex_);
-  reservedChanges_.emplace_back(
-      fNum1Address + kBlockFNum2AddressOffset,
-      static_cast<uint8_t>((blockAndFNum >> 8)));  ///< Block and F-Num2
-  reservedChanges_.emplace_back(
-      fNum1Address,
-      static_cast<std::uint8_t>(blockAndFNum & 0x00ff));  ///< F-Num1
+  const auto& pitchBend =
+      channelPitchBends_[static_cast<std::size_t>(assignment.note.channel - 1)];
+  const int fineCent = pitch_util::calculateFineCent(
+      assignment.note.noteNumber, pitchBend.pitchBend,
+      pitchBend.sensitivity.rawValue());
+
+  const std::size_t channel = assignment.assignId % kMaxChannelCount;
+  auto& pitch = voices->pitches[channel];
+  if (pitch.fineCent != fineCent) {
+    pitch.fineCent = fineCent;
+    pitch.blockAndFNum = calculateFNumberAndBlockFromFineCent(fineCent);
+  }
+
+  // Unchanged pairs are dropped by shadow registers of the chip.
+  voices->chip->reserveBlockAndFNumberWrite(kFNumberAddressTable[channel],
+                                            pitch.blockAndFNum);
 
   return true;
 }
 
 void FmAudioSource::reserveUpdatingAllToneParameter() {
-  for (const std::size_t channel : keyboard_.usedAssignIds()) {
-    if (kMaxChannelCount <= channel) {
-      // TODO: Fix polyphonic control
-      return;
-    }
+  for (auto& voices : chips_) {
+    reserveUpdatingToneParameter(voices);
+    voices.staleChannelMask = 0u;
+    voices.isChipParameterOutdated = false;
+  }
+
+  // Change note-on mask.
+  noteOnMask_ = ToneRegisterImage(toneParameterState_).noteOnMask();
+
+  // Registers already have the targets.
+  resetModulation();
+}
 
-    const auto writeToBoundChannel = [&](std::uint16_t address,
-                                         std::uint8_t data) {
-      const std::lock_guard guard(reservedChangesMutex_);
-      reservedChanges_.emplace_back(addressOfChannel(channel, address), data);
-    };
-
-    writeToBoundChannel(0xb0u, (toneParameterState_.fb.rawValue() << 3) |
-                                   toneParameterState_.al.rawValue());
-
-    for (std::size_t n = 0; n < audio::kSlotCount; ++n) {
-      const auto& op = toneParameterState_.slot[n];
-      const auto writeToBoundOperator = [&](std::uint16_t address,
-                                            std::uint8_t data) {
-        writeToBoundChannel(addressOfOperator(n, address), data);
-      };
-
-      const std::uint8_t rawDt = convertDetuneAsRegisterValue(op.dt);
-      writeToBoundOperator(0x30u, (rawDt << 4) | op.ml.rawValue());
-      writeToBoundOperator(0x40u, op.tl.rawValue());
-      const std::uint8_t rawAr = op.ssgeg.isEnabled
-                                     ? parameter::AttackRateValue::kMaximum
-                                     : op.ar.rawValue();
-      writeToBoundOperator(0x50u, (op.ks.rawValue() << 6) | rawAr);
-      writeToBoundOperator(
-          0x60u, (static_cast<uint8_t>(op.am) << 7) | op.dr.rawValue());
-      writeToBoundOperator(0x70u, op.sr.rawValue());
-      writeToBoundOperator(0x80u, (op.sl.rawValue() << 4) | op.rr.rawValue());
-      writeToBoundOperator(
-          0x90u, op.ssgeg.isEnabled ? util::to_underlying(op.ssgeg.shape) : 0u);
+void FmAudioSource::reserveUpdatingToneParameter(ChipVoices& voices) {
+  auto& chip = *voices.chip;
+
+  const ToneRegisterImage image(toneParameterState_);
+  const auto& data = image.channelData();
+  for (std::size_t channel = 0; channel < kMaxChannelCount; ++channel) {
+    for (std::size_t i = 0; i < data.size(); ++i) {
+      chip.reserveRegisterWrite(kToneRegisterAddresses[i][channel], data[i]);
     }
+  }
 
-    writeToBoundChannel(
-        0xb4u, kPanningMask | (toneParameterState_.lfo.ams.rawValue() << 4) |
-                   toneParameterState_.lfo.pms.rawValue());
+  chip.reserveRegisterWrite(0x22u, image.lfoData());
+}
+
+void FmAudioSource::reserveCatchingUpToneParameter(ChipVoices& voices,
+                                                   std::size_t channel) {
+  const std::uint8_t bit = 1u << channel;
+  const bool isChannelStale = voices.staleChannelMask & bit;
+  if (!isChannelStale && !voices.isChipParameterOutdated) {
+    return;
   }
 
-  {
-    const std::lock_guard guard(reservedChangesMutex_);
-    reservedChanges_.emplace_back(
-        0x22u, (toneParameterState_.lfo.isEnabled ? 8u : 0u) |
-                   toneParameterState_.lfo.frequency.rawValue());
+  auto& chip = *voices.chip;
+  const ToneRegisterImage image(toneParameterState_);
+
+  if (std::exchange(voices.isChipParameterOutdated, false)) {
+    chip.reserveRegisterWrite(0x22u, image.lfoData());
   }
 
-  // Change note-on mask.
-  std::uint8_t noteOnMask{};
-  for (std::size_t i = 0; i < audio::kSlotCount; ++i) {
-    noteOnMask |= (static_cast<std::uint8_t>(
-                       toneParameterState_.slot[i].isEnabled.rawValue())
-                   << i);
+  if (isChannelStale) {
+    voices.staleChannelMask &= ~bit;
+
+    // Registers which already have the data are skipped by the chip.
+    const auto& data = image.channelData();
+    for (std::size_t i = 0; i < data.size(); ++i) {
+      chip.reserveRegisterWrite(kToneRegisterAddresses[i][channel], data[i]);
+    }
+  }
+}
+
+void FmAudioSource::reserveModulationUntil(std::uint64_t sampleIndex) noexcept {
+  modulation_.advanceUntil(
+      sampleIndex,
+      [this](std::uint64_t timestamp, std::size_t control, std::uint8_t value) {
+        for (auto& voices : chips_) {
+          voices.chip->setReservationTimestamp(timestamp);
+        }
+        reserveModulationWrite(control, value);
+      });
+}
+
+void FmAudioSource::reserveModulationWrite(std::size_t control,
+                                           std::uint8_t value) noexcept {
+  if (control == kFeedbackControl) {
+    auto parameters = toneParameterState_;
+    parameters.fb = parameter::FeedbackValue{value};
+    reserveToneRegisterWrite(
+        channelToneRegisterIndexOf(kFeedbackLayoutIndex),
+        kChannelRegisterLayouts[kFeedbackLayoutIndex].dataOf(parameters));
+  } else {
+    auto op = toneParameterState_.slot[control];
+    op.tl = parameter::TotalLevelValue{value};
+    reserveToneRegisterWrite(
+        operatorToneRegisterIndexOf(control, kTotalLevelLayoutIndex),
+        kOperatorRegisterLayouts[kTotalLevelLayoutIndex].dataOf(op));
+  }
+}
+
+std::uint32_t FmAudioSource::resetModulation() noexcept {
+  const std::uint32_t rampedMask = modulation_.stopAll();
+  for (std::size_t i = 0; i <= kFeedbackControl; ++i) {
+    modulation_.jumpTo(i, modulationValueOf(toneParameterState_, i));
   }
-  noteOnMask_.store(noteOnMask << 4);
+  return rampedMask;
+}
+
+void FmAudioSource::reserveNoteOnMaskWrite() {
+  keyboard_.forEachNoteOn([this](const NoteAssignment& assignment) {
+    if (auto* voices = chipOf(assignment.assignId)) {
+      voices->chip->reserveRegisterWrite(
+          0x28u, kNoteOnChannelTable[assignment.assignId % kMaxChannelCount] |
+                     noteOnMask_);
+    }
+  });
 }
 }  // namespace audio
@@ -6,31 +6,52 @@
 #include <JuceHeader.h>
 #include <ymfm_opn.h>
 
-#include <atomic>
+#include <array>
+#include <limits>
 #include <memory>
-#include <mutex>
 #include <vector>
 
 #include "../ranged_value.h"
 #include "./parameter/parameter.h"
+#include "fm_chip.h"
 #include "keyboard.h"
-
-namespace audio {
-struct Register;
-}
+#include "midi_event_batch.h"
+#include "modulation_scheduler.h"
+#include "output_meter.h"
+#include "register_trace.h"
+#include "render_worker_pool.h"
+#include "tone_register_image.h"
 
 namespace audio {
 /**
  * @brief Audio source class for FM part.
- * @note Note-on and -off is sensitive on MIDI channel, but pitch bend and pitch
- * bend sensitivity is insensitive.
+ * @details Reserved changes are timestamped by @c setReservationTimestamp()
+ * and applied at that sample while generating samples, so a block is
+ * rendered in one call regardless of the number of events.
+ *
+ * Changes of total level and feedback are smoothed by a ramp at a control
+ * rate, because stepped writes of them sound as zipper noise.
+ *
+ * Voices span several emulator instances. Assign ID n of @c Keyboard is bound
+ * to channel (n % 6) of chip (n / 6), and outputs of all chips are summed.
+ * Pitch bend and pitch bend sensitivity set by RPN are kept per MIDI channel
+ * like MPE, so a bend changes only notes on its channel. Pitch bend
+ * sensitivity of the plugin parameter is set to all channels.
  */
 class FmAudioSource : public juce::AudioSource {
  public:
+  /// Default number of emulator instances.
+  static constexpr std::size_t kDefaultChipCount{
+      parameter::ChipCountValue::kDefault};
+
   /**
    * @brief Constructor.
+   * @param[in] chipCount The number of emulator instances. Polyphony is 6
+   * times of it.
+   * @exception @c std::invalid_argument if @c chipCount is zero or the
+   * polyphony exceeds @c Keyboard::kMaxPolyphony.
    */
-  FmAudioSource();
+  explicit FmAudioSource(std::size_t chipCount = 1);
 
   /**
    * @brief Destructor.
@@ -43,6 +64,84 @@ class FmAudioSource : public juce::AudioSource {
    */
   double synthesisRate() const;
 
+  /**
+   * @brief Get the number of emulator instances.
+   * @return Chip count.
+   */
+  std::size_t chipCount() const noexcept { return chips_.size(); }
+
+  /**
+   * @brief Change the number of emulator instances.
+   * @details Chips are added or removed from the back, and notes on removed
+   * chips are dropped. Added chips have no tone until the source is prepared.
+   * @param[in] chipCount The number of emulator instances. Polyphony is 6
+   * times of it.
+   * @exception @c std::invalid_argument if @c chipCount is zero or the
+   * polyphony exceeds @c Keyboard::kMaxPolyphony.
+   * @note It allocates chips and respawns workers if they are spawned, so
+   * call it outside of the audio thread while the source is not playing, and
+   * prepare the source after it.
+   */
+  void setChipCount(std::size_t chipCount);
+
+  /**
+   * @brief Spawn workers which render chips in parallel.
+   * @details A worker is spawned for each chip except the first one, which is
+   * rendered on the calling thread. Workers park while parallel rendering is
+   * disabled. No worker is spawned with a single chip.
+   * @note It spawns or joins threads, so call it outside of the audio thread
+   * while the source is not playing.
+   */
+  void spawnWorkers();
+
+  /**
+   * @brief Join workers spawned by @c spawnWorkers().
+   * @note It joins threads, so call it outside of the audio thread while the
+   * source is not playing.
+   */
+  void joinWorkers() noexcept { workerPool_.reset(); }
+
+  /**
+   * @brief Enable or disable rendering chips in parallel on workers.
+   * @details It has effect only while workers are spawned, and applies from
+   * the next rendering.
+   * @param[in] isEnabled Whether parallel rendering is enabled.
+   * @note It only sets a flag, so it can be called on the audio thread. Call it
+   * from the thread which renders the source.
+   */
+  void setParallelRenderingEnabled(bool isEnabled) noexcept {
+    isParallelRenderingEnabled_ = isEnabled;
+  }
+
+  /**
+   * @brief Set the policy to choose a voice stolen when all voices are used.
+   * @details @c StealPolicy::Quietest compares envelope levels of channels
+   * sampled after each rendered block.
+   * @param[in] policy Policy.
+   * @note It must be called from the thread which reserves MIDI messages.
+   */
+  void setStealPolicy(StealPolicy policy) noexcept {
+    keyboard_.setStealPolicy(policy);
+  }
+
+  /**
+   * @brief Set whether a note which is already on is re-triggered on its
+   * channel.
+   * @param[in] isEnabled Whether re-triggering is enabled.
+   * @note It must be called from the thread which reserves MIDI messages.
+   */
+  void setSameNoteRetriggerEnabled(bool isEnabled) noexcept {
+    keyboard_.setSameNoteRetriggerEnabled(isEnabled);
+  }
+
+  /**
+   * @brief Whether chips are rendered in parallel.
+   * @return @c true if parallel rendering is enabled and workers are spawned.
+   */
+  bool isParallelRenderingEnabled() const noexcept {
+    return isParallelRenderingEnabled_ && workerPool_;
+  }
+
   /**
    * @brief Prepare audio source to play.
    * @details Reset emulation.
@@ -71,41 +170,30 @@ class FmAudioSource : public juce::AudioSource {
   // [Changes] -----------------------------------------------------------------
   /**
    * @brief Try to reserve parameter change.
-   * @param[in] value Parameter value.
+   * @param[in] parameter Parameter value.
    * @return @c true if change is accepted, otherwise @c false.
    */
-  bool tryReserveParameterChange(
-      const parameter::PitchBendSensitivityValue& value);
-  bool tryReserveParameterChange(const parameter::FeedbackValue& value);
-  bool tryReserveParameterChange(const parameter::AlgorithmValue& value);
+  bool tryReserveParameterChange(const parameter::ParameterVariant& parameter);
 
   /**
-   * @brief Try to reserve parameter change.
-   * @param[in] slotAndValue Slot number and parameter value.
-   * @return @c true if change is accepted, otherwise @c false.
+   * @brief Reserve changes of all tone parameters at once.
+   * @details The patch is compared with the current state, and only registers
+   * whose data differ are written to chips which have note-on voices. The
+   * other chips are updated when a note is assigned to them.
+   * @param[in] parameters Tone parameters.
+   * @return @c true if any parameter is changed, otherwise @c false.
    */
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::OperatorEnabledValue>&
-          slotAndValue);
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::AttackRateValue>& slotAndValue);
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::DecayRateValue>& slotAndValue);
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::SustainRateValue>& slotAndValue);
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::ReleaseRateValue>& slotAndValue);
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::SustainLevelValue>&
-          slotAndValue);
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::TotalLevelValue>& slotAndValue);
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::KeyScaleValue>& slotAndValue);
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::MultipleValue>& slotAndValue);
-  bool tryReserveParameterChange(
-      const parameter::SlotAndValue<parameter::DetuneValue>& slotAndValue);
+  bool applyPatch(const FmParameters& parameters);
+
+  /**
+   * @brief Reserve changes of all tone parameters at once with a precomputed
+   * register image.
+   * @param[in] parameters Tone parameters.
+   * @param[in] image Register image of @c parameters.
+   * @return @c true if any parameter is changed, otherwise @c false.
+   */
+  bool applyPatch(const FmParameters& parameters,
+                  const ToneRegisterImage& image);
 
   /**
    * @brief Try to reserve MIDI message after triggering.
@@ -115,37 +203,184 @@ class FmAudioSource : public juce::AudioSource {
    */
   bool tryReserveChangeFromMidiMessage(const juce::MidiMessage& message);
 
+  /**
+   * @brief Try to reserve a decoded MIDI event after triggering.
+   * @details Program change is not handled, because patches are owned by the
+   * caller.
+   * @param[in] event MIDI event.
+   * @return @c true if given event was used. If it was discarded, returns
+   * @c false.
+   */
+  bool tryReserveMidiEvent(const MidiEvent& event);
+
   /**
    * @brief Change audio source state by executing reserved MIDI messages and
-   * some changes.
+   * some changes immediately regardless of their timestamps.
    */
   void triggerReservedChanges();
 
+  /**
+   * @brief Set the time when changes reserved from now on are applied.
+   * @param[in] sampleIndex Index of sample in synthesis rate, comparable with
+   * @c renderedSampleCount(). If it is earlier than the current reservation
+   * time, the current one is kept to preserve the order of changes.
+   */
+  void setReservationTimestamp(std::uint64_t sampleIndex) noexcept;
+
+  /**
+   * @brief Generate raw samples of the emulator with applying reserved changes
+   * at their timestamps.
+   * @param[out] output Buffer to store samples.
+   * @param[in] numSamples The number of samples to generate.
+   */
+  void render(ymfm::ym2608::output_data* output, std::size_t numSamples);
+
+  /**
+   * @brief Whether all chips are silent and nothing is going to change them.
+   * @details Emulation is skipped while chips are idle, and it resumes when a
+   * note is assigned.
+   * @return @c true if all chips are idle.
+   */
+  bool isIdle() const noexcept;
+
+  /**
+   * @brief Get the number of samples generated since construction.
+   * @return Sample count in synthesis rate.
+   */
+  std::uint64_t renderedSampleCount() const noexcept;
+
+  /**
+   * @brief Get the number of register writes discarded because a queue of
+   * register changes was full.
+   * @return The number of discarded writes.
+   */
+  std::uint64_t overflowedRegisterWriteCount() const noexcept;
+
+  /**
+   * @brief Get the number of register writes applied to emulators.
+   * @return The total count of all chips since construction.
+   */
+  std::uint64_t appliedRegisterWriteCount() const noexcept;
+
+  /**
+   * @brief Get the number of times rendering was split at a timestamp of a
+   * reserved write.
+   * @return The total count of all chips since construction.
+   */
+  std::uint64_t renderSplitCount() const noexcept;
+
+  /**
+   * @brief Add levels of samples converted from @c render() output to the
+   * meter, and publish the meter with activity of voices per window.
+   * @param[in] level Levels measured in the conversion.
+   * @param[in] numSamples The number of samples.
+   */
+  void measure(const sample_conversion::StereoLevel& level,
+               std::size_t numSamples) noexcept;
+
+  /**
+   * @brief Get the meter of output and voices.
+   * @return Meter, which is read from a UI thread.
+   */
+  OutputMeter& outputMeter() noexcept { return meter_; }
+
+  /**
+   * @brief Get properties of chips written to a trace.
+   * @return Format of traces.
+   */
+  TraceFormat traceFormat() const;
+
+  /**
+   * @brief Start or stop recording register writes applied to emulators.
+   * @details Reserved changes are triggered first, and the current registers of
+   * chips are recorded as the initial state.
+   * @param[in] recorder Recorder started with @c traceFormat(), or @c nullptr
+   * to stop recording.
+   * @note It must not be called while rendering.
+   */
+  void setTraceRecorder(RegisterTraceRecorder* recorder);
+
  private:
-  /// Emulator.
-  std::unique_ptr<ymfm::ym2608> ym2608_;
+  /**
+   * @brief Pitch reserved to a voice, which spares calculating F-Number of
+   * unchanged pitch.
+   */
+  struct VoicePitch {
+    /// Fine cent of the pitch, or the minimum if no pitch is reserved.
+    int fineCent{std::numeric_limits<int>::min()};
+
+    /// Block and F-Number of @c fineCent.
+    std::uint16_t blockAndFNum{};
+  };
+
+  /**
+   * @brief Emulator and state of voices assigned to it.
+   */
+  struct ChipVoices {
+    std::unique_ptr<FmChip> chip;  ///< Emulator.
+
+    /// Channels which are note-on. Bit n is channel n.
+    std::uint8_t noteOnChannelMask{};
+
+    /**
+     * @brief Channels which receive tone changes immediately.
+     * @details They are note-on channels and channels which may be in release,
+     * namely sounding in the latest rendering or note-off after it.
+     */
+    std::uint8_t activeChannelMask{};
+
+    /// Channels whose tone registers miss some changes.
+    std::uint8_t staleChannelMask{};
 
-  /// Emulator interface.
-  ymfm::ymfm_interface interface_;
+    /// Whether registers shared by all channels miss some changes.
+    bool isChipParameterOutdated{};
+
+    /// Pitches reserved lastly. The index is channel number.
+    std::array<VoicePitch, FmChip::kChannelCount> pitches{};
+  };
+
+  /// Emulators.
+  std::vector<ChipVoices> chips_;
+
+  /// Temporary buffers to store samples of the second and later chips.
+  std::vector<std::vector<ymfm::ym2608::output_data>> chipOutputBuffers_;
 
   /// Temporary buffer to store samples generated by the emulator.
   std::vector<ymfm::ym2608::output_data> outputDataBuffer_;
 
+  /// Workers to render chips in parallel, or @c nullptr if not spawned.
+  std::unique_ptr<RenderWorkerPool> workerPool_;
+
+  /// Whether chips are rendered on @c workerPool_.
+  bool isParallelRenderingEnabled_{};
+
+  /// Meter of output and voices.
+  OutputMeter meter_;
+
   // [Polyphony Control] -------------------------------------------------------
 
   /// Manager of note-on and -off.
   Keyboard keyboard_;
 
   // [Audio State] -------------------------------------------------------------
+  // These are owned by the thread which calls the audio source, and updated
+  // only through reservation methods, so they need no lock.
 
-  /// Current pitch bend.
-  int pitchBend_{0};
+  /// The number of MIDI channels.
+  static constexpr std::size_t kMidiChannelCount{16};
 
-  /// Mutex for parameters.
-  std::mutex parameterMutex_;
+  /**
+   * @brief Pitch bend state of a MIDI channel.
+   */
+  struct ChannelPitchBend {
+    int pitchBend{0};  ///< Current pitch bend.
 
-  /// Semitone range for pitch bend.
-  parameter::PitchBendSensitivityValue pitchBendSensitivity_{2};
+    /// Semitone range for pitch bend.
+    parameter::PitchBendSensitivityValue sensitivity{2};
+  };
+
+  /// Pitch bend state. The index is MIDI channel number - 1.
+  std::array<ChannelPitchBend, kMidiChannelCount> channelPitchBends_{};
 
   // State of tone parameters.
   FmParameters toneParameterState_;
@@ -154,13 +389,91 @@ class FmAudioSource : public juce::AudioSource {
   juce::MidiRPNDetector rpnDetector_;
 
   /// Operator mask which should be note-on.
-  std::atomic_uint8_t noteOnMask_{0xf0u};
+  std::uint8_t noteOnMask_{0xf0u};
+
+  /// Ramps of total level of each slot and feedback.
+  ModulationScheduler modulation_;
 
   // [Register Change] ---------------------------------------------------------
 
-  /// Queue of register changes.
-  std::vector<Register> reservedChanges_;
-  std::mutex reservedChangesMutex_;
+  /**
+   * @brief Try to reserve change of pitch bend sensitivity.
+   * @param[in] value Parameter value.
+   * @return @c true if change is accepted, otherwise @c false.
+   */
+  bool tryReserveChange(const parameter::PitchBendSensitivityValue& value);
+
+  /**
+   * @brief Try to reserve change of whether an operator is enabled.
+   * @param[in] slotAndValue Slot number and parameter value.
+   * @return @c true if change is accepted, otherwise @c false.
+   */
+  bool tryReserveChange(
+      const parameter::SlotAndValue<parameter::OperatorEnabledValue>&
+          slotAndValue);
+
+  /**
+   * @brief Try to reserve a ramp of feedback.
+   * @param[in] value Parameter value.
+   * @return @c true if change is accepted, otherwise @c false.
+   */
+  bool tryReserveChange(const parameter::FeedbackValue& value);
+
+  /**
+   * @brief Try to reserve a ramp of total level of an operator.
+   * @param[in] slotAndValue Slot number and parameter value.
+   * @return @c true if change is accepted, otherwise @c false.
+   */
+  bool tryReserveChange(
+      const parameter::SlotAndValue<parameter::TotalLevelValue>& slotAndValue);
+
+  /**
+   * @brief Try to reserve change of a channel or chip parameter through its
+   * mapping to registers.
+   * @param[in] value Parameter value.
+   * @return @c true if change is accepted, otherwise @c false.
+   */
+  template <MappedToneParameter T>
+    requires(ToneParameterMapping<T>::kScope != ToneRegisterScope::Operator)
+  bool tryReserveChange(const T& value);
+
+  /**
+   * @brief Try to reserve change of an operator parameter through its mapping
+   * to registers.
+   * @param[in] slotAndValue Slot number and parameter value.
+   * @return @c true if change is accepted, otherwise @c false.
+   */
+  template <MappedToneParameter T>
+    requires(ToneParameterMapping<T>::kScope == ToneRegisterScope::Operator)
+  bool tryReserveChange(const parameter::SlotAndValue<T>& slotAndValue);
+
+  /**
+   * @brief Get the chip which an assign ID is bound to.
+   * @param[in] assignId Assign ID of @c Keyboard.
+   * @return Chip, or @c nullptr if @c assignId is out of range.
+   */
+  ChipVoices* chipOf(std::size_t assignId) noexcept;
+
+  /**
+   * @brief Reserve a write of tone parameter to active channels.
+   * @details The other channels are marked as stale and updated when a note is
+   * assigned to them.
+   * @param[in] registerIndex Index of the register in
+   * @c kToneRegisterAddresses.
+   * @param[in] data Data to write.
+   */
+  void reserveToneRegisterWrite(std::size_t registerIndex,
+                                std::uint8_t data) noexcept;
+
+  /**
+   * @brief Reserve a write of tone parameter shared by all channels to chips
+   * which have active channels.
+   * @details The other chips are marked as outdated.
+   * @param[in] address Address.
+   * @param[in] data Data to write.
+   */
+  void reserveChipParameterWrite(std::uint16_t address,
+                                 std::uint8_t data) noexcept;
 
   /**
    * @brief Reserve register changes related on note-on event.
@@ -183,6 +496,14 @@ class FmAudioSource : public juce::AudioSource {
    */
   bool reservePitchChange();
 
+  /**
+   * @brief Reserve register changes for note-on notes of a MIDI channel
+   * related on pitch change event.
+   * @param[in] midiChannel MIDI channel from 1 to 16.
+   * @return @c true if the reservation is success, otherwise @c false.
+   */
+  bool reservePitchChange(int midiChannel);
+
   /**
    * @brief Reserve register changes for a specific note related on pitch change
    * event.
@@ -192,10 +513,50 @@ class FmAudioSource : public juce::AudioSource {
   bool reservePitchChange(const NoteAssignment& assignment);
 
   /**
-   * @brief Reserve register changes related to update tone parameters.
+   * @brief Reserve register changes related to update tone parameters of all
+   * chips.
    */
   void reserveUpdatingAllToneParameter();
 
+  /**
+   * @brief Reserve register changes related to update tone parameters of a
+   * chip.
+   * @param[in] voices Chip to update.
+   */
+  void reserveUpdatingToneParameter(ChipVoices& voices);
+
+  /**
+   * @brief Reserve writes of missed tone changes to a channel before note-on.
+   * @param[in] voices Chip which has the channel.
+   * @param[in] channel Channel number in the chip.
+   */
+  void reserveCatchingUpToneParameter(ChipVoices& voices, std::size_t channel);
+
+  /**
+   * @brief Reserve writes of ramps whose ticks are not later than the given
+   * time.
+   * @param[in] sampleIndex Sample index in synthesis rate.
+   */
+  void reserveModulationUntil(std::uint64_t sampleIndex) noexcept;
+
+  /**
+   * @brief Reserve a write of a value of a ramped parameter.
+   * @param[in] control Control index of @c modulation_.
+   * @param[in] value Parameter value.
+   */
+  void reserveModulationWrite(std::size_t control, std::uint8_t value) noexcept;
+
+  /**
+   * @brief Stop ramps and set them to the current tone parameters.
+   * @return Bit mask of controls which were moving.
+   */
+  std::uint32_t resetModulation() noexcept;
+
+  /**
+   * @brief Reserve writes of the current note-on mask to all note-on voices.
+   */
+  void reserveNoteOnMaskWrite();
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FmAudioSource)
 };
 }  // namespace audio
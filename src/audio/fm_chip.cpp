@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "fm_chip.h"
+
+#include <algorithm>
+
+#include "register_trace.h"
+
+namespace audio {
+namespace {
+/// Address of key-on register.
+constexpr std::uint16_t kKeyOnAddress{0x28u};
+
+/**
+ * @brief Check whether two register writes are to the same address.
+ * @param[in] a Register write.
+ * @param[in] b Register write.
+ * @return @c true if addresses and states of pin A1 are the same.
+ */
+constexpr bool isSameAddress(const Register& a, const Register& b) noexcept {
+  return a.pinA1 == b.pinA1 && a.address == b.address;
+}
+}  // namespace
+
+FmChip::FmChip(std::size_t queueCapacity)
+    : ym2608_(std::make_unique<FmOnlyYm2608>(interface_)),
+      reservedChanges_(queueCapacity) {
+  ym2608_->set_fidelity(ymfm::opn_fidelity::OPN_FIDELITY_MIN);
+}
+
+FmChip::~FmChip() = default;
+
+void FmChip::allocate(std::size_t queueCapacity) {
+  reservedChanges_.allocate(queueCapacity);
+}
+
+void FmChip::reset() {
+  ym2608_->reset();
+
+  // Writes reserved before reset are overwritten by the following writes.
+  reservedChanges_.clear();
+  isShadowRegisterValid_.reset();
+
+  keyOnChannelMask_ = 0u;
+  soundingChannelMask_ = 0u;
+}
+
+void FmChip::render(ymfm::ym2608::output_data* output,
+                    std::size_t numSamples) {
+  while (numSamples) {
+    reservedChanges_.drainUntil(
+        renderedSampleCount_,
+        [this](const Register& change) { writeRegister(change); });
+
+    // Generate samples until the next change.
+    std::size_t count = numSamples;
+    if (const auto timestamp = reservedChanges_.frontTimestamp()) {
+      count = static_cast<std::size_t>(std::min<std::uint64_t>(
+          count, timestamp.value() - renderedSampleCount_));
+    }
+
+    if (isSilent()) {
+      // Envelopes have finished, so only the timing of the emulator advances.
+      ym2608_->advanceFm(static_cast<std::uint32_t>(count));
+      std::fill_n(output, count, ymfm::ym2608::output_data{});
+      soundingChannelMask_ = 0u;
+    } else {
+      // A channel in release keeps sounding until its envelope finishes.
+      soundingChannelMask_ = static_cast<std::uint8_t>(
+          keyOnChannelMask_ | ym2608_->soundingChannelMask());
+      ym2608_->generateFm(output, static_cast<std::uint32_t>(count),
+                          soundingChannelMask_);
+    }
+
+    output += count;
+    numSamples -= count;
+    renderedSampleCount_ += count;
+
+    if (numSamples) {
+      ++renderSplitCount_;
+    }
+  }
+}
+
+void FmChip::triggerReservedChanges() {
+  reservedChanges_.drain(
+      [this](const Register& change) { writeRegister(change); });
+}
+
+void FmChip::setReservationTimestamp(std::uint64_t sampleIndex) noexcept {
+  if (sampleIndex <= reservationTimestamp_) {
+    return;
+  }
+
+  reservationTimestamp_ = sampleIndex;
+
+  // Do not move a later change to earlier time by overwriting.
+  coalescingBarrier_ = reservedChanges_.nextPosition();
+}
+
+void FmChip::reserveRegisterWrite(std::uint16_t address,
+                                  std::uint8_t data) noexcept {
+  if (address == kKeyOnAddress) {
+    if (reservedChanges_.tryPush(Register(address, data),
+                                 reservationTimestamp_)) {
+      coalescingBarrier_ = reservedChanges_.nextPosition();
+    }
+    return;
+  }
+
+  const std::size_t index = address % kRegisterCount_;
+  if (isShadowRegisterValid_[index] && shadowRegisters_[index] == data) {
+    // No need to change register.
+    return;
+  }
+
+  const Register change(address, data);
+
+  if (const auto position = reservedWritePositions_[index];
+      coalescingBarrier_ <= position) {
+    if (auto* reserved = reservedChanges_.findPending(position);
+        reserved && isSameAddress(*reserved, change)) {
+      reserved->data = data;
+      shadowRegisters_[index] = data;
+      return;
+    }
+  }
+
+  const auto position = reservedChanges_.nextPosition();
+  if (!reservedChanges_.tryPush(change, reservationTimestamp_)) {
+    return;
+  }
+
+  reservedWritePositions_[index] = position;
+  shadowRegisters_[index] = data;
+  isShadowRegisterValid_.set(index);
+}
+
+void FmChip::reserveBlockAndFNumberWrite(std::uint16_t fNum1Address,
+                                         std::uint16_t blockAndFNum) noexcept {
+  constexpr std::uint16_t kBlockFNum2AddressOffset{4};
+  const std::uint16_t blockFNum2Address =
+      fNum1Address + kBlockFNum2AddressOffset;
+  const auto blockFNum2 = static_cast<std::uint8_t>(blockAndFNum >> 8);
+  const auto fNum1 = static_cast<std::uint8_t>(blockAndFNum & 0x00ff);
+
+  const std::size_t highIndex = blockFNum2Address % kRegisterCount_;
+  const std::size_t lowIndex = fNum1Address % kRegisterCount_;
+  if (isShadowRegisterValid_[highIndex] && isShadowRegisterValid_[lowIndex] &&
+      shadowRegisters_[highIndex] == blockFNum2 &&
+      shadowRegisters_[lowIndex] == fNum1) {
+    // No need to change registers.
+    return;
+  }
+
+  const Register high(blockFNum2Address, blockFNum2);
+  const Register low(fNum1Address, fNum1);
+
+  // Overwrite the reserved pair if these are placed next to each other.
+  if (const auto highPosition = reservedWritePositions_[highIndex];
+      coalescingBarrier_ <= highPosition &&
+      reservedWritePositions_[lowIndex] == highPosition + 1u) {
+    auto* reservedHigh = reservedChanges_.findPending(highPosition);
+    auto* reservedLow = reservedChanges_.findPending(highPosition + 1u);
+    if (reservedHigh && reservedLow && isSameAddress(*reservedHigh, high) &&
+        isSameAddress(*reservedLow, low)) {
+      reservedHigh->data = blockFNum2;
+      reservedLow->data = fNum1;
+      shadowRegisters_[highIndex] = blockFNum2;
+      shadowRegisters_[lowIndex] = fNum1;
+      return;
+    }
+  }
+
+  const auto highPosition = reservedChanges_.nextPosition();
+  if (!reservedChanges_.tryPush({high, low}, reservationTimestamp_)) {
+    return;
+  }
+
+  reservedWritePositions_[highIndex] = highPosition;
+  reservedWritePositions_[lowIndex] = highPosition + 1u;
+  shadowRegisters_[highIndex] = blockFNum2;
+  shadowRegisters_[lowIndex] = fNum1;
+  isShadowRegisterValid_.set(highIndex);
+  isShadowRegisterValid_.set(lowIndex);
+}
+
+void FmChip::reserveUncoalescedWrite(const Register& change) noexcept {
+  if (!reservedChanges_.tryPush(change, reservationTimestamp_)) {
+    return;
+  }
+  coalescingBarrier_ = reservedChanges_.nextPosition();
+
+  const std::size_t index =
+      (change.pinA1 ? 0x100u : 0u) | std::size_t{change.address};
+  shadowRegisters_[index] = change.data;
+  isShadowRegisterValid_.set(index);
+}
+
+void FmChip::setTraceRecorder(RegisterTraceRecorder* recorder,
+                              std::uint8_t chipIndex) noexcept {
+  traceRecorder_ = recorder;
+  traceChipIndex_ = chipIndex;
+  if (!recorder) {
+    return;
+  }
+
+  const auto recordShadow = [&](std::size_t index) {
+    if (isShadowRegisterValid_[index]) {
+      recorder->record(chipIndex, renderedSampleCount_,
+                       Register(static_cast<std::uint16_t>(index),
+                                shadowRegisters_[index]));
+    }
+  };
+
+  for (std::size_t index = 0; index < kRegisterCount_; ++index) {
+    // $a4-$a6 and $ac-$ae are latched, so each of them precedes its pair.
+    switch (index & 0xfcu) {
+      case 0xa0u:
+      case 0xa8u:
+        recordShadow(index + 4u);
+        recordShadow(index);
+        break;
+      case 0xa4u:
+      case 0xacu:
+        break;
+      default:
+        recordShadow(index);
+        break;
+    }
+  }
+}
+
+void FmChip::writeRegister(const Register& change) {
+  if (!change.pinA1 && change.address == kKeyOnAddress) {
+    // The high nibble is slot mask and the low 3 bits are channel, where 3
+    // is unused.
+    const std::uint8_t channel = change.data & 0x07u;
+    const std::uint8_t bit = 1u << (channel < 4u ? channel : channel - 1u);
+    if (change.data & 0xf0u) {
+      keyOnChannelMask_ |= bit;
+    } else {
+      keyOnChannelMask_ &= ~bit;
+    }
+  }
+
+  ++appliedRegisterWriteCount_;
+
+  if (traceRecorder_) {
+    traceRecorder_->record(traceChipIndex_, renderedSampleCount_, change);
+  }
+
+  if (change.pinA1) {
+    ym2608_->write_address_hi(change.address);
+    ym2608_->write_data_hi(change.data);
+  } else {
+    ym2608_->write_address(change.address);
+    ym2608_->write_data(change.data);
+  }
+}
+}  // namespace audio
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <ymfm_opn.h>
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+
+#include "fm_only_ym2608.h"
+#include "register.h"
+#include "register_ring_buffer.h"
+
+namespace audio {
+class RegisterTraceRecorder;
+
+/**
+ * @brief An emulator instance with its own queue of timestamped register
+ * writes.
+ * @details Writes are coalesced through a shadow register file before they
+ * reach the emulator, and they are applied at their timestamps while
+ * rendering.
+ *
+ * Only FM channels which are keyed on or still releasing are emulated. When no
+ * channel is keyed on and every envelope has finished release, operators are
+ * not clocked and zeros are output until the next write of $28 keys on a
+ * channel. The envelope counter and LFO keep running, so the next note starts
+ * from the same state as full emulation.
+ * @note It must be used on a single thread.
+ */
+class FmChip {
+ public:
+  /// The number of FM channels in a chip.
+  static constexpr std::size_t kChannelCount{6};
+
+  /**
+   * @brief Constructor.
+   * @param[in] queueCapacity Initial capacity of the register write queue.
+   */
+  explicit FmChip(std::size_t queueCapacity);
+
+  /**
+   * @brief Destructor.
+   */
+  ~FmChip();
+
+  /**
+   * @brief Allocate the register write queue and discard reserved writes.
+   * @param[in] queueCapacity The minimum number of writes the queue can hold.
+   */
+  void allocate(std::size_t queueCapacity);
+
+  /**
+   * @brief Reset the emulator, and discard reserved writes and the shadow
+   * registers.
+   */
+  void reset();
+
+  /**
+   * @brief Get output rate of the emulator.
+   * @param[in] clockHz Input clock of the chip.
+   * @return Output rate (Hz.)
+   */
+  std::uint32_t sampleRate(std::uint32_t clockHz) const {
+    return ym2608_->sample_rate(clockHz);
+  }
+
+  /**
+   * @brief Generate raw samples with applying reserved writes at their
+   * timestamps.
+   * @param[out] output Buffer to store samples.
+   * @param[in] numSamples The number of samples to generate.
+   */
+  void render(ymfm::ym2608::output_data* output, std::size_t numSamples);
+
+  /**
+   * @brief Apply all reserved writes immediately regardless of timestamps.
+   */
+  void triggerReservedChanges();
+
+  /**
+   * @brief Set the time when writes reserved from now on are applied.
+   * @param[in] sampleIndex Index of sample in synthesis rate. If it is earlier
+   * than the current reservation time, the current one is kept.
+   */
+  void setReservationTimestamp(std::uint64_t sampleIndex) noexcept;
+
+  /**
+   * @brief Reserve a register write.
+   * @details A write whose value equals to the shadow register is dropped, and
+   * a write to the address which is already reserved overwrites it. A write to
+   * $28 is always queued, and reserved writes before it are not overwritten to
+   * keep their order around note-on and -off.
+   * @param[in] address Address. Bit 8 represents a state of pin A1.
+   * @param[in] data Data to write.
+   * @note Use @c reserveBlockAndFNumberWrite() for $a0-$a6.
+   */
+  void reserveRegisterWrite(std::uint16_t address, std::uint8_t data) noexcept;
+
+  /**
+   * @brief Reserve register writes of Block and F-Number.
+   * @details $a4-$a6 is latched until $a0-$a2 is written, and the latch is
+   * shared among channels. So both registers are always written as a pair in
+   * this order, or dropped together.
+   * @param[in] fNum1Address Address of F-Number 1 ($a0-$a2 or $1a0-$1a2).
+   * @param[in] blockAndFNum Block (bit 11-13) and F-Number (bit 0-10).
+   */
+  void reserveBlockAndFNumberWrite(std::uint16_t fNum1Address,
+                                   std::uint16_t blockAndFNum) noexcept;
+
+  /**
+   * @brief Reserve a register write as it is, without dropping or coalescing.
+   * @details It is for replaying writes which were applied to an emulator.
+   * @param[in] change Register write.
+   */
+  void reserveUncoalescedWrite(const Register& change) noexcept;
+
+  /**
+   * @brief Set the recorder of writes applied to the emulator.
+   * @details Known values of the shadow registers are recorded first as the
+   * initial state, so trigger reserved writes before it.
+   * @param[in] recorder Recorder which has started, or @c nullptr to stop
+   * recording.
+   * @param[in] chipIndex Index of this chip in the recorder.
+   */
+  void setTraceRecorder(RegisterTraceRecorder* recorder,
+                        std::uint8_t chipIndex) noexcept;
+
+  /**
+   * @brief Whether the chip is silent and nothing is going to change it.
+   * @return @c true if emulation is skipped and no write is reserved.
+   */
+  bool isIdle() const noexcept {
+    return isSilent() && reservedChanges_.empty();
+  }
+
+  /**
+   * @brief Get channels which were sounding in the latest rendering.
+   * @return Channels which were keyed on or in release. Bit n is FM channel n.
+   */
+  std::uint8_t soundingChannelMask() const noexcept {
+    return soundingChannelMask_;
+  }
+
+  /**
+   * @brief Get channels which are keyed on by applied writes.
+   * @return Channel mask. Bit n is FM channel n.
+   */
+  std::uint8_t keyOnChannelMask() const noexcept { return keyOnChannelMask_; }
+
+  /**
+   * @brief Get envelope level of a channel.
+   * @param[in] channel FM channel number.
+   * @return Level from 0 (silent) to 1023.
+   */
+  std::uint32_t envelopeLevelOf(std::size_t channel) const noexcept {
+    return ym2608_->envelopeLevelOf(static_cast<std::uint32_t>(channel));
+  }
+
+  /**
+   * @brief Get the number of samples generated since construction.
+   * @return Sample count in synthesis rate.
+   */
+  std::uint64_t renderedSampleCount() const noexcept {
+    return renderedSampleCount_;
+  }
+
+  /**
+   * @brief Get the number of register writes applied to the emulator since
+   * construction.
+   * @return The number of writes.
+   */
+  std::uint64_t appliedRegisterWriteCount() const noexcept {
+    return appliedRegisterWriteCount_;
+  }
+
+  /**
+   * @brief Get the number of times rendering was split at a timestamp of a
+   * reserved write since construction.
+   * @return The number of splits.
+   */
+  std::uint64_t renderSplitCount() const noexcept { return renderSplitCount_; }
+
+  /**
+   * @brief Get the number of register writes discarded because the queue was
+   * full.
+   * @return The number of discarded writes.
+   */
+  std::uint64_t overflowedRegisterWriteCount() const noexcept {
+    return reservedChanges_.overflowCount();
+  }
+
+ private:
+  /// Emulator interface.
+  ymfm::ymfm_interface interface_;
+
+  /// Emulator.
+  std::unique_ptr<FmOnlyYm2608> ym2608_;
+
+  /// The number of samples generated since construction.
+  std::uint64_t renderedSampleCount_{};
+
+  /// The number of register writes applied to the emulator.
+  std::uint64_t appliedRegisterWriteCount_{};
+
+  /// The number of times rendering was split by reserved writes.
+  std::uint64_t renderSplitCount_{};
+
+  /// Queue of register changes.
+  RegisterRingBuffer reservedChanges_;
+
+  /// Number of register addresses. $100-$1ff are addresses with pin A1.
+  static constexpr std::size_t kRegisterCount_{0x200};
+
+  /// Register values which the chip will have after triggering changes.
+  std::array<std::uint8_t, kRegisterCount_> shadowRegisters_{};
+
+  /// Whether a value in @c shadowRegisters_ is known.
+  std::bitset<kRegisterCount_> isShadowRegisterValid_;
+
+  /// Position of the latest reserved write in @c reservedChanges_ per address.
+  std::array<std::uint64_t, kRegisterCount_> reservedWritePositions_{};
+
+  /// Recorder of applied writes, or @c nullptr if they are not recorded.
+  RegisterTraceRecorder* traceRecorder_{};
+
+  /// Index of this chip in @c traceRecorder_.
+  std::uint8_t traceChipIndex_{};
+
+  /// Reserved writes before this position must not be overwritten.
+  std::uint64_t coalescingBarrier_{};
+
+  /// Timestamp given to reserved writes.
+  std::uint64_t reservationTimestamp_{};
+
+  /// Channels which are keyed on. Bit n is FM channel n.
+  std::uint8_t keyOnChannelMask_{};
+
+  /// Channels which were sounding in the latest rendering.
+  std::uint8_t soundingChannelMask_{};
+
+  /**
+   * @brief Whether emulation can be skipped.
+   * @return @c true if no channel is keyed on and all envelopes have finished
+   * release.
+   */
+  bool isSilent() const noexcept {
+    return !keyOnChannelMask_ && !ym2608_->soundingChannelMask();
+  }
+
+  /**
+   * @brief Write a register change to the emulator.
+   * @param[in] change Register change.
+   */
+  void writeRegister(const Register& change);
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FmChip)
+};
+}  // namespace audio
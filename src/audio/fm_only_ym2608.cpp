@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "fm_only_ym2608.h"
+
+#include <algorithm>
+
+namespace audio {
+namespace {
+/// The number of operators in a channel.
+constexpr std::uint32_t kOperatorCount{4};
+
+/// Envelope attenuation of silence.
+constexpr std::uint32_t kMaxAttenuation{0x3ffu};
+
+/// Right shift of FM output. OPNA is 13-bit with no intermediate clipping.
+constexpr std::uint32_t kOutputShift{1};
+
+/// Clipping level of FM output.
+constexpr std::int32_t kMaxOutput{32767};
+}  // namespace
+
+void FmOnlyYm2608::generateFm(output_data* output, std::uint32_t numSamples,
+                              std::uint32_t channelMask) {
+  channelMask &= kAllChannelMask;
+
+  for (std::uint32_t i = 0; i < numSamples; ++i, ++output) {
+    m_fm.clock(channelMask);
+
+    fm_engine::output_data fm;
+    m_fm.output(fm.clear(), kOutputShift, kMaxOutput, channelMask);
+    fm.clamp16();
+
+    output->data[0] = fm.data[0];
+    output->data[1] = fm.data[1];
+    output->data[2] = 0;
+  }
+}
+
+void FmOnlyYm2608::advanceFm(std::uint32_t numSamples) {
+  for (std::uint32_t i = 0; i < numSamples; ++i) {
+    m_fm.clock(0u);
+  }
+}
+
+std::uint32_t FmOnlyYm2608::soundingChannelMask() const noexcept {
+  std::uint32_t mask{};
+  for (std::uint32_t ch = 0; ch < fm_engine::CHANNELS; ++ch) {
+    const auto* channel = m_fm.debug_channel(ch);
+    for (std::uint32_t op = 0; op < kOperatorCount; ++op) {
+      const auto* slot = channel->debug_operator(op);
+      if (slot->debug_eg_state() != ymfm::EG_RELEASE ||
+          slot->debug_eg_attenuation() < kMaxAttenuation) {
+        mask |= 1u << ch;
+        break;
+      }
+    }
+  }
+  return mask;
+}
+
+std::uint32_t FmOnlyYm2608::envelopeLevelOf(
+    std::uint32_t channel) const noexcept {
+  const auto* ch = m_fm.debug_channel(channel);
+  std::uint32_t attenuation{kMaxAttenuation};
+  for (std::uint32_t op = 0; op < kOperatorCount; ++op) {
+    attenuation =
+        std::min(attenuation, ch->debug_operator(op)->debug_eg_attenuation());
+  }
+  return kMaxAttenuation - attenuation;
+}
+}  // namespace audio
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <ymfm_opn.h>
+
+#include <cstdint>
+
+namespace audio {
+/**
+ * @brief YM2608 emulator which clocks only FM channels selected by the caller.
+ * @details SSG, rhythm and ADPCM units are never clocked, because this plugin
+ * uses only the FM part.
+ *
+ * The FM part is clocked once per 144 input clocks, and each output sample is
+ * an FM sample. Higher fidelity of the emulator raises only the rate of the
+ * other units and would hold each FM sample, so it is not used.
+ */
+class FmOnlyYm2608 : public ymfm::ym2608 {
+ public:
+  using ymfm::ym2608::ym2608;
+
+  /// Channel mask which represents all FM channels.
+  static constexpr std::uint32_t kAllChannelMask{0x3fu};
+
+  /**
+   * @brief Generate samples of FM channels.
+   * @param[out] output Buffer to store samples. SSG output is always zero.
+   * @param[in] numSamples The number of samples to generate.
+   * @param[in] channelMask Channels to clock and output. Bit n is FM channel n.
+   */
+  void generateFm(output_data* output, std::uint32_t numSamples,
+                  std::uint32_t channelMask);
+
+  /**
+   * @brief Advance the FM part without clocking any channel.
+   * @details The envelope counter, LFO and noise keep running as in
+   * @c generateFm(), so a channel keyed on later behaves the same.
+   * @param[in] numSamples The number of samples to advance.
+   */
+  void advanceFm(std::uint32_t numSamples);
+
+  /**
+   * @brief Get FM channels whose envelopes have not finished.
+   * @details An envelope finishes when it reaches the maximum attenuation in
+   * release, and then it keeps the same state until key-on. ymfm stops output
+   * of a channel earlier, but its envelopes must be clocked until then so that
+   * the next attack starts from the same level.
+   * @return Channel mask. Bit n is FM channel n.
+   */
+  std::uint32_t soundingChannelMask() const noexcept;
+
+  /**
+   * @brief Get envelope level of the loudest operator of a channel.
+   * @param[in] channel FM channel number.
+   * @return Level from 0 (silent) to 1023.
+   */
+  std::uint32_t envelopeLevelOf(std::uint32_t channel) const noexcept;
+};
+}  // namespace audio
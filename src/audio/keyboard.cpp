@@ -3,180 +3,298 @@
 
 #include "keyboard.h"
 
-#include <algorithm>
-#include <numeric>
-#include <set>
+#include <bit>
 #include <stdexcept>
 #include <utility>
-#include <vector>
 
 namespace audio {
-Keyboard::Keyboard(std::size_t polyphony)
-    : polyphony_(polyphony), assignableIdQueue_(polyphony) {
-  if (!polyphony) {
-    throw std::invalid_argument("Polyphony must be greater than zero.");
+namespace {
+/**
+ * @brief Get a bit mask of identifiers from 0 to @c polyphony - 1.
+ * @param[in] polyphony The number of polyphony.
+ * @return Bit mask.
+ */
+constexpr std::uint64_t maskOf(std::size_t polyphony) noexcept {
+  return polyphony < 64u ? (std::uint64_t{1u} << polyphony) - 1u
+                         : ~std::uint64_t{};
+}
+}  // namespace
+
+Keyboard::Keyboard(std::size_t polyphony) : polyphony_(polyphony) {
+  if (!polyphony || kMaxPolyphony < polyphony) {
+    throw std::invalid_argument("Polyphony is out of range.");
   }
 
-  std::iota(std::begin(assignableIdQueue_), std::end(assignableIdQueue_), 0u);
+  noteToVoice_.fill(kNoVoice);
+  oldestOfVelocity_.fill(kNoVoice);
+  newestOfVelocity_.fill(kNoVoice);
+  resetAssignableIds();
 }
 
-std::deque<NoteAssignment> Keyboard::setPolyphony(std::size_t newPolyphony) {
-  if (!newPolyphony) {
-    throw std::invalid_argument("Polyphony must be greater than zero.");
+std::span<NoteAssignment> Keyboard::setPolyphony(
+    std::size_t newPolyphony,
+    std::span<NoteAssignment, kMaxPolyphony> noteOffs) {
+  if (!newPolyphony || kMaxPolyphony < newPolyphony) {
+    throw std::invalid_argument("Polyphony is out of range.");
   }
 
   const std::size_t oldPolyphony = std::exchange(polyphony_, newPolyphony);
+  usedAssignIdMask_ = maskOf(newPolyphony);
 
   if (newPolyphony < oldPolyphony) {
-    // Shrink polyphony.
-    std::size_t decreasedSize = newPolyphony - oldPolyphony;
-    if (std::size(noteOnQueue_) + std::size(assignableIdQueue_) <
-        decreasedSize) {
-      throw std::range_error("Polyphony state is broken.");
-    }
-
-    // Reduce polyphony from assignable ID.
-    const std::size_t nDeletableAssignableId =
-        std::min(decreasedSize, std::size(assignableIdQueue_));
-    assignableIdQueue_.erase(
-        std::cbegin(assignableIdQueue_),
-        std::cbegin(assignableIdQueue_) + nDeletableAssignableId);
-    decreasedSize -= nDeletableAssignableId;
-    if (!decreasedSize) {
-      return {};
+    // Release note-on voices which are removed.
+    std::size_t count{};
+    for (std::uint8_t id = oldestNoteOn_; id != kNoVoice;) {
+      const std::uint8_t newer = voices_[id].newer;
+      if (newPolyphony <= id) {
+        noteOffs[count++] = releaseNoteOn(id);
+      }
+      id = newer;
     }
 
-    // Reduce polyphony from older note-ons.
-    std::deque<NoteAssignment> noteOffQueue;
-    std::transform(
-        std::cbegin(noteOnQueue_), std::cbegin(noteOnQueue_) + decreasedSize,
-        std::back_inserter(noteOffQueue), [](const NoteAssignment& assignment) {
-          return NoteAssignment{
-              .assignId{assignment.assignId},
-              .note{Note::noteOff(assignment.note.channel,
-                                  assignment.note.noteNumber)}};
-        });
-    noteOnQueue_.erase(std::cbegin(noteOnQueue_),
-                       std::cbegin(noteOnQueue_) + decreasedSize);
-    return noteOffQueue;
-  } else if (oldPolyphony < newPolyphony) {
-    // Aggregate current used IDs.
-    std::set<std::size_t> usedIds(std::cbegin(assignableIdQueue_),
-                                  std::cend(assignableIdQueue_));
-    std::transform(
-        std::cbegin(noteOnQueue_), std::cend(noteOnQueue_),
-        std::inserter(usedIds, std::end(usedIds)),
-        [](const NoteAssignment& assignment) { return assignment.assignId; });
-    if (std::size(usedIds) != oldPolyphony) {
-      throw std::range_error("Polyphony state is broken.");
+    // Remove identifiers from assignable ones keeping their order.
+    std::size_t kept{};
+    for (std::size_t i = 0; i < assignableCount_; ++i) {
+      const std::uint8_t id =
+          assignableIds_[(assignableHead_ + i) % kMaxPolyphony];
+      if (id < newPolyphony) {
+        assignableIds_[(assignableHead_ + kept++) % kMaxPolyphony] = id;
+      }
     }
+    assignableCount_ = kept;
 
-    // Get difference between used IDs and polyphony number sequence.
-    std::vector<std::size_t> polyphonies(newPolyphony);
-    std::iota(std::begin(polyphonies), std::end(polyphonies), 0u);
+    return noteOffs.first(count);
+  }
 
-    std::vector<std::size_t> difference;
-    std::set_difference(std::cbegin(polyphonies), std::cend(polyphonies),
-                        std::cbegin(usedIds), std::cend(usedIds),
-                        std::back_inserter(difference));
+  // New identifiers are assigned first.
+  for (std::size_t id = newPolyphony; oldPolyphony < id--;) {
+    assignableHead_ = (assignableHead_ + kMaxPolyphony - 1u) % kMaxPolyphony;
+    assignableIds_[assignableHead_] = static_cast<std::uint8_t>(id);
+    ++assignableCount_;
+  }
 
-    // Add new IDs from the difference.
-    std::size_t increasedSize = newPolyphony - oldPolyphony;
-    if (std::size(difference) < increasedSize) {
-      throw std::range_error("Polyphony state is broken.");
-    }
-    assignableIdQueue_.insert(std::cbegin(assignableIdQueue_),
-                              std::begin(difference),
-                              std::begin(difference) + increasedSize);
+  return {};
+}
 
+std::optional<NoteAssignment> Keyboard::tryNoteOff(const Note& note) noexcept {
+  const auto noteIndex = noteIndexOf(note);
+  if (note.isNoteOn() || !noteIndex.has_value()) {
     return {};
-  } else {
+  }
+
+  const std::uint8_t id = noteToVoice_[noteIndex.value()];
+  if (id == kNoVoice) {
     return {};
   }
+
+  return releaseNoteOn(id);
+}
+
+std::span<NoteAssignment> Keyboard::forceAllNoteOff(
+    std::span<NoteAssignment, kMaxPolyphony> noteOffs) noexcept {
+  std::size_t count{};
+  while (oldestNoteOn_ != kNoVoice) {
+    noteOffs[count++] = releaseNoteOn(oldestNoteOn_);
+  }
+
+  resetAssignableIds();
+
+  return noteOffs.first(count);
 }
 
-std::set<std::size_t> Keyboard::usedAssignIds() const {
-  std::set<std::size_t> ids;
-  std::transform(
-      std::cbegin(noteOnQueue_), std::cend(noteOnQueue_),
-      std::inserter(ids, std::end(ids)),
-      [](const NoteAssignment& assignment) { return assignment.assignId; });
-  ids.insert(std::cbegin(assignableIdQueue_), std::cend(assignableIdQueue_));
-  return ids;
+std::optional<std::size_t> Keyboard::noteIndexOf(const Note& note) noexcept {
+  // MIDI channel starts from 1.
+  const auto channel = static_cast<std::size_t>(note.channel - 1);
+  const auto noteNumber = static_cast<std::size_t>(note.noteNumber);
+  if (kMidiChannelCount <= channel || kNoteNumberCount <= noteNumber) {
+    return std::nullopt;
+  }
+  return channel * kNoteNumberCount + noteNumber;
 }
 
-std::deque<NoteAssignment> Keyboard::tryNoteOn(const Note& note) {
-  if (note.isNoteOn() == false) {
+std::span<NoteAssignment> Keyboard::tryNoteOn(
+    const Note& note,
+    std::span<NoteAssignment, kMaxNoteOnChangeCount> changes) noexcept {
+  const auto noteIndex = noteIndexOf(note);
+  if (!note.isNoteOn() || !noteIndex.has_value()) {
     return {};
   }
 
-  std::deque<NoteAssignment> changes;
+  std::size_t count{};
+  std::uint8_t id{kNoVoice};
 
   // Note off if there is any note which has the same note number.
-  if (const auto&& noteOffAssignment = tryNoteOff(note);
-      noteOffAssignment.has_value()) {
-    changes.push_back(std::move(noteOffAssignment.value()));
+  if (const std::uint8_t sameNote = noteToVoice_[noteIndex.value()];
+      sameNote != kNoVoice) {
+    changes[count++] = releaseNoteOn(sameNote);
+    if (isSameNoteRetriggerEnabled_) {
+      id = sameNote;
+    }
+  } else if (!assignableCount_) {
+    // Force a note to do note-off. Its identifier is assigned again.
+    id = victim();
+    changes[count++] = releaseNoteOn(id);
   }
 
-  if (assignableIdQueue_.empty()) {
-    // Force oldest note to do note-off.
-    const auto& oldest = noteOnQueue_.front();
-    changes.push_back(NoteAssignment{
-        .assignId{oldest.assignId},
-        .note{Note::noteOff(oldest.note.channel, oldest.note.noteNumber)}});
-    assignableIdQueue_.push_back(oldest.assignId);
-    noteOnQueue_.pop_front();
+  if (id == kNoVoice) {
+    // Released identifiers are assigned from the one released the earliest.
+    id = assignableIds_[assignableHead_];
+    assignableHead_ = (assignableHead_ + 1u) % kMaxPolyphony;
   }
+  // The identifier is at the front or the back of assignable ones.
+  --assignableCount_;
 
-  // Assign new note-on.
-  const NoteAssignment newAssignment{.assignId{assignableIdQueue_.front()},
-                                     .note{note}};
-  assignableIdQueue_.pop_front();
-  noteOnQueue_.push_back(newAssignment);
-  changes.push_back(newAssignment);
+  pushNoteOn(id, note, noteIndex.value());
+  changes[count++] = NoteAssignment{.assignId{id}, .note{note}};
 
-  return changes;
+  return changes.first(count);
 }
 
-std::optional<NoteAssignment> Keyboard::tryNoteOff(const Note& note) {
-  if (note.isNoteOn()) {
-    return {};
+void Keyboard::setLevel(std::size_t assignId, std::uint8_t level) noexcept {
+  if (kMaxPolyphony <= assignId ||
+      !((noteOnAssignIdMask_ >> assignId) & 1u)) {
+    return;
   }
 
-  const auto sameNoteItr =
-      std::find_if(std::cbegin(noteOnQueue_), std::cend(noteOnQueue_),
-                   [&note](const NoteAssignment& assignment) {
-                     return (assignment.note.channel == note.channel) &&
-                            (assignment.note.noteNumber == note.noteNumber);
-                   });
-  if (sameNoteItr == std::cend(noteOnQueue_)) {
-    return {};
+  const auto id = static_cast<std::uint8_t>(assignId);
+  const auto bucket = static_cast<std::uint8_t>(
+      std::size_t{level} * kLevelBucketCount / kLevelCount);
+  if (voices_[id].levelBucket != bucket) {
+    unlinkLevelBucket(id);
+    linkLevelBucket(id, bucket);
   }
+}
+
+std::uint8_t Keyboard::victim() const noexcept {
+  switch (stealPolicy_) {
+    case StealPolicy::LowestVelocity: {
+      std::size_t word{};
+      while (!velocityMask_[word]) {
+        ++word;
+      }
+      const auto velocity =
+          word * kVelocityMaskBitCount +
+          static_cast<std::size_t>(std::countr_zero(velocityMask_[word]));
+      return oldestOfVelocity_[velocity];
+    }
 
-  assignableIdQueue_.push_back(sameNoteItr->assignId);
-  const NoteAssignment noteOffAssignment{
-      .assignId{sameNoteItr->assignId},
-      .note{Note::noteOff(sameNoteItr->note.channel,
-                          sameNoteItr->note.noteNumber)}};
-  noteOnQueue_.erase(sameNoteItr);
+    case StealPolicy::Quietest: {
+      const auto bucket = std::countr_zero(levelBucketMask_);
+      return static_cast<std::uint8_t>(
+          std::countr_zero(levelBucketVoiceMasks_[bucket]));
+    }
 
-  return noteOffAssignment;
+    case StealPolicy::Oldest:
+    default:
+      return oldestNoteOn_;
+  }
 }
 
-std::deque<NoteAssignment> Keyboard::forceAllNoteOff() {
-  std::deque<NoteAssignment> noteOffQueue;
-  std::transform(
-      std::cbegin(noteOnQueue_), std::cend(noteOnQueue_),
-      std::back_inserter(noteOffQueue), [](const NoteAssignment& assignment) {
-        return NoteAssignment{.assignId{assignment.assignId},
-                              .note{Note::noteOff(assignment.note.channel,
-                                                  assignment.note.noteNumber)}};
-      });
-  noteOnQueue_.clear();
-
-  assignableIdQueue_.resize(polyphony_);
-  std::iota(std::begin(assignableIdQueue_), std::end(assignableIdQueue_), 0u);
-
-  return noteOffQueue;
+void Keyboard::pushNoteOn(std::uint8_t id, const Note& note,
+                          std::size_t noteIndex) noexcept {
+  auto& voice = voices_[id];
+  voice.note = note;
+  voice.older = newestNoteOn_;
+  voice.newer = kNoVoice;
+
+  if (newestNoteOn_ == kNoVoice) {
+    oldestNoteOn_ = id;
+  } else {
+    voices_[newestNoteOn_].newer = id;
+  }
+  newestNoteOn_ = id;
+
+  const std::size_t velocity = note.velocity;
+  voice.olderOfVelocity = newestOfVelocity_[velocity];
+  voice.newerOfVelocity = kNoVoice;
+
+  if (newestOfVelocity_[velocity] == kNoVoice) {
+    oldestOfVelocity_[velocity] = id;
+    velocityMask_[velocity / kVelocityMaskBitCount] |=
+        std::uint64_t{1u} << (velocity % kVelocityMaskBitCount);
+  } else {
+    voices_[newestOfVelocity_[velocity]].newerOfVelocity = id;
+  }
+  newestOfVelocity_[velocity] = id;
+
+  // The level is unknown until it is set, so the voice is not stolen first.
+  linkLevelBucket(id, kLevelBucketCount - 1u);
+
+  noteToVoice_[noteIndex] = id;
+  noteOnAssignIdMask_ |= std::uint64_t{1u} << id;
+}
+
+NoteAssignment Keyboard::releaseNoteOn(std::uint8_t id) noexcept {
+  auto& voice = voices_[id];
+
+  if (voice.older == kNoVoice) {
+    oldestNoteOn_ = voice.newer;
+  } else {
+    voices_[voice.older].newer = voice.newer;
+  }
+  if (voice.newer == kNoVoice) {
+    newestNoteOn_ = voice.older;
+  } else {
+    voices_[voice.newer].older = voice.older;
+  }
+  voice.older = voice.newer = kNoVoice;
+
+  const std::size_t velocity = voice.note.velocity;
+  if (voice.olderOfVelocity == kNoVoice) {
+    oldestOfVelocity_[velocity] = voice.newerOfVelocity;
+  } else {
+    voices_[voice.olderOfVelocity].newerOfVelocity = voice.newerOfVelocity;
+  }
+  if (voice.newerOfVelocity == kNoVoice) {
+    newestOfVelocity_[velocity] = voice.olderOfVelocity;
+  } else {
+    voices_[voice.newerOfVelocity].olderOfVelocity = voice.olderOfVelocity;
+  }
+  voice.olderOfVelocity = voice.newerOfVelocity = kNoVoice;
+
+  if (oldestOfVelocity_[velocity] == kNoVoice) {
+    velocityMask_[velocity / kVelocityMaskBitCount] &=
+        ~(std::uint64_t{1u} << (velocity % kVelocityMaskBitCount));
+  }
+
+  unlinkLevelBucket(id);
+
+  if (const auto noteIndex = noteIndexOf(voice.note); noteIndex.has_value()) {
+    noteToVoice_[noteIndex.value()] = kNoVoice;
+  }
+  noteOnAssignIdMask_ &= ~(std::uint64_t{1u} << id);
+
+  // Released identifier is assigned last.
+  if (id < polyphony_) {
+    assignableIds_[(assignableHead_ + assignableCount_++) % kMaxPolyphony] =
+        id;
+  }
+
+  return NoteAssignment{
+      .assignId{id},
+      .note{Note::noteOff(voice.note.channel, voice.note.noteNumber)}};
+}
+
+void Keyboard::linkLevelBucket(std::uint8_t id, std::uint8_t bucket) noexcept {
+  voices_[id].levelBucket = bucket;
+  levelBucketVoiceMasks_[bucket] |= std::uint64_t{1u} << id;
+  levelBucketMask_ |= std::uint64_t{1u} << bucket;
+}
+
+void Keyboard::unlinkLevelBucket(std::uint8_t id) noexcept {
+  const std::uint8_t bucket = voices_[id].levelBucket;
+  levelBucketVoiceMasks_[bucket] &= ~(std::uint64_t{1u} << id);
+  if (!levelBucketVoiceMasks_[bucket]) {
+    levelBucketMask_ &= ~(std::uint64_t{1u} << bucket);
+  }
+}
+
+void Keyboard::resetAssignableIds() noexcept {
+  for (std::size_t id = 0; id < polyphony_; ++id) {
+    assignableIds_[id] = static_cast<std::uint8_t>(id);
+  }
+  assignableHead_ = 0;
+  assignableCount_ = polyphony_;
+  usedAssignIdMask_ = maskOf(polyphony_);
 }
 }  // namespace audio
@@ -3,10 +3,11 @@
 
 #pragma once
 
-#include <deque>
-#include <memory>
+#include <array>
+#include <cstdint>
+#include <limits>
 #include <optional>
-#include <set>
+#include <span>
 
 #include "note.h"
 
@@ -15,33 +16,66 @@ namespace audio {
  * @brief Information of note assignment on polyphony management.
  */
 struct NoteAssignment {
-  std::size_t assignId;  ///< Identifier of assignment place.
-  Note note;             ///< Note.
+  std::size_t assignId{};  ///< Identifier of assignment place.
+  Note note;               ///< Note.
 };
 
 /**
- * @brief A class to manage note-on and polyphony following FIFO strategy.
+ * @brief Policy to choose a note-on voice stolen when all voices are used.
+ */
+enum class StealPolicy : std::uint8_t {
+  Oldest,          ///< Steal the oldest note.
+  LowestVelocity,  ///< Steal the oldest of notes with the lowest velocity.
+  Quietest,        ///< Steal the note with the lowest level set by caller.
+};
+
+/**
+ * @brief A class to manage note-on and polyphony.
+ * @details Voices are kept in a fixed-size table. Note-on voices are linked in
+ * order of age, and also per velocity with a bit mask of used velocities, so
+ * the oldest or the lowest-velocity victim is found in constant time. Note-on
+ * voices are also grouped by level set by the caller with a bit mask of used
+ * buckets, so the quietest victim is found in constant time as well, where
+ * voices in the same bucket are chosen in order of identifier. A note
+ * is found from its channel and note number by a look-up table, so no
+ * operation allocates memory. Results are written to buffers given by the
+ * caller.
+ *
+ * Released voices are reused from the one released the longest time ago
+ * before any note-on voice is stolen, whichever the policy is, so a note is
+ * cut off only when all voices are held.
  */
 class Keyboard {
  public:
+  /// The maximum number of polyphony.
+  static constexpr std::size_t kMaxPolyphony{64};
+
+  /// The maximum number of assignment changed by a note-on.
+  static constexpr std::size_t kMaxNoteOnChangeCount{2};
+
   /**
    * @brief Constructor.
-   * @param[in] polyphony A number of polyphony. It must be greater than zero.
+   * @param[in] polyphony A number of polyphony. It must be greater than zero
+   * and not greater than @c kMaxPolyphony.
    * @exception @c std::invalid_argument.
    */
   Keyboard(std::size_t polyphony);
 
   /**
    * @brief Set the number of polyphony.
+   * @details Identifiers not less than @c newPolyphony are removed, and notes
+   * assigned to them are released.
    * @param[in] newPolyphony The maximum number of note that is able to note on
-   * at the same time. It must be greater than zero.
-   * @return A list of note assignment which should be note-on by polyphony
-   * change.
-   * @exception @c std::invalid_argument if @c newPolyphony is set to
-   * zero.
-   * @exception @c std::range_error if internal polyphony state is broken.
+   * at the same time. It must be greater than zero and not greater than
+   * @c kMaxPolyphony.
+   * @param[out] noteOffs Buffer to store assignments which should be note-off.
+   * @return A list of note assignment which should be note-off by polyphony
+   * change. It refers to @c noteOffs.
+   * @exception @c std::invalid_argument if @c newPolyphony is out of range.
    */
-  std::deque<NoteAssignment> setPolyphony(std::size_t newPolyphony);
+  std::span<NoteAssignment> setPolyphony(
+      std::size_t newPolyphony,
+      std::span<NoteAssignment, kMaxPolyphony> noteOffs);
 
   /**
    * @brief Get the number of polyphony.
@@ -50,45 +84,226 @@ class Keyboard {
   std::size_t polyphony() const noexcept { return polyphony_; }
 
   /**
-   * @brief Get a list of identifier which used and kept for note-on.
-   * @return A list of all identifier.
+   * @brief Set the policy to choose a stolen voice.
+   * @param[in] policy Policy.
+   */
+  void setStealPolicy(StealPolicy policy) noexcept { stealPolicy_ = policy; }
+
+  /**
+   * @brief Get the policy to choose a stolen voice.
+   * @return Policy.
    */
-  std::set<std::size_t> usedAssignIds() const;
+  StealPolicy stealPolicy() const noexcept { return stealPolicy_; }
 
   /**
-   * @brief Get information of notes which is note-on.
-   * @return A list of assignment information which notes are note-on.
+   * @brief Set whether a note which is already on is re-triggered on its
+   * voice.
+   * @details If it is disabled, the held note is released on its voice and
+   * the new note is assigned to another voice, so the release continues.
+   * @param[in] isEnabled Whether re-triggering is enabled.
    */
-  std::deque<NoteAssignment> noteOns() const noexcept { return noteOnQueue_; }
+  void setSameNoteRetriggerEnabled(bool isEnabled) noexcept {
+    isSameNoteRetriggerEnabled_ = isEnabled;
+  }
+
+  /**
+   * @brief Get identifiers which used and kept for note-on.
+   * @return Bit mask whose bit n represents identifier n.
+   */
+  std::uint64_t usedAssignIdMask() const noexcept { return usedAssignIdMask_; }
+
+  /**
+   * @brief Get identifiers which are note-on.
+   * @return Bit mask whose bit n represents identifier n.
+   */
+  std::uint64_t noteOnAssignIdMask() const noexcept {
+    return noteOnAssignIdMask_;
+  }
+
+  /**
+   * @brief Call a function with each note-on assignment from the oldest.
+   * @param[in] function Function called with @c const @c NoteAssignment&.
+   */
+  template <class F>
+  void forEachNoteOn(F&& function) const {
+    for (std::uint8_t id = oldestNoteOn_; id != kNoVoice;
+         id = voices_[id].newer) {
+      function(NoteAssignment{.assignId{id}, .note{voices_[id].note}});
+    }
+  }
 
   /**
    * @brief Try note on.
    * @param[in] note A note to try note-on.
+   * @param[out] changes Buffer to store assignments.
    * @return A list of assignment infomation which should be note-on or off.
+   * It refers to @c changes.
+   */
+  std::span<NoteAssignment> tryNoteOn(
+      const Note& note,
+      std::span<NoteAssignment, kMaxNoteOnChangeCount> changes) noexcept;
+
+  /**
+   * @brief Set the level of a note-on voice used by @c StealPolicy::Quietest.
+   * @details The voice is moved to the bucket of the level, so it takes
+   * constant time. A voice keeps the loudest level from note-on until the
+   * level is set. It is ignored if the voice is not note-on.
+   * @param[in] assignId Identifier of the voice.
+   * @param[in] level Level from 0 (silent) to 255.
    */
-  std::deque<NoteAssignment> tryNoteOn(const Note& note);
+  void setLevel(std::size_t assignId, std::uint8_t level) noexcept;
 
   /**
    * @brief Try note-off.
    * @param[in] note A note to try note-off.
    * @return An assignment information which should be note off.
    */
-  std::optional<NoteAssignment> tryNoteOff(const Note& note);
+  std::optional<NoteAssignment> tryNoteOff(const Note& note) noexcept;
 
   /**
    * @brief Do note-off for all notes.
-   * @return A list of note assignment which should do note-off.
+   * @param[out] noteOffs Buffer to store assignments.
+   * @return A list of note assignment which should do note-off. It refers to
+   * @c noteOffs.
    */
-  std::deque<NoteAssignment> forceAllNoteOff();
+  std::span<NoteAssignment> forceAllNoteOff(
+      std::span<NoteAssignment, kMaxPolyphony> noteOffs) noexcept;
 
  private:
-  /// A queue of note which is note-on.
-  std::deque<NoteAssignment> noteOnQueue_;
+  /// Identifier which represents no voice.
+  static constexpr std::uint8_t kNoVoice{0xffu};
+
+  /// The number of MIDI channels.
+  static constexpr std::size_t kMidiChannelCount{16};
+
+  /// The number of MIDI note numbers.
+  static constexpr std::size_t kNoteNumberCount{128};
+
+  /// The number of velocities, which covers all values of @c Note::velocity.
+  static constexpr std::size_t kVelocityCount{
+      std::size_t{std::numeric_limits<std::uint8_t>::max()} + 1u};
+
+  /// The number of levels, which covers all values given to @c setLevel().
+  static constexpr std::size_t kLevelCount{
+      std::size_t{std::numeric_limits<std::uint8_t>::max()} + 1u};
+
+  /// The number of buckets of levels, which fits a bit mask.
+  static constexpr std::size_t kLevelBucketCount{64};
+
+  /// The number of bits in a word of @c velocityMask_.
+  static constexpr std::size_t kVelocityMaskBitCount{
+      std::numeric_limits<std::uint64_t>::digits};
+
+  /**
+   * @brief Voice state.
+   */
+  struct Voice {
+    Note note;                     ///< Note which is assigned.
+    std::uint8_t older{kNoVoice};  ///< Older note-on voice.
+    std::uint8_t newer{kNoVoice};  ///< Newer note-on voice.
+
+    /// Older note-on voice with the same velocity.
+    std::uint8_t olderOfVelocity{kNoVoice};
+
+    /// Newer note-on voice with the same velocity.
+    std::uint8_t newerOfVelocity{kNoVoice};
+
+    /// Bucket of the level of the voice.
+    std::uint8_t levelBucket{};
+  };
 
-  /// A queue of identifier which is assignable to a note.
-  std::deque<std::size_t> assignableIdQueue_;
+  /// Voices. The index is identifier of assignment.
+  std::array<Voice, kMaxPolyphony> voices_{};
+
+  /// The oldest and newest note-on voices.
+  std::uint8_t oldestNoteOn_{kNoVoice}, newestNoteOn_{kNoVoice};
+
+  /// The oldest and newest note-on voices per velocity.
+  std::array<std::uint8_t, kVelocityCount> oldestOfVelocity_,
+      newestOfVelocity_;
+
+  /// Velocities which have note-on voices. Bit n of word w is velocity
+  /// 64w + n.
+  std::array<std::uint64_t, kVelocityCount / kVelocityMaskBitCount>
+      velocityMask_{};
+
+  /// Note-on voices per bucket of level. Bit n represents identifier n.
+  std::array<std::uint64_t, kLevelBucketCount> levelBucketVoiceMasks_{};
+
+  /// Buckets of level which have note-on voices. Bit n is bucket n.
+  std::uint64_t levelBucketMask_{};
+
+  /// Ring queue of identifiers which are assignable to a note.
+  std::array<std::uint8_t, kMaxPolyphony> assignableIds_{};
+
+  /// Position of the front and the number of elements in @c assignableIds_.
+  std::size_t assignableHead_{}, assignableCount_{};
+
+  /// Look-up table from channel and note number to the voice.
+  std::array<std::uint8_t, kMidiChannelCount * kNoteNumberCount> noteToVoice_;
+
+  /// Cache of used identifiers.
+  std::uint64_t usedAssignIdMask_{};
+
+  /// Cache of note-on identifiers.
+  std::uint64_t noteOnAssignIdMask_{};
 
   /// The maximum number of note that is able to note on at the same time.
   std::size_t polyphony_;
+
+  /// Policy to choose a stolen voice.
+  StealPolicy stealPolicy_{StealPolicy::Oldest};
+
+  /// Whether a note which is already on is re-triggered on its voice.
+  bool isSameNoteRetriggerEnabled_{};
+
+  /**
+   * @brief Get index of @c noteToVoice_.
+   * @param[in] note Note.
+   * @return Index, or @c std::nullopt if channel or note number is invalid.
+   */
+  static std::optional<std::size_t> noteIndexOf(const Note& note) noexcept;
+
+  /**
+   * @brief Choose a note-on voice to steal.
+   * @return Identifier of the voice.
+   * @pre At least one voice is note-on.
+   */
+  std::uint8_t victim() const noexcept;
+
+  /**
+   * @brief Add a note-on voice to a bucket of level.
+   * @param[in] id Identifier of the voice.
+   * @param[in] bucket Bucket of level.
+   */
+  void linkLevelBucket(std::uint8_t id, std::uint8_t bucket) noexcept;
+
+  /**
+   * @brief Remove a note-on voice from its bucket of level.
+   * @param[in] id Identifier of the voice.
+   */
+  void unlinkLevelBucket(std::uint8_t id) noexcept;
+
+  /**
+   * @brief Link a voice as the newest note-on.
+   * @param[in] id Identifier of the voice.
+   * @param[in] note Note assigned to the voice.
+   * @param[in] noteIndex Index of @c noteToVoice_ for @c note.
+   */
+  void pushNoteOn(std::uint8_t id, const Note& note,
+                  std::size_t noteIndex) noexcept;
+
+  /**
+   * @brief Unlink a note-on voice and make it assignable.
+   * @details The identifier is appended to the back of assignable ones.
+   * @param[in] id Identifier of the voice.
+   * @return Assignment which should be note-off.
+   */
+  NoteAssignment releaseNoteOn(std::uint8_t id) noexcept;
+
+  /**
+   * @brief Reset assignable identifiers to 0 to @c polyphony_ - 1.
+   */
+  void resetAssignableIds() noexcept;
 };
 }  // namespace audio
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "midi_event_batch.h"
+
+namespace audio {
+namespace {
+/**
+ * @brief Whether a controller is a part of RPN or NRPN messages.
+ * @param[in] number Controller number.
+ * @return @c true if @c juce::MidiRPNDetector uses the controller.
+ */
+constexpr bool isParameterNumberController(std::uint8_t number) noexcept {
+  switch (number) {
+    case 0x06u:  // Data entry MSB
+    case 0x26u:  // Data entry LSB
+    case 0x62u:  // NRPN LSB
+    case 0x63u:  // NRPN MSB
+    case 0x64u:  // RPN LSB
+    case 0x65u:  // RPN MSB
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Whether an event overrides the previous one.
+ * @param[in] previous Previous event.
+ * @param[in] event Event.
+ * @return @c true if only @c event has to be handled.
+ */
+constexpr bool overrides(const MidiEvent& previous,
+                         const MidiEvent& event) noexcept {
+  if (previous.samplePosition != event.samplePosition ||
+      previous.type != event.type || previous.channel != event.channel) {
+    return false;
+  }
+
+  switch (event.type) {
+    case MidiEvent::Type::PitchWheel:
+      return true;
+
+    case MidiEvent::Type::Controller:
+      return previous.number == event.number;
+
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+std::optional<MidiEvent> MidiEvent::decode(const std::uint8_t* data,
+                                           int numBytes,
+                                           int samplePosition) noexcept {
+  if (numBytes < 2 || 0xf0u <= data[0]) {
+    // System messages are not used.
+    return std::nullopt;
+  }
+
+  MidiEvent event{.samplePosition{samplePosition},
+                  .channel{static_cast<std::uint8_t>((data[0] & 0x0fu) + 1u)},
+                  .number{static_cast<std::uint8_t>(data[1] & 0x7fu)}};
+  const auto data2 =
+      static_cast<std::uint8_t>(numBytes < 3 ? 0u : data[2] & 0x7fu);
+
+  switch (data[0] & 0xf0u) {
+    case 0x80u:
+      event.type = Type::NoteOff;
+      break;
+
+    case 0x90u:
+      // Note-on with zero velocity is note-off.
+      event.type = data2 ? Type::NoteOn : Type::NoteOff;
+      event.value = data2;
+      break;
+
+    case 0xb0u:
+      if (!isParameterNumberController(event.number)) {
+        return std::nullopt;
+      }
+      event.type = Type::Controller;
+      event.value = data2;
+      break;
+
+    case 0xc0u:
+      event.type = Type::ProgramChange;
+      break;
+
+    case 0xe0u:
+      event.type = Type::PitchWheel;
+      event.value = static_cast<std::uint16_t>(event.number | (data2 << 7u));
+      event.number = 0u;
+      break;
+
+    default:
+      return std::nullopt;
+  }
+
+  return event;
+}
+
+juce::MidiBufferIterator MidiEventBatch::decode(
+    juce::MidiBufferIterator begin, juce::MidiBufferIterator end) noexcept {
+  count_ = 0;
+  collapsedCount_ = 0;
+
+  auto it = begin;
+  for (; it != end; ++it) {
+    const auto metadata = *it;
+    const auto event = MidiEvent::decode(metadata.data, metadata.numBytes,
+                                         metadata.samplePosition);
+    if (!event.has_value()) {
+      continue;
+    }
+
+    if (count_ && overrides(events_[count_ - 1u], event.value())) {
+      events_[count_ - 1u] = event.value();
+      ++collapsedCount_;
+      continue;
+    }
+
+    if (count_ == kMaxEventCount) {
+      break;
+    }
+    events_[count_++] = event.value();
+  }
+
+  return it;
+}
+}  // namespace audio
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace audio {
+/**
+ * @brief MIDI event which the audio source handles.
+ */
+struct MidiEvent {
+  /**
+   * @brief Kind of event.
+   */
+  enum class Type : std::uint8_t {
+    NoteOn,
+    NoteOff,
+    Controller,
+    PitchWheel,
+    ProgramChange,
+  };
+
+  int samplePosition{};    ///< Sample position in the block.
+  Type type{};             ///< Kind of event.
+  std::uint8_t channel{};  ///< MIDI channel from 1 to 16.
+
+  /// Note number, controller number or program number.
+  std::uint8_t number{};
+
+  /// Velocity, controller value, or pitch wheel value from 0 to 16383.
+  std::uint16_t value{};
+
+  /**
+   * @brief Decode a MIDI message.
+   * @details Messages which the audio source ignores, such as system messages
+   * and controllers unrelated to RPN and NRPN, are discarded.
+   * @param[in] data Raw bytes of message.
+   * @param[in] numBytes The number of bytes in @c data.
+   * @param[in] samplePosition Sample position in the block.
+   * @return Event, or @c std::nullopt if the message is discarded.
+   */
+  static std::optional<MidiEvent> decode(const std::uint8_t* data,
+                                         int numBytes,
+                                         int samplePosition) noexcept;
+};
+
+/**
+ * @brief Events decoded from a MIDI buffer of a block.
+ * @details Consecutive pitch wheel messages at the same sample position, and
+ * consecutive messages of the same controller, are collapsed into the last
+ * one because only their final values have any effect. Events are kept in a
+ * fixed-size array, so decoding never allocates memory.
+ */
+class MidiEventBatch {
+ public:
+  /// The maximum number of events in a batch.
+  static constexpr std::size_t kMaxEventCount{512};
+
+  /**
+   * @brief Decode messages into the batch, replacing the previous events.
+   * @param[in] begin Iterator to the first message.
+   * @param[in] end Iterator to the end of messages.
+   * @return Iterator to the first message which is not decoded because the
+   * batch is full, or @c end if all messages are decoded.
+   */
+  juce::MidiBufferIterator decode(juce::MidiBufferIterator begin,
+                                  juce::MidiBufferIterator end) noexcept;
+
+  /**
+   * @brief Get decoded events.
+   * @return Events in order of sample position.
+   */
+  std::span<const MidiEvent> events() const noexcept {
+    return std::span(events_).first(count_);
+  }
+
+  /**
+   * @brief Get the number of messages collapsed in the last decoding.
+   * @return The number of messages.
+   */
+  std::size_t collapsedCount() const noexcept { return collapsedCount_; }
+
+ private:
+  /// Events.
+  std::array<MidiEvent, kMaxEventCount> events_;
+
+  /// The number of events.
+  std::size_t count_{};
+
+  /// The number of messages collapsed in the last decoding.
+  std::size_t collapsedCount_{};
+};
+}  // namespace audio
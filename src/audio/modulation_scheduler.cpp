@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "modulation_scheduler.h"
+
+#include <cmath>
+
+namespace audio {
+void ModulationScheduler::jumpTo(std::size_t control,
+                                 std::uint8_t value) noexcept {
+  auto& c = controls_[control];
+  c.value = value;
+  c.step = 0.f;
+  c.remaining = 0u;
+  c.target = value;
+  c.reported = value;
+  rampingMask_ &= ~(std::uint32_t{1} << control);
+}
+
+bool ModulationScheduler::rampTo(std::size_t control,
+                                 std::uint8_t target) noexcept {
+  auto& c = controls_[control];
+  if (c.target == target && c.reported == target) {
+    return false;
+  }
+
+  // Start from the current position even if the previous ramp is moving.
+  c.target = target;
+  c.remaining = kRampTickCount;
+  c.step = (static_cast<float>(target) - c.value) / kRampTickCount;
+  rampingMask_ |= std::uint32_t{1} << control;
+  return true;
+}
+
+std::uint32_t ModulationScheduler::stopAll() noexcept {
+  const std::uint32_t mask = rampingMask_;
+  for (std::size_t i = 0; i < kMaxControlCount; ++i) {
+    if ((mask >> i) & 1u) {
+      jumpTo(i, controls_[i].target);
+    }
+  }
+  return mask;
+}
+
+int ModulationScheduler::tick(std::size_t control) noexcept {
+  auto& c = controls_[control];
+  if (c.remaining) {
+    c.value = --c.remaining ? c.value + c.step : c.target;
+  }
+
+  const auto value = static_cast<std::uint8_t>(std::lround(c.value));
+  return value != c.reported ? value : -1;
+}
+
+void ModulationScheduler::finishIfReached(std::size_t control) noexcept {
+  const auto& c = controls_[control];
+  if (!c.remaining && c.reported == c.target) {
+    rampingMask_ &= ~(std::uint32_t{1} << control);
+  }
+}
+}  // namespace audio
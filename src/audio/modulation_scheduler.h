@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace audio {
+/**
+ * @brief Scheduler which moves parameter values to their targets at a fixed
+ * control rate.
+ * @details Controls are updated at ticks, which are sample indices of
+ * multiples of @c kControlInterval. A value moves linearly to a new target in
+ * @c kRampTickCount ticks, and a tick reports only values whose integer part
+ * changed. Reports are limited by a budget refilled by the caller, and values
+ * which miss the budget are reported at later ticks.
+ * @note It is not thread-safe.
+ */
+class ModulationScheduler {
+ public:
+  /// The maximum number of controls.
+  static constexpr std::size_t kMaxControlCount{8};
+
+  /// Interval of ticks in samples.
+  static constexpr std::uint64_t kControlInterval{32};
+
+  /// The number of ticks to reach a target.
+  static constexpr std::uint32_t kRampTickCount{8};
+
+  /// The number of reports allowed between refills of the budget.
+  static constexpr std::size_t kReportBudget{64};
+
+  /**
+   * @brief Set the value of a control immediately and stop its ramp.
+   * @param[in] control Control index.
+   * @param[in] value Value.
+   */
+  void jumpTo(std::size_t control, std::uint8_t value) noexcept;
+
+  /**
+   * @brief Start to move a control to a target from the next tick.
+   * @param[in] control Control index.
+   * @param[in] target Target value.
+   * @return @c true if the control moves, or @c false if it already has the
+   * value.
+   */
+  bool rampTo(std::size_t control, std::uint8_t target) noexcept;
+
+  /**
+   * @brief Stop all ramps.
+   * @return Bit mask of controls which were moving. Bit n is control n.
+   */
+  std::uint32_t stopAll() noexcept;
+
+  /**
+   * @brief Whether some controls are moving.
+   * @return @c true if a ramp is in progress.
+   */
+  bool isRamping() const noexcept { return rampingMask_; }
+
+  /**
+   * @brief Refill the report budget.
+   */
+  void refillBudget() noexcept { budget_ = kReportBudget; }
+
+  /**
+   * @brief Process ticks until the given time.
+   * @param[in] sampleIndex The last sample index to process.
+   * @param[in] function Function called with a timestamp, a control index and
+   * a value of each report, in the order of timestamps.
+   */
+  template <class F>
+  void advanceUntil(std::uint64_t sampleIndex, F&& function) {
+    for (; nextTick_ <= sampleIndex; nextTick_ += kControlInterval) {
+      if (!rampingMask_) {
+        // Skip to the tick after the time.
+        nextTick_ = (sampleIndex / kControlInterval + 1u) * kControlInterval;
+        return;
+      }
+
+      for (std::size_t i = 0; i < kMaxControlCount; ++i) {
+        if ((rampingMask_ >> i) & 1u) {
+          if (const auto value = tick(i); value >= 0 && budget_) {
+            --budget_;
+            controls_[i].reported = static_cast<std::uint8_t>(value);
+            function(nextTick_, i, controls_[i].reported);
+          }
+          finishIfReached(i);
+        }
+      }
+    }
+  }
+
+ private:
+  /**
+   * @brief State of a control.
+   */
+  struct Control {
+    float value{};              ///< Current value.
+    float step{};               ///< Difference per tick.
+    std::uint32_t remaining{};  ///< Ticks until the target.
+    std::uint8_t target{};      ///< Target value.
+    std::uint8_t reported{};    ///< Value which was reported last.
+  };
+
+  /// Controls.
+  std::array<Control, kMaxControlCount> controls_{};
+
+  /// Controls which are moving or not reported their targets.
+  std::uint32_t rampingMask_{};
+
+  /// Sample index of the next tick.
+  std::uint64_t nextTick_{};
+
+  /// The number of reports allowed until the next refill.
+  std::size_t budget_{kReportBudget};
+
+  /**
+   * @brief Move a control by a tick.
+   * @param[in] control Control index.
+   * @return Value to report, or -1 if its integer part has not changed.
+   */
+  int tick(std::size_t control) noexcept;
+
+  /**
+   * @brief Stop a ramp if the target is reported.
+   * @param[in] control Control index.
+   */
+  void finishIfReached(std::size_t control) noexcept;
+};
+}  // namespace audio
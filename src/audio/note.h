@@ -12,9 +12,14 @@ namespace audio {
  * @brief Note object.
  */
 struct Note {
-  int channel;            ///< Channel.
-  int noteNumber;         ///< Note number.
-  std::uint8_t velocity;  ///< Velocity.
+  int channel{};            ///< Channel.
+  int noteNumber{};         ///< Note number.
+  std::uint8_t velocity{};  ///< Velocity.
+
+  /**
+   * @brief Construct note-off of channel 0 and note number 0.
+   */
+  Note() noexcept = default;
 
   /**
    * @brief Constructor.
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "output_meter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace audio {
+namespace {
+/// Full scale of emulator output.
+constexpr float kFullScale{std::numeric_limits<std::int16_t>::max()};
+}  // namespace
+
+bool OutputMeter::add(const sample_conversion::StereoLevel& level,
+                      std::size_t numSamples) noexcept {
+  for (std::size_t ch = 0; ch < 2; ++ch) {
+    level_.peak[ch] = std::max(level_.peak[ch], level.peak[ch]);
+    level_.sumOfSquares[ch] += level.sumOfSquares[ch];
+  }
+  sampleCount_ += numSamples;
+
+  return kWindowSampleCount <= sampleCount_;
+}
+
+void OutputMeter::publish() noexcept {
+  auto& frame = frames_.back();
+  for (std::size_t ch = 0; ch < 2; ++ch) {
+    frame.peak[ch] = level_.peak[ch] / kFullScale;
+    frame.rms[ch] =
+        sampleCount_ ? std::sqrt(level_.sumOfSquares[ch] /
+                                 static_cast<float>(sampleCount_)) /
+                           kFullScale
+                     : 0.f;
+  }
+  frames_.publish();
+
+  level_ = {};
+  sampleCount_ = 0;
+}
+}  // namespace audio
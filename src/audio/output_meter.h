@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "keyboard.h"
+#include "sample_conversion.h"
+#include "triple_buffer.h"
+
+namespace audio {
+/**
+ * @brief Levels of output and activity of voices over a window.
+ */
+struct MeterFrame {
+  std::array<float, 2> peak{};  ///< Peak of left and right. 1 is full scale.
+  std::array<float, 2> rms{};   ///< RMS of left and right. 1 is full scale.
+
+  /// Voices which are keyed on. Bit n is voice n, which is assign ID n.
+  std::uint64_t keyOnVoiceMask{};
+
+  /// Envelope levels of voices. 0 is silent and 255 is the loudest.
+  std::array<std::uint8_t, Keyboard::kMaxPolyphony> voiceLevels{};
+
+  /// The number of voices.
+  std::size_t voiceCount{};
+};
+
+/**
+ * @brief Meter which accumulates levels on the audio thread and publishes a
+ * frame per window to a reader thread.
+ * @details Frames are passed through a triple buffer, so neither thread locks
+ * or allocates.
+ */
+class OutputMeter {
+ public:
+  /// The number of samples in synthesis rate of a window.
+  static constexpr std::size_t kWindowSampleCount{2048};
+
+  /**
+   * @brief Add levels of converted samples.
+   * @param[in] level Levels in the scale of emulator output.
+   * @param[in] numSamples The number of samples measured in @c level.
+   * @return @c true if a window is complete. Then the caller fills voices of
+   * @c pendingFrame() and calls @c publish().
+   * @note It must be called from the audio thread.
+   */
+  bool add(const sample_conversion::StereoLevel& level,
+           std::size_t numSamples) noexcept;
+
+  /**
+   * @brief Get the frame which will be published next.
+   * @return Frame.
+   * @note It must be called from the audio thread.
+   */
+  MeterFrame& pendingFrame() noexcept { return frames_.back(); }
+
+  /**
+   * @brief Publish levels of the window and the pending frame, and start a new
+   * window.
+   * @note It must be called from the audio thread.
+   */
+  void publish() noexcept;
+
+  /**
+   * @brief Get the latest frame.
+   * @return Frame. It is valid until the next call.
+   * @note It must be called from only one reader thread.
+   */
+  const MeterFrame& read() noexcept { return frames_.read(); }
+
+ private:
+  /// Levels accumulated in the current window.
+  sample_conversion::StereoLevel level_;
+
+  /// The number of samples accumulated in the current window.
+  std::size_t sampleCount_{};
+
+  /// Published frames.
+  TripleBuffer<MeterFrame> frames_;
+};
+}  // namespace audio
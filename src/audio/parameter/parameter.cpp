@@ -13,6 +13,15 @@ const std::unordered_map<PluginParameter,
     kPluginIdNameLookUp_{
         {PluginParameter::PitchBendSensitivity,
          {"pitchBendSensitivity", "Pitch Bend Sensitivity"}},
+        {PluginParameter::Quality, {"quality", "Quality"}},
+        {PluginParameter::DcBlockerEnabled,
+         {"dcBlockerEnabled", "DC Blocker Enabled"}},
+        {PluginParameter::OutputGain, {"outputGain", "Output Gain"}},
+        {PluginParameter::SoftClipEnabled,
+         {"softClipEnabled", "Soft Clip Enabled"}},
+        {PluginParameter::ChipCount, {"chipCount", "Chip Count"}},
+        {PluginParameter::ParallelRenderingEnabled,
+         {"parallelRenderingEnabled", "Parallel Rendering Enabled"}},
     };
 }
 
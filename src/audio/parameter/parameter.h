@@ -46,6 +46,21 @@ struct SlotAndValue {
 
 // Parameter value types.
 struct PitchBendSensitivityValue : public RangedValue<int, 1, 24> {};
+struct QualityValue : public RangedValue<std::uint8_t, 0, 2> {};
+struct DcBlockerEnabledValue : public ToggledValue {};
+
+/// Raw value is in decibels.
+struct OutputGainValue : public RangedValue<std::int8_t, -24, 12> {};
+
+struct SoftClipEnabledValue : public ToggledValue {};
+
+/// Raw value is the number of emulator instances, each of which has 6 voices.
+struct ChipCountValue : public RangedValue<std::uint8_t, 1, 8> {
+  /// Default value, which gives 12 voices polyphony.
+  static constexpr std::uint8_t kDefault{2};
+};
+
+struct ParallelRenderingEnabledValue : public ToggledValue {};
 
 struct OperatorEnabledValue : public ToggledValue {};
 struct AlgorithmValue : public RangedValue<std::uint8_t, 0, 7> {};
@@ -59,7 +74,13 @@ struct TotalLevelValue : public RangedValue<std::uint8_t, 0, 127> {};
 struct KeyScaleValue : public RangedValue<std::uint8_t, 0, 3> {};
 struct MultipleValue : public RangedValue<std::uint8_t, 0, 15> {};
 struct DetuneValue : public RangedValue<std::int8_t, -3, 3> {};
+struct AmValue : public ToggledValue {};
+struct SsgegEnabledValue : public ToggledValue {};
+
+/// Raw value is @c SsgegShape.
+struct SsgegShapeValue : public RangedValue<std::uint8_t, 8, 15> {};
 
+struct LfoEnabledValue : public ToggledValue {};
 struct LfoFrequency : public RangedValue<std::uint8_t, 0, 7> {};
 struct LfoPmsValue : public RangedValue<std::uint8_t, 0, 7> {};
 struct LfoAmsValue : public RangedValue<std::uint8_t, 0, 3> {};
@@ -88,14 +109,20 @@ using ParameterVariant =
                  SlotAndValue<SustainRateValue>, SlotAndValue<ReleaseRateValue>,
                  SlotAndValue<SustainLevelValue>, SlotAndValue<TotalLevelValue>,
                  SlotAndValue<KeyScaleValue>, SlotAndValue<MultipleValue>,
-                 SlotAndValue<DetuneValue>/* ,
+                 SlotAndValue<DetuneValue>, SlotAndValue<AmValue>,
+                 SlotAndValue<SsgegEnabledValue>, SlotAndValue<SsgegShapeValue>,
 
-                 SlotAndValue<LfoFrequency>, SlotAndValue<LfoPmsValue>,
-                 SlotAndValue<LfoAmsValue> */>;
+                 LfoEnabledValue, LfoFrequency, LfoPmsValue, LfoAmsValue>;
 
 /// Parameters related to plugin behavior.
 enum class PluginParameter {
   PitchBendSensitivity,
+  Quality,
+  DcBlockerEnabled,
+  OutputGain,
+  SoftClipEnabled,
+  ChipCount,
+  ParallelRenderingEnabled,
 };
 
 /**
@@ -239,13 +266,14 @@ struct FmParameters {
 
     /// Data of SSG-EG
     struct Ssgeg {
-      parameter::SsgegShape shape{parameter::SsgegShape::DownwardSaw};
-      bool isEnabled{};
+      parameter::SsgegShapeValue shape{
+          static_cast<std::uint8_t>(parameter::SsgegShape::DownwardSaw)};
+      parameter::SsgegEnabledValue isEnabled{};
     };
 
     Ssgeg ssgeg{};
 
-    bool am{};
+    parameter::AmValue am{};
   };
 
   Operator slot[kSlotCount]{};
@@ -255,7 +283,7 @@ struct FmParameters {
     parameter::LfoFrequency frequency{};
     parameter::LfoPmsValue pms{};
     parameter::LfoAmsValue ams{};
-    bool isEnabled{};
+    parameter::LfoEnabledValue isEnabled{};
   };
 
   Lfo lfo{};
@@ -3,38 +3,118 @@
 
 #include "parameter_change_queue.h"
 
+#include <bit>
 #include <stdexcept>
 
 namespace audio {
 namespace parameter {
-void ParameterChangeQueue::enqueue(
-    const audio::parameter::ParameterVariant& parameter) {
-  const std::size_t typeIndex = parameter.index();
+namespace {
+constexpr std::size_t kTypeCount{std::variant_size_v<ParameterVariant>};
+
+/**
+ * @brief Look-up table of the first key of each type.
+ * The index is index of type in @c ParameterVariant.
+ */
+constexpr auto kKeyOffsets =
+    []<std::size_t... Is>(std::index_sequence<Is...>) {
+      std::array<std::size_t, kTypeCount> offsets{};
+      std::size_t offset{};
+      ((offsets[Is] = offset,
+        offset += parameterKeyCountOf<
+            std::variant_alternative_t<Is, ParameterVariant>>()),
+       ...);
+      return offsets;
+    }(std::make_index_sequence<kTypeCount>{});
 
-  if (const auto itr = map_.find(typeIndex); itr != std::end(map_)) {
-    queue_.erase(itr->second);
+/**
+ * @brief Get raw value of a parameter to store in the queue.
+ * @param[in] parameter Parameter.
+ * @return Raw value.
+ */
+template <class T>
+std::int32_t rawValueOf(const T& parameter) noexcept {
+  if constexpr (requires { parameter.slot; }) {
+    return static_cast<std::int32_t>(parameter.value.rawValue());
+  } else {
+    return static_cast<std::int32_t>(parameter.rawValue());
   }
+}
 
-  queue_.emplace_front(parameter);
-  map_.insert_or_assign(typeIndex, std::begin(queue_));
+/**
+ * @brief Restore a parameter from raw value stored in the queue.
+ * @param[in] slot Slot number. It is ignored if @c T has no slot.
+ * @param[in] rawValue Raw value.
+ * @return Parameter.
+ */
+template <class T>
+ParameterVariant makeParameter(std::size_t slot, std::int32_t rawValue) {
+  if constexpr (requires(T t) { t.slot; }) {
+    using ValueType = decltype(std::declval<T>().value);
+    return T{slot, parameterCast<ValueType>(rawValue)};
+  } else {
+    return parameterCast<T>(rawValue);
+  }
+}
+
+/**
+ * @brief Information to restore a parameter from its key.
+ */
+struct KeyInfo {
+  ParameterVariant (*factory)(std::size_t, std::int32_t);  ///< Restorer.
+  std::size_t slot;  ///< Slot number.
+};
+
+/// Look-up table of key information. The index is key of parameter.
+constexpr auto kKeyInfos =
+    []<std::size_t... Is>(std::index_sequence<Is...>) {
+      std::array<KeyInfo, kParameterKeyCount> infos{};
+      std::size_t key{};
+      const auto append = [&]<class T>(std::type_identity<T>) {
+        for (std::size_t slot = 0; slot < parameterKeyCountOf<T>(); ++slot) {
+          infos[key++] = KeyInfo{.factory{&makeParameter<T>}, .slot{slot}};
+        }
+      };
+      (append(std::type_identity<
+               std::variant_alternative_t<Is, ParameterVariant>>{}),
+       ...);
+      return infos;
+    }(std::make_index_sequence<kTypeCount>{});
+}  // namespace
+
+void ParameterChangeQueue::enqueue(
+    const audio::parameter::ParameterVariant& parameter) noexcept {
+  const auto [key, rawValue] = std::visit(
+      [offset = kKeyOffsets[parameter.index()]](const auto& param) {
+        std::size_t key = offset;
+        if constexpr (requires { param.slot; }) {
+          key += param.slot.rawValue();
+        }
+        return std::make_pair(key, rawValueOf(param));
+      },
+      parameter);
+
+  values_[key].store(rawValue, std::memory_order_relaxed);
+  dirtyMask_.fetch_or(MaskType{1u} << key, std::memory_order_release);
 }
 
 audio::parameter::ParameterVariant ParameterChangeQueue::dequeue() {
-  if (queue_.empty()) {
+  const MaskType mask = dirtyMask_.load(std::memory_order_acquire);
+  if (!mask) {
     throw std::range_error("Called dequeue, but the queue is empty.");
   }
 
-  auto back = std::move(queue_.back());
-
-  map_.erase(back.index());
-  queue_.pop_back();
+  const auto key = static_cast<std::size_t>(std::countr_zero(mask));
+  dirtyMask_.fetch_and(~(MaskType{1u} << key), std::memory_order_acquire);
 
-  return back;
+  // If a producer overwrites the value after clearing the bit, the newer value
+  // will be read here and the same value will be dequeued again later. It is
+  // harmless because the latest value wins anyway.
+  const auto& info = kKeyInfos[key];
+  return info.factory(info.slot, values_[key].load(std::memory_order_relaxed));
 }
 
-void ParameterChangeQueue::clear() {
-  map_.clear();
-  queue_.clear();
+void ParameterChangeQueue::clear() noexcept {
+  dirtyMask_.store(0u, std::memory_order_release);
 }
 }  // namespace parameter
 }  // namespace audio
@@ -5,16 +5,49 @@
 
 #include <JuceHeader.h>
 
-#include <list>
-#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <variant>
 
 #include "parameter.h"
 
 namespace audio {
 namespace parameter {
-// TODO: Lock-free
 /**
- * @brief FIFO queue of parameters whose element type is unique.
+ * @brief Get the number of key which identifies a parameter in the queue.
+ *
+ * @tparam T Parameter type in @c ParameterVariant.
+ * @return @c kSlotCount if @c T has a slot number, otherwise 1.
+ */
+template <class T>
+constexpr std::size_t parameterKeyCountOf() noexcept {
+  if constexpr (requires(T t) { t.slot; }) {
+    return kSlotCount;
+  } else {
+    return 1u;
+  }
+}
+
+/// The number of key which identifies a parameter in @c ParameterVariant.
+inline constexpr std::size_t kParameterKeyCount{
+    []<std::size_t... Is>(std::index_sequence<Is...>) {
+      return (parameterKeyCountOf<
+                  std::variant_alternative_t<Is, ParameterVariant>>() +
+              ...);
+    }(std::make_index_sequence<std::variant_size_v<ParameterVariant>>{})};
+
+/**
+ * @brief Queue of parameters whose element type is unique.
+ *
+ * @details Each parameter, identified by its type in @c ParameterVariant and
+ * its slot number for operator parameters, owns a fixed atomic slot. Enqueue
+ * stores the latest value into the slot and raises its dirty bit, and dequeue
+ * clears the bit and loads the value. Both operations are wait-free and never
+ * allocate, so a listener thread can enqueue while the audio thread dequeues.
+ * Only the latest value of each parameter is kept.
  */
 class ParameterChangeQueue {
  public:
@@ -23,38 +56,43 @@ class ParameterChangeQueue {
    *
    * @param[in] parameter Parameter.
    */
-  void enqueue(const ParameterVariant& parameter);
+  void enqueue(const ParameterVariant& parameter) noexcept;
 
   /**
    * @brief Dequeue parameter.
    *
    * @return Parameter.
    * @exception @c std::range_error if the queue is empty.
+   * @note It must be called from only one thread.
    */
   ParameterVariant dequeue();
 
   /**
    * @brief Clear the queue.
    */
-  void clear();
+  void clear() noexcept;
 
   /**
    * @brief Whether the queue has no element.
    *
    * @return @c true if the queue has no element, otherwise @c false.
    */
-  bool empty() const noexcept { return queue_.empty(); }
+  bool empty() const noexcept {
+    return dirtyMask_.load(std::memory_order_acquire) == 0u;
+  }
 
  private:
-  /// Front-In, Back-Out queue.
-  std::list<ParameterVariant> queue_;
+  using MaskType = std::uint64_t;
+  static_assert(kParameterKeyCount <= sizeof(MaskType) * 8u,
+                "Dirty mask cannot hold all parameters.");
+  static_assert(std::atomic<MaskType>::is_always_lock_free);
+  static_assert(std::atomic<std::int32_t>::is_always_lock_free);
 
-  /**
-   * @brief Unique element map of queue.
-   *        Key is index of type in parameter value variant.
-   *        Value is iterator of parameter value in @c queue_.
-   */
-  std::unordered_map<std::size_t, decltype(queue_)::iterator> map_;
+  /// Raw values of parameters. The index is key of parameter.
+  std::array<std::atomic<std::int32_t>, kParameterKeyCount> values_{};
+
+  /// Bit set of keys whose value is changed and not dequeued yet.
+  std::atomic<MaskType> dirtyMask_{};
 };
 }  // namespace parameter
 }  // namespace audio
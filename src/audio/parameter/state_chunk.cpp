@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "state_chunk.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+namespace audio {
+namespace parameter {
+namespace {
+/// Magic number at the top of a chunk.
+constexpr std::array<std::uint8_t, 4> kMagic{'O', 'P', 'N', 'S'};
+
+/// Current version of the format.
+constexpr std::uint8_t kVersion{3u};
+
+/// The oldest version which can be decoded.
+constexpr std::uint8_t kMinimumVersion{1u};
+
+/// Size of the header.
+constexpr std::size_t kHeaderSize{kMagic.size() + 1u};
+
+/**
+ * @brief Get the number of bits to store a ranged value.
+ * @tparam T Type of value.
+ * @tparam Minimum Minimum value.
+ * @tparam Maximum Maximum value.
+ * @return Bit width.
+ */
+template <Numeric T, T Minimum, T Maximum>
+constexpr int bitWidthOf(const RangedValue<T, Minimum, Maximum>&) noexcept {
+  return std::bit_width(static_cast<std::uint32_t>(Maximum - Minimum));
+}
+
+/**
+ * @brief Writer of packed bits.
+ */
+class BitWriter {
+ public:
+  /**
+   * @brief Constructor.
+   * @param[out] destData Destination. Bits are appended to it.
+   */
+  explicit BitWriter(juce::MemoryBlock& destData) : destData_(destData) {}
+
+  ~BitWriter() { flush(); }
+
+  /**
+   * @brief Write bits.
+   * @param[in] bits Bits written from LSB.
+   * @param[in] width The number of bits.
+   */
+  void write(std::uint32_t bits, int width) {
+    for (int i = 0; i < width; ++i) {
+      current_ |= static_cast<std::uint8_t>(((bits >> i) & 1u) << bitCount_);
+      if (++bitCount_ == 8) {
+        flush();
+      }
+    }
+  }
+
+  template <Numeric T, T Minimum, T Maximum>
+  void write(const RangedValue<T, Minimum, Maximum>& value) {
+    write(static_cast<std::uint32_t>(value.rawValue() - Minimum),
+          bitWidthOf(value));
+  }
+
+  void write(const ToggledValue& value) { write(value.rawValue()); }
+
+  void write(bool value) { write(value ? 1u : 0u, 1); }
+
+ private:
+  juce::MemoryBlock& destData_;
+  std::uint8_t current_{};
+  int bitCount_{};
+
+  /**
+   * @brief Append the current byte if it has bits.
+   */
+  void flush() {
+    if (bitCount_) {
+      destData_.append(&current_, 1u);
+      current_ = 0u;
+      bitCount_ = 0;
+    }
+  }
+};
+
+/**
+ * @brief Reader of packed bits.
+ */
+class BitReader {
+ public:
+  /**
+   * @brief Constructor.
+   * @param[in] data Packed data.
+   * @param[in] sizeInBytes Size of @c data.
+   */
+  BitReader(const std::uint8_t* data, std::size_t sizeInBytes)
+      : data_(data), bitSize_(sizeInBytes * 8u) {}
+
+  /**
+   * @brief Read bits.
+   * @param[in] width The number of bits.
+   * @return Bits from LSB, or @c std::nullopt if data is too short.
+   */
+  std::optional<std::uint32_t> read(int width) {
+    if (bitSize_ - position_ < static_cast<std::size_t>(width)) {
+      return std::nullopt;
+    }
+
+    std::uint32_t bits{};
+    for (int i = 0; i < width; ++i, ++position_) {
+      bits |= static_cast<std::uint32_t>(
+                  (data_[position_ / 8u] >> (position_ % 8u)) & 1u)
+              << i;
+    }
+    return bits;
+  }
+
+  /**
+   * @brief Read a ranged value.
+   * @param[out] value Destination.
+   * @return @c false if data is too short or out of range.
+   */
+  template <Numeric T, T Minimum, T Maximum>
+  bool read(RangedValue<T, Minimum, Maximum>& value) {
+    const auto bits = read(bitWidthOf(value));
+    return bits && value.trySetValue(static_cast<T>(Minimum + *bits));
+  }
+
+  bool read(ToggledValue& value) {
+    bool rawValue{};
+    if (!read(rawValue)) {
+      return false;
+    }
+    value = ToggledValue(rawValue);
+    return true;
+  }
+
+  bool read(bool& value) {
+    const auto bits = read(1);
+    if (!bits) {
+      return false;
+    }
+    value = *bits;
+    return true;
+  }
+
+ private:
+  const std::uint8_t* data_;
+  std::size_t bitSize_;
+  std::size_t position_{};
+};
+
+/**
+ * @brief Visit all fields of values in the order of the format.
+ * @param[in] chunk Values.
+ * @param[in] version Version of the format, which determines the fields.
+ * @param[in] function Function called with each field. It returns @c false to
+ * stop visiting.
+ * @return @c false if visiting is stopped.
+ */
+template <class Chunk, class F>
+  requires std::is_same_v<std::remove_const_t<Chunk>, StateChunk>
+bool visitFields(Chunk& chunk, std::uint8_t version, F&& function) {
+  auto& fm = chunk.fmParameters;
+  if (!(function(chunk.pitchBendSensitivity) && function(chunk.quality) &&
+        function(fm.al) && function(fm.fb))) {
+    return false;
+  }
+
+  for (auto& slot : fm.slot) {
+    if (!(function(slot.isEnabled) && function(slot.ar) && function(slot.dr) &&
+          function(slot.sr) && function(slot.rr) && function(slot.sl) &&
+          function(slot.tl) && function(slot.ks) && function(slot.ml) &&
+          function(slot.dt) && function(slot.ssgeg.isEnabled) &&
+          function(slot.ssgeg.shape) && function(slot.am))) {
+      return false;
+    }
+  }
+
+  if (!(function(fm.lfo.frequency) && function(fm.lfo.pms) &&
+        function(fm.lfo.ams) && function(fm.lfo.isEnabled))) {
+    return false;
+  }
+
+  // Version 2: output stage
+  if (2u <= version &&
+      !(function(chunk.isDcBlockerEnabled) && function(chunk.outputGain) &&
+        function(chunk.isSoftClipEnabled))) {
+    return false;
+  }
+
+  // Version 3: chips
+  return version < 3u || (function(chunk.chipCount) &&
+                          function(chunk.isParallelRenderingEnabled));
+}
+}  // namespace
+
+void encode(const StateChunk& chunk, juce::MemoryBlock& destData) {
+  destData.reset();
+  destData.append(kMagic.data(), kMagic.size());
+  destData.append(&kVersion, 1u);
+
+  BitWriter writer(destData);
+  visitFields(chunk, kVersion, [&writer](const auto& field) {
+    writer.write(field);
+    return true;
+  });
+}
+
+std::optional<StateChunk> decode(const void* data, std::size_t sizeInBytes) {
+  const auto* bytes = static_cast<const std::uint8_t*>(data);
+  if (!bytes || sizeInBytes < kHeaderSize ||
+      !std::equal(kMagic.begin(), kMagic.end(), bytes) ||
+      bytes[kMagic.size()] < kMinimumVersion ||
+      kVersion < bytes[kMagic.size()]) {
+    return std::nullopt;
+  }
+
+  StateChunk chunk;
+  BitReader reader(bytes + kHeaderSize, sizeInBytes - kHeaderSize);
+  if (!visitFields(chunk, bytes[kMagic.size()],
+                   [&reader](auto& field) { return reader.read(field); })) {
+    return std::nullopt;
+  }
+
+  return chunk;
+}
+}  // namespace parameter
+}  // namespace audio
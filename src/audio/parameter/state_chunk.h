@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cstddef>
+#include <optional>
+
+#include "parameter.h"
+
+namespace audio {
+namespace parameter {
+/**
+ * @brief Values stored in the binary state chunk.
+ */
+struct StateChunk {
+  PitchBendSensitivityValue pitchBendSensitivity{};
+  QualityValue quality{};
+  FmParameters fmParameters{};
+  DcBlockerEnabledValue isDcBlockerEnabled{};
+  OutputGainValue outputGain{0};
+  SoftClipEnabledValue isSoftClipEnabled{};
+  ChipCountValue chipCount{ChipCountValue::kDefault};
+  ParallelRenderingEnabledValue isParallelRenderingEnabled{};
+};
+
+/**
+ * @brief Encode values into a binary state chunk.
+ * @details The chunk starts with a magic number and a version, followed by
+ * fields packed at the bit widths of their ranges. Fields added by a version
+ * follow the fields of the previous version.
+ * @param[in] chunk Values.
+ * @param[out] destData Destination. Its content is replaced.
+ */
+void encode(const StateChunk& chunk, juce::MemoryBlock& destData);
+
+/**
+ * @brief Decode a binary state chunk.
+ * @param[in] data Encoded data.
+ * @param[in] sizeInBytes Size of @c data.
+ * @return Decoded values, or @c std::nullopt if @c data is not a valid chunk.
+ * Fields which a chunk of an older version lacks have default values.
+ */
+std::optional<StateChunk> decode(const void* data, std::size_t sizeInBytes);
+}  // namespace parameter
+}  // namespace audio
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "patch_bank.h"
+
+#include "./parameter/state_chunk.h"
+
+namespace audio {
+PatchBank::PatchBank() {
+  for (std::size_t i = 0; i < kPatchCount; ++i) {
+    patches_[i].name =
+        "Init " + juce::String(static_cast<int>(i + 1u)).paddedLeft('0', 3);
+  }
+}
+
+std::size_t PatchBank::loadDirectory(const juce::File& directory) {
+  auto files = directory.findChildFiles(
+      juce::File::findFiles, false, juce::String("*") + kPatchFileExtension);
+  files.sort();
+
+  std::size_t count{};
+  for (const auto& file : files) {
+    if (count == kPatchCount) {
+      break;
+    }
+
+    juce::MemoryBlock data;
+    if (!file.loadFileAsData(data)) {
+      continue;
+    }
+
+    const auto chunk = parameter::decode(data.getData(), data.getSize());
+    if (!chunk) {
+      continue;
+    }
+
+    auto& patch = patches_[count++];
+    patch.name = file.getFileNameWithoutExtension();
+    patch.parameters = chunk->fmParameters;
+    patch.image = ToneRegisterImage(patch.parameters);
+  }
+
+  return count;
+}
+
+juce::File PatchBank::defaultDirectory() {
+  return juce::File::getSpecialLocation(
+             juce::File::userApplicationDataDirectory)
+      .getChildFile("OPN")
+      .getChildFile("Patches");
+}
+}  // namespace audio
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <cstddef>
+
+#include "./parameter/parameter.h"
+#include "tone_register_image.h"
+
+namespace audio {
+/**
+ * @brief Bank of patches switched by program change.
+ * @details Patches are stored in a contiguous array with their register
+ * images, so switching a program on the audio thread only refers to a patch.
+ * Slots which no file is loaded into have the default patch.
+ */
+class PatchBank {
+ public:
+  /// The number of patches, which is the range of MIDI program change.
+  static constexpr std::size_t kPatchCount{128};
+
+  /// Extension of patch files.
+  static constexpr const char* kPatchFileExtension{".opnpatch"};
+
+  /**
+   * @brief Patch and its precomputed register image.
+   */
+  struct Patch {
+    juce::String name;         ///< Name of the patch.
+    FmParameters parameters;   ///< Tone parameters.
+    ToneRegisterImage image;   ///< Register image of @c parameters.
+  };
+
+  /**
+   * @brief Constructor which fills all slots with the default patch.
+   */
+  PatchBank();
+
+  /**
+   * @brief Load patch files in a directory in the order of their names.
+   * @details Each file has a binary state chunk, and the tone parameters in
+   * it are used. Files which cannot be decoded are skipped, and the ones over
+   * @c kPatchCount are ignored.
+   * @param[in] directory Directory of patch files.
+   * @return The number of loaded patches.
+   * @note It reads files, so call it outside of the audio thread.
+   */
+  std::size_t loadDirectory(const juce::File& directory);
+
+  /**
+   * @brief Get a patch.
+   * @param[in] index Index of the patch. It must be less than @c kPatchCount.
+   * @return Patch.
+   */
+  const Patch& patch(std::size_t index) const noexcept {
+    return patches_[index];
+  }
+
+  /**
+   * @brief Get the default directory of patch files.
+   * @return Directory in the user application data directory.
+   */
+  static juce::File defaultDirectory();
+
+ private:
+  std::array<Patch, kPatchCount> patches_;
+};
+}  // namespace audio
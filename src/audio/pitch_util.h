@@ -37,6 +37,28 @@ inline int calculateCent(int noteNumber, int pitchBend,
              ((pitchBend < 0) ? -kMinPitchBend : kMaxPitchBend);
 }
 
+/// Resolution of fine cent, which is a fraction of cent.
+constexpr inline int kFineCentResolution{64};
+
+/**
+ * @brief Calculate MIDI note cent in fine cent to keep resolution of pitch
+ * bend.
+ * @param[in] noteNumber MIDI note number.
+ * @param[in] pitchBend Pitch bend value.
+ * @param[in] pitchBendSensitivity Pitch bend sensitivity.
+ * @return Fine cent from MIDI note number 0. Divide by
+ * @c kFineCentResolution to get cent.
+ */
+inline int calculateFineCent(int noteNumber, int pitchBend,
+                             int pitchBendSensitivity) {
+  const std::int64_t bend =
+      std::int64_t{kSemitoneCent * kFineCentResolution} *
+      pitchBendSensitivity * pitchBend /
+      ((pitchBend < 0) ? -kMinPitchBend : kMaxPitchBend);
+  return noteNumber * kSemitoneCent * kFineCentResolution +
+         static_cast<int>(bend);
+}
+
 /**
  * @brief Calculate frequency from cent.
  * @param[in] cent Cent from MIDI note number 0.
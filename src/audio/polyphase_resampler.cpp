@@ -0,0 +1,400 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "polyphase_resampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <numbers>
+#include <stdexcept>
+
+#include "fm_audio_source.h"
+#include "sample_conversion.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPN_POLYPHASE_RESAMPLER_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define OPN_POLYPHASE_RESAMPLER_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace audio {
+namespace {
+/// Ratio of the cutoff frequency to Nyquist frequency of the lower rate.
+constexpr double kPassbandRatio{0.9};
+
+/**
+ * @brief Get the index of a number of taps per phase.
+ * @param[in] tapCount The number of taps.
+ * @return Index in @c PolyphaseResampler::kTapCounts.
+ * @exception @c std::invalid_argument if @c tapCount is not selectable.
+ */
+std::size_t indexOfTapCount(std::size_t tapCount) {
+  const auto& tapCounts = PolyphaseResampler::kTapCounts;
+  const auto it = std::find(tapCounts.begin(), tapCounts.end(), tapCount);
+  if (it == tapCounts.end()) {
+    throw std::invalid_argument("Tap count must be one of kTapCounts.");
+  }
+  return static_cast<std::size_t>(it - tapCounts.begin());
+}
+
+/// Gain to convert raw samples of the emulator to [-1, 1].
+constexpr float kSampleGain{1.f / std::numeric_limits<std::int16_t>::max()};
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Get duration in nanoseconds.
+ * @param[in] begin Start time.
+ * @param[in] end End time.
+ * @return Nanoseconds.
+ */
+std::uint64_t nanosecondsBetween(Clock::time_point begin,
+                                 Clock::time_point end) {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+          .count());
+}
+
+/**
+ * @brief Dot products of stereo history with two adjacent phases.
+ */
+struct TapSums {
+  float lowerLeft{};   ///< Left channel with the lower phase.
+  float upperLeft{};   ///< Left channel with the upper phase.
+  float lowerRight{};  ///< Right channel with the lower phase.
+  float upperRight{};  ///< Right channel with the upper phase.
+};
+
+#if defined(OPN_POLYPHASE_RESAMPLER_NEON)
+/**
+ * @brief Sum lanes of a vector.
+ * @param[in] v Vector.
+ * @return Sum.
+ */
+inline float sumOfLanes(float32x4_t v) noexcept {
+  const float32x2_t pair = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+  return vget_lane_f32(vpadd_f32(pair, pair), 0);
+}
+#endif
+
+/**
+ * @brief Convolve stereo history with two adjacent phases of the table.
+ * @details Both phases and channels share loads of a tap, and each product
+ * has its own accumulator, so vector lanes are independent partial sums.
+ * @param[in] lower Taps of the lower phase.
+ * @param[in] upper Taps of the upper phase.
+ * @param[in] left History of left channel from the first tap.
+ * @param[in] right History of right channel from the first tap.
+ * @param[in] tapCount The number of taps.
+ * @return Sums.
+ */
+TapSums convolve(const float* lower, const float* upper, const float* left,
+                 const float* right, std::size_t tapCount) noexcept {
+  std::size_t k = 0;
+  TapSums sums;
+
+#if defined(OPN_POLYPHASE_RESAMPLER_SSE2)
+  __m128 lowerLeft = _mm_setzero_ps(), upperLeft = _mm_setzero_ps(),
+         lowerRight = _mm_setzero_ps(), upperRight = _mm_setzero_ps();
+  for (; k + 4 <= tapCount; k += 4) {
+    const __m128 lo = _mm_loadu_ps(lower + k);
+    const __m128 up = _mm_loadu_ps(upper + k);
+    const __m128 l = _mm_loadu_ps(left + k);
+    const __m128 r = _mm_loadu_ps(right + k);
+    lowerLeft = _mm_add_ps(lowerLeft, _mm_mul_ps(lo, l));
+    upperLeft = _mm_add_ps(upperLeft, _mm_mul_ps(up, l));
+    lowerRight = _mm_add_ps(lowerRight, _mm_mul_ps(lo, r));
+    upperRight = _mm_add_ps(upperRight, _mm_mul_ps(up, r));
+  }
+
+  // Transpose and add so that lanes hold the sums in the order of TapSums.
+  const __m128 left02 = _mm_add_ps(_mm_unpacklo_ps(lowerLeft, upperLeft),
+                                   _mm_unpackhi_ps(lowerLeft, upperLeft));
+  const __m128 right02 = _mm_add_ps(_mm_unpacklo_ps(lowerRight, upperRight),
+                                    _mm_unpackhi_ps(lowerRight, upperRight));
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, _mm_add_ps(_mm_movelh_ps(left02, right02),
+                                 _mm_movehl_ps(right02, left02)));
+  sums = {.lowerLeft{lanes[0]},
+          .upperLeft{lanes[1]},
+          .lowerRight{lanes[2]},
+          .upperRight{lanes[3]}};
+#elif defined(OPN_POLYPHASE_RESAMPLER_NEON)
+  float32x4_t lowerLeft = vdupq_n_f32(0.f), upperLeft = vdupq_n_f32(0.f),
+              lowerRight = vdupq_n_f32(0.f), upperRight = vdupq_n_f32(0.f);
+  for (; k + 4 <= tapCount; k += 4) {
+    const float32x4_t lo = vld1q_f32(lower + k);
+    const float32x4_t up = vld1q_f32(upper + k);
+    const float32x4_t l = vld1q_f32(left + k);
+    const float32x4_t r = vld1q_f32(right + k);
+    lowerLeft = vmlaq_f32(lowerLeft, lo, l);
+    upperLeft = vmlaq_f32(upperLeft, up, l);
+    lowerRight = vmlaq_f32(lowerRight, lo, r);
+    upperRight = vmlaq_f32(upperRight, up, r);
+  }
+  sums = {.lowerLeft{sumOfLanes(lowerLeft)},
+          .upperLeft{sumOfLanes(upperLeft)},
+          .lowerRight{sumOfLanes(lowerRight)},
+          .upperRight{sumOfLanes(upperRight)}};
+#endif
+
+  for (; k < tapCount; ++k) {
+    sums.lowerLeft += lower[k] * left[k];
+    sums.upperLeft += upper[k] * left[k];
+    sums.lowerRight += lower[k] * right[k];
+    sums.upperRight += upper[k] * right[k];
+  }
+
+  return sums;
+}
+
+/**
+ * @brief Normalized sinc function.
+ * @param[in] x Argument.
+ * @return sin(pi x) / (pi x).
+ */
+double sinc(double x) {
+  if (x == 0.) {
+    return 1.;
+  }
+  const double px = std::numbers::pi * x;
+  return std::sin(px) / px;
+}
+
+/**
+ * @brief Blackman window.
+ * @param[in] x Position from the center.
+ * @param[in] halfWidth Half width of the window.
+ * @return Window value.
+ */
+double blackman(double x, double halfWidth) {
+  if (halfWidth <= std::abs(x)) {
+    return 0.;
+  }
+  const double t = std::numbers::pi * x / halfWidth;
+  return 0.42 + 0.5 * std::cos(t) + 0.08 * std::cos(2. * t);
+}
+
+/**
+ * @brief Compute a coefficient table.
+ * @param[out] table Table of @c phaseCount + 1 rows of @c tapCount taps.
+ * @param[in] tapCount The number of taps per phase.
+ * @param[in] phaseCount The number of phases.
+ * @param[in] cutoff Cutoff frequency in cycles per input sample.
+ */
+void computeTable(std::vector<float>& table, std::size_t tapCount,
+                  std::size_t phaseCount, double cutoff) {
+  const double center = static_cast<double>(tapCount / 2 - 1);
+  const double halfWidth = static_cast<double>(tapCount / 2);
+
+  table.resize((phaseCount + 1) * tapCount);
+  std::vector<double> taps(tapCount);
+  for (std::size_t phase = 0; phase <= phaseCount; ++phase) {
+    const double fraction = static_cast<double>(phase) / phaseCount;
+    float* row = table.data() + phase * tapCount;
+
+    double sum{};
+    for (std::size_t k = 0; k < tapCount; ++k) {
+      const double x = static_cast<double>(k) - center - fraction;
+      taps[k] = sinc(2. * cutoff * x) * blackman(x, halfWidth);
+      sum += taps[k];
+    }
+
+    // Normalize DC gain of each phase to avoid ripple between phases.
+    for (std::size_t k = 0; k < tapCount; ++k) {
+      row[k] = static_cast<float>(taps[k] / sum);
+    }
+  }
+}
+}  // namespace
+
+PolyphaseResampler::PolyphaseResampler(FmAudioSource* source,
+                                       std::size_t tapCount)
+    : source_(source), tapCountIndex_(indexOfTapCount(tapCount)) {}
+
+void PolyphaseResampler::setTapCount(std::size_t tapCount) {
+  tapCountIndex_ = indexOfTapCount(tapCount);
+}
+
+void PolyphaseResampler::prepareToPlay(int samplesPerBlockExpected,
+                                       double sampleRate) {
+  inputRate_ = source_->synthesisRate();
+  step_ = inputRate_ / sampleRate;
+  const double cutoff =
+      0.5 * std::min(1., sampleRate / inputRate_) * kPassbandRatio;
+
+  // All tables are computed here so that changing taps only selects one.
+  for (std::size_t i = 0; i < kTapCounts.size(); ++i) {
+    computeTable(coefficientTables_[i], kTapCounts[i], kPhaseCount, cutoff);
+  }
+
+  const auto maxInputCount =
+      static_cast<std::size_t>(std::ceil(samplesPerBlockExpected * step_)) +
+      kMaxTapCount + 1;
+  inputBuffer_.resize(maxInputCount);
+  leftHistory_.assign(maxInputCount + kMaxTapCount, 0.f);
+  rightHistory_.assign(maxInputCount + kMaxTapCount, 0.f);
+
+  // Start with silence so that the first output is centered on the first
+  // generated sample.
+  historySize_ = kMaxTapCount / 2 - 1;
+  position_ = 0.;
+
+  // Synthesis rate may have changed.
+  outputStage_ = sample_conversion::OutputStage(outputStageSettings_,
+                                                kSampleGain, inputRate_);
+  outputStageState_ = {};
+
+  source_->prepareToPlay(static_cast<int>(maxInputCount), inputRate_);
+
+  // The center tap of the first output reads the next generated frame.
+  centerFrame_ = source_->renderedSampleCount();
+}
+
+void PolyphaseResampler::releaseResources() {
+  source_->releaseResources();
+
+  for (auto& table : coefficientTables_) {
+    table.clear();
+  }
+  leftHistory_.clear();
+  rightHistory_.clear();
+  inputBuffer_.clear();
+  historySize_ = 0;
+}
+
+void PolyphaseResampler::getNextAudioBlock(
+    const juce::AudioSourceChannelInfo& bufferToFill) {
+  const auto numSamples = static_cast<std::size_t>(bufferToFill.numSamples);
+  if (!numSamples) {
+    return;
+  }
+
+  const double lastPosition = position_ + step_ * (numSamples - 1);
+  const auto requiredSize =
+      static_cast<std::size_t>(lastPosition) + kMaxTapCount;
+  if (historySize_ < requiredSize) {
+    fetch(requiredSize - historySize_);
+  }
+
+  // Fewer taps start later in the window of the maximum taps, so the center
+  // tap reads the same frame.
+  const std::size_t tapCount = kTapCounts[tapCountIndex_];
+  const float* coefficients = coefficientTables_[tapCountIndex_].data();
+  const float* leftInput = leftHistory_.data() + (kMaxTapCount - tapCount) / 2;
+  const float* rightInput =
+      rightHistory_.data() + (kMaxTapCount - tapCount) / 2;
+
+  auto* buffer = bufferToFill.buffer;
+  const int numChannels = buffer->getNumChannels();
+  float* left = buffer->getWritePointer(0, bufferToFill.startSample);
+  float* right = numChannels == 1
+                     ? nullptr
+                     : buffer->getWritePointer(1, bufferToFill.startSample);
+
+  for (std::size_t i = 0; i < numSamples; ++i) {
+    const auto base = static_cast<std::size_t>(position_);
+    const double scaledFraction = (position_ - base) * kPhaseCount;
+    const auto phase = static_cast<std::size_t>(scaledFraction);
+    const auto weight = static_cast<float>(scaledFraction - phase);
+
+    // Filtering is linear, so interpolating outputs of the two phases equals
+    // filtering with interpolated taps, at one interpolation per output.
+    const float* lower = coefficients + phase * tapCount;
+    const TapSums sums = convolve(lower, lower + tapCount, leftInput + base,
+                                  rightInput + base, tapCount);
+    const float leftSum =
+        sums.lowerLeft + weight * (sums.upperLeft - sums.lowerLeft);
+    const float rightSum =
+        sums.lowerRight + weight * (sums.upperRight - sums.lowerRight);
+
+    if (right) {
+      left[i] = leftSum;
+      right[i] = rightSum;
+    } else {
+      left[i] = std::midpoint(leftSum, rightSum);
+    }
+
+    position_ += step_;
+  }
+
+  for (int ch = 2; ch < numChannels; ++ch) {
+    buffer->clear(ch, bufferToFill.startSample, bufferToFill.numSamples);
+  }
+
+  // Discard frames which are no longer referred.
+  const auto consumed =
+      std::min(static_cast<std::size_t>(position_), historySize_);
+  std::copy(leftHistory_.begin() + consumed,
+            leftHistory_.begin() + historySize_, leftHistory_.begin());
+  std::copy(rightHistory_.begin() + consumed,
+            rightHistory_.begin() + historySize_, rightHistory_.begin());
+  historySize_ -= consumed;
+  position_ -= consumed;
+  centerFrame_ += consumed;
+}
+
+void PolyphaseResampler::setOutputStage(
+    const sample_conversion::OutputStageSettings& settings) noexcept {
+  if (settings == outputStageSettings_) {
+    return;
+  }
+
+  // DC blockers do not track samples while they are disabled.
+  if (!outputStageSettings_.isDcBlockerEnabled) {
+    outputStageState_ = {};
+  }
+
+  outputStageSettings_ = settings;
+  outputStage_ =
+      sample_conversion::OutputStage(settings, kSampleGain, inputRate_);
+}
+
+std::uint64_t PolyphaseResampler::sourceFrameAt(
+    std::size_t outputIndex) const noexcept {
+  // The window of the maximum taps reads kMaxTapCount frames from the integer
+  // part of the position, and its center is kMaxTapCount / 2 - 1 frames after
+  // the top.
+  const auto base = static_cast<std::uint64_t>(position_ + outputIndex * step_);
+  return centerFrame_ + base + kMaxTapCount / 2 + 1;
+}
+
+void PolyphaseResampler::fetch(std::size_t count) {
+  if (inputBuffer_.size() < count) {
+    inputBuffer_.resize(count);
+  }
+  if (leftHistory_.size() < historySize_ + count) {
+    leftHistory_.resize(historySize_ + count);
+    rightHistory_.resize(historySize_ + count);
+  }
+
+  const auto begin = Clock::now();
+  source_->render(inputBuffer_.data(), count);
+  const auto rendered = Clock::now();
+
+  // Each frame is converted once here rather than at every tap, because a
+  // frame is read by about tapCount / step_ outputs.
+  sample_conversion::StereoLevel level;
+  float* left = leftHistory_.data() + historySize_;
+  float* right = rightHistory_.data() + historySize_;
+  if (outputStageSettings_.isActive()) {
+    sample_conversion::deinterleave(inputBuffer_.data(), count, left, right,
+                                    outputStage_, outputStageState_, level);
+  } else {
+    sample_conversion::deinterleave(inputBuffer_.data(), count, left, right,
+                                    kSampleGain, level);
+  }
+  historySize_ += count;
+  source_->measure(level, count);
+
+  emulationNanoseconds_ += nanosecondsBetween(begin, rendered);
+  conversionNanoseconds_ += nanosecondsBetween(rendered, Clock::now());
+}
+}  // namespace audio
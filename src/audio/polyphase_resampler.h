@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <ymfm_opn.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sample_conversion.h"
+
+namespace audio {
+class FmAudioSource;
+
+/**
+ * @brief Band-limited resampler converting output of @c FmAudioSource from
+ * synthesis rate to sample rate of host.
+ * @details It is a windowed-sinc polyphase filter. Tables of coefficients for
+ * all of @c kTapCounts are computed in @c prepareToPlay(). Fractional phases
+ * between the table rows are linearly interpolated, so any ratio is supported.
+ * Outputs are centered on the same input frame with any number of taps, so the
+ * latency is that of @c kHighQualityTapCount and the number of taps can change
+ * while playing. Raw samples of the emulator are converted to float once per
+ * frame when they are appended to the history, and the optional output stage
+ * is applied in the same pass.
+ */
+class PolyphaseResampler final : public juce::AudioSource {
+ public:
+  /// The number of taps per phase for the lowest quality.
+  static constexpr std::size_t kEcoTapCount{16};
+
+  /// The number of taps per phase for realtime playback.
+  static constexpr std::size_t kDefaultTapCount{32};
+
+  /// The number of taps per phase for offline rendering.
+  static constexpr std::size_t kHighQualityTapCount{64};
+
+  /// The numbers of taps per phase which can be selected.
+  static constexpr std::array<std::size_t, 3> kTapCounts{
+      kEcoTapCount, kDefaultTapCount, kHighQualityTapCount};
+
+  /**
+   * @brief Constructor.
+   * @param[in] source Audio source to resample. It is not owned.
+   * @param[in] tapCount The number of taps per phase. More taps give steeper
+   * transition band and better attenuation of aliasing. It must be one of
+   * @c kTapCounts.
+   * @exception @c std::invalid_argument if @c tapCount is invalid.
+   */
+  explicit PolyphaseResampler(FmAudioSource* source,
+                              std::size_t tapCount = kDefaultTapCount);
+
+  /**
+   * @brief Change the number of taps per phase.
+   * @details The history and the source are kept, so playback continues
+   * without a gap. Only the table in use is switched, so it is cheap enough
+   * for the audio thread.
+   * @param[in] tapCount The number of taps per phase, which has the same
+   * requirements as the constructor.
+   * @exception @c std::invalid_argument if @c tapCount is invalid.
+   */
+  void setTapCount(std::size_t tapCount);
+
+  /**
+   * @brief Compute filter coefficients and prepare the source.
+   * @param[in] samplesPerBlockExpected The number of samples in a block.
+   * @param[in] sampleRate Output sample rate.
+   */
+  void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+  /**
+   * @brief Release buffers of the resampler and the source.
+   */
+  void releaseResources() override;
+
+  /**
+   * @brief Fill the buffer with resampled samples.
+   * @param[in,out] bufferToFill Buffer which is filled.
+   */
+  void getNextAudioBlock(
+      const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+  /**
+   * @brief Set the output stage applied while converting samples of the
+   * source.
+   * @details The stage runs at synthesis rate before resampling. Coefficients
+   * are calculated here and when the resampler is prepared, not per block.
+   * @param[in] settings Settings. If nothing is enabled, samples are converted
+   * without the stage.
+   * @note It must be called from the thread which fills blocks.
+   */
+  void setOutputStage(
+      const sample_conversion::OutputStageSettings& settings) noexcept;
+
+  /**
+   * @brief Get the frame of the source where a change starts at an output
+   * sample.
+   * @details It is the first frame after the window of the sample, so it is
+   * not generated yet and changes at it are never applied late. Changes are
+   * delayed by half the window of the maximum taps for all samples. It follows
+   * the frames consumed from the history and the fractional phase.
+   * @param[in] outputIndex Index of the sample in the next block.
+   * @return Frame index in synthesis rate, counted in the same way as
+   * @c FmAudioSource::renderedSampleCount().
+   */
+  std::uint64_t sourceFrameAt(std::size_t outputIndex) const noexcept;
+
+  /**
+   * @brief Get time spent for generating samples by the source.
+   * @return Nanoseconds since construction.
+   */
+  std::uint64_t emulationNanoseconds() const noexcept {
+    return emulationNanoseconds_;
+  }
+
+  /**
+   * @brief Get time spent for converting generated samples to float.
+   * @return Nanoseconds since construction.
+   */
+  std::uint64_t conversionNanoseconds() const noexcept {
+    return conversionNanoseconds_;
+  }
+
+ private:
+  /// The number of phases in the coefficient table.
+  static constexpr std::size_t kPhaseCount{256};
+
+  /// The maximum number of taps per phase, which determines the latency.
+  static constexpr std::size_t kMaxTapCount{kHighQualityTapCount};
+
+  /// Audio source.
+  FmAudioSource* source_;
+
+  /// Index of the number of taps per phase in @c kTapCounts.
+  std::size_t tapCountIndex_;
+
+  /**
+   * @brief Coefficient tables of @c kTapCounts. Each has @c kPhaseCount + 1
+   * rows of its taps and the last row is used only for interpolation.
+   */
+  std::array<std::vector<float>, kTapCounts.size()> coefficientTables_;
+
+  /// History of left channel in synthesis rate.
+  std::vector<float> leftHistory_;
+
+  /// History of right channel in synthesis rate.
+  std::vector<float> rightHistory_;
+
+  /// The number of valid frames in the history.
+  std::size_t historySize_{};
+
+  /// Temporary buffer to store samples generated by the source.
+  std::vector<ymfm::ym2608::output_data> inputBuffer_;
+
+  /// Synthesis rate of the source.
+  double inputRate_{};
+
+  /// Input samples per output sample.
+  double step_{1.};
+
+  /// Position of the next output sample in the history.
+  double position_{};
+
+  /// Frame of the source read by the center tap at position zero.
+  std::uint64_t centerFrame_{};
+
+  /// Settings of the output stage.
+  sample_conversion::OutputStageSettings outputStageSettings_;
+
+  /// Coefficients of the output stage.
+  sample_conversion::OutputStage outputStage_;
+
+  /// State of DC blockers of the output stage.
+  sample_conversion::OutputStageState outputStageState_;
+
+  /// Time spent for generating samples by the source.
+  std::uint64_t emulationNanoseconds_{};
+
+  /// Time spent for converting generated samples.
+  std::uint64_t conversionNanoseconds_{};
+
+  /**
+   * @brief Generate samples from the source and append them to the history.
+   * @param[in] count The number of frames to append.
+   */
+  void fetch(std::size_t count);
+};
+}  // namespace audio
@@ -19,6 +19,11 @@ struct Register {
   /// Data to write.
   std::uint8_t data{};
 
+  /**
+   * @brief Constructor which makes a write of 0 to $00.
+   */
+  Register() = default;
+
   /**
    * @brief Constructor.
    * @param[in] pinA1 State of pin A1.
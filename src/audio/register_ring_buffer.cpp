@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "register_ring_buffer.h"
+
+#include <bit>
+
+namespace audio {
+RegisterRingBuffer::RegisterRingBuffer(std::size_t capacity) {
+  allocate(capacity);
+}
+
+void RegisterRingBuffer::allocate(std::size_t capacity) {
+  buffer_.assign(std::bit_ceil(capacity ? capacity : 1u), Entry{});
+  mask_ = buffer_.size() - 1u;
+  head_ = tail_;
+}
+
+bool RegisterRingBuffer::tryPush(const Register& reg,
+                                 std::uint64_t timestamp) noexcept {
+  if (buffer_.size() <= size()) {
+    overflowCount_.fetch_add(1u, std::memory_order_relaxed);
+    return false;
+  }
+
+  buffer_[tail_++ & mask_] = Entry{.reg{reg}, .timestamp{timestamp}};
+  return true;
+}
+
+bool RegisterRingBuffer::tryPush(std::initializer_list<Register> regs,
+                                 std::uint64_t timestamp) noexcept {
+  if (buffer_.size() < size() + regs.size()) {
+    overflowCount_.fetch_add(regs.size(), std::memory_order_relaxed);
+    return false;
+  }
+
+  for (const auto& reg : regs) {
+    buffer_[tail_++ & mask_] = Entry{.reg{reg}, .timestamp{timestamp}};
+  }
+  return true;
+}
+}  // namespace audio
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <vector>
+
+#include "register.h"
+
+namespace audio {
+/**
+ * @brief Fixed-capacity FIFO queue of timestamped register writes.
+ *
+ * @details Memory is allocated only by @c allocate(), so pushing and draining
+ * never allocate or lock. When the queue is full, a new write is discarded and
+ * counted as overflow.
+ *
+ * Each write has a timestamp which is the index of the sample where the write
+ * should be applied. Timestamps must be pushed in non-decreasing order.
+ *
+ * @note It is not thread-safe. Writes must be pushed and drained on the same
+ * thread.
+ */
+class RegisterRingBuffer {
+ public:
+  /**
+   * @brief Constructor.
+   * @param[in] capacity The minimum number of writes which the buffer can hold.
+   */
+  explicit RegisterRingBuffer(std::size_t capacity = 0);
+
+  /**
+   * @brief Allocate memory and clear all writes.
+   * @details Positions of writes keep increasing over allocation.
+   * @param[in] capacity The minimum number of writes which the buffer can hold.
+   * It is rounded up to a power of two.
+   */
+  void allocate(std::size_t capacity);
+
+  /**
+   * @brief Try to push a register write.
+   * @param[in] reg Register write.
+   * @param[in] timestamp Sample index where the write should be applied.
+   * @return @c true if @c reg is pushed, or @c false if the buffer is full.
+   */
+  bool tryPush(const Register& reg, std::uint64_t timestamp = 0u) noexcept;
+
+  /**
+   * @brief Try to push register writes at once.
+   * @param[in] regs Register writes.
+   * @param[in] timestamp Sample index where the writes should be applied.
+   * @return @c true if all writes are pushed, or @c false if the buffer does
+   * not have enough space. In that case, no write is pushed.
+   */
+  bool tryPush(std::initializer_list<Register> regs,
+               std::uint64_t timestamp = 0u) noexcept;
+
+  /**
+   * @brief Get the position where the next write will be pushed.
+   * @return Position. It increases monotonically for the lifetime of the
+   * buffer.
+   */
+  std::uint64_t nextPosition() const noexcept { return tail_; }
+
+  /**
+   * @brief Find a write which has been pushed but not popped yet.
+   * @param[in] position Position returned by @c nextPosition() before pushing.
+   * @return Pointer to the write, or @c nullptr if it was already popped.
+   */
+  Register* findPending(std::uint64_t position) noexcept {
+    return (head_ <= position && position < tail_)
+               ? &buffer_[position & mask_].reg
+               : nullptr;
+  }
+
+  /**
+   * @brief Get the timestamp of the oldest write.
+   * @return Timestamp, or @c std::nullopt if the buffer is empty.
+   */
+  std::optional<std::uint64_t> frontTimestamp() const noexcept {
+    if (empty()) {
+      return std::nullopt;
+    }
+    return buffer_[head_ & mask_].timestamp;
+  }
+
+  /**
+   * @brief Pop all writes in FIFO order.
+   * @param[in] consumer Function called with each popped write.
+   */
+  template <std::invocable<const Register&> F>
+  void drain(F&& consumer) {
+    for (; head_ != tail_; ++head_) {
+      consumer(buffer_[head_ & mask_].reg);
+    }
+  }
+
+  /**
+   * @brief Pop writes whose timestamp is not later than the given time.
+   * @param[in] timestamp Current sample index.
+   * @param[in] consumer Function called with each popped write.
+   */
+  template <std::invocable<const Register&> F>
+  void drainUntil(std::uint64_t timestamp, F&& consumer) {
+    for (; head_ != tail_ && buffer_[head_ & mask_].timestamp <= timestamp;
+         ++head_) {
+      consumer(buffer_[head_ & mask_].reg);
+    }
+  }
+
+  /**
+   * @brief Discard all writes.
+   */
+  void clear() noexcept { head_ = tail_; }
+
+  /**
+   * @brief Get the number of writes in the buffer.
+   * @return The number of writes.
+   */
+  std::size_t size() const noexcept {
+    return static_cast<std::size_t>(tail_ - head_);
+  }
+
+  /**
+   * @brief Whether the buffer has no write.
+   * @return @c true if the buffer is empty, otherwise @c false.
+   */
+  bool empty() const noexcept { return head_ == tail_; }
+
+  /**
+   * @brief Get the number of writes which the buffer can hold.
+   * @return Capacity.
+   */
+  std::size_t capacity() const noexcept { return buffer_.size(); }
+
+  /**
+   * @brief Get the number of writes discarded because the buffer was full.
+   * @return Overflow count. It is safe to read from any thread.
+   */
+  std::uint64_t overflowCount() const noexcept {
+    return overflowCount_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /// Element of the buffer.
+  struct Entry {
+    Register reg;             ///< Register write.
+    std::uint64_t timestamp;  ///< Sample index where the write is applied.
+  };
+
+  /// Storage of writes. Its size is a power of two.
+  std::vector<Entry> buffer_;
+
+  /// Mask to wrap an index into @c buffer_.
+  std::uint64_t mask_{};
+
+  /// Total number of popped and pushed writes.
+  std::uint64_t head_{}, tail_{};
+
+  /// Number of discarded writes.
+  std::atomic_uint64_t overflowCount_{};
+};
+}  // namespace audio
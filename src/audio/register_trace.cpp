@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "register_trace.h"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+
+namespace audio {
+namespace {
+/// Identifier at the top of a file.
+constexpr std::array<char, 4> kMagic{'O', 'P', 'N', 'T'};
+
+/// Version of the file format.
+constexpr std::uint8_t kVersion{1};
+
+/// Size of a header in bytes.
+constexpr std::size_t kHeaderSize{16};
+
+/// Size of a record in bytes.
+constexpr std::size_t kRecordSize{12};
+
+/// Size of the buffer of the output stream in bytes.
+constexpr std::size_t kStreamBufferSize{std::size_t{1} << 16};
+
+/// Interval of draining rings.
+constexpr std::chrono::milliseconds kDrainInterval{10};
+
+/**
+ * @brief Store a value in little endian.
+ * @param[out] bytes Destination.
+ * @param[in] value Value.
+ * @param[in] byteCount The number of bytes to store.
+ */
+void putLittleEndian(std::uint8_t* bytes, std::uint64_t value,
+                     std::size_t byteCount) noexcept {
+  for (std::size_t i = 0; i < byteCount; ++i) {
+    bytes[i] = static_cast<std::uint8_t>(value >> (8u * i));
+  }
+}
+
+/**
+ * @brief Load a value in little endian.
+ * @param[in] bytes Source.
+ * @param[in] byteCount The number of bytes to load.
+ * @return Value.
+ */
+std::uint64_t getLittleEndian(const std::uint8_t* bytes,
+                              std::size_t byteCount) noexcept {
+  std::uint64_t value{};
+  for (std::size_t i = byteCount; i--;) {
+    value = (value << 8u) | bytes[i];
+  }
+  return value;
+}
+}  // namespace
+
+std::optional<RegisterTrace> readRegisterTrace(const juce::File& file) {
+  juce::MemoryBlock data;
+  if (!file.loadFileAsData(data) || data.getSize() < kHeaderSize) {
+    return std::nullopt;
+  }
+
+  const auto* bytes = static_cast<const std::uint8_t*>(data.getData());
+  if (std::memcmp(bytes, kMagic.data(), kMagic.size()) ||
+      bytes[4] != kVersion) {
+    return std::nullopt;
+  }
+
+  RegisterTrace trace;
+  trace.format.chipCount = bytes[5];
+  trace.format.clockHz =
+      static_cast<std::uint32_t>(getLittleEndian(bytes + 8, 4));
+  trace.format.sampleRate =
+      static_cast<std::uint32_t>(getLittleEndian(bytes + 12, 4));
+
+  const std::size_t recordCount = (data.getSize() - kHeaderSize) / kRecordSize;
+  trace.writes.reserve(recordCount);
+  for (const auto* record = bytes + kHeaderSize;
+       trace.writes.size() < recordCount; record += kRecordSize) {
+    trace.writes.push_back(
+        {.sampleIndex{getLittleEndian(record, 8)},
+         .chip{record[8]},
+         .change{Register(record[9] != 0u, record[10], record[11])}});
+  }
+
+  return trace;
+}
+
+RegisterTraceRecorder::~RegisterTraceRecorder() { stop(); }
+
+bool RegisterTraceRecorder::start(const juce::File& file,
+                                  const TraceFormat& format) {
+  stop();
+
+  file.deleteFile();
+  stream_ = std::make_unique<juce::FileOutputStream>(file, kStreamBufferSize);
+  if (!stream_->openedOk()) {
+    stream_.reset();
+    return false;
+  }
+
+  std::array<std::uint8_t, kHeaderSize> header{};
+  std::memcpy(header.data(), kMagic.data(), kMagic.size());
+  header[4] = kVersion;
+  header[5] = format.chipCount;
+  putLittleEndian(header.data() + 8, format.clockHz, 4);
+  putLittleEndian(header.data() + 12, format.sampleRate, 4);
+  stream_->write(header.data(), header.size());
+
+  rings_.resize(format.chipCount);
+  for (auto& ring : rings_) {
+    if (!ring) {
+      ring = std::make_unique<Ring>();
+      ring->writes.resize(kRingCapacity);
+    }
+    ring->head.store(0u, std::memory_order_relaxed);
+    ring->tail.store(0u, std::memory_order_relaxed);
+  }
+
+  droppedWriteCount_.store(0u, std::memory_order_relaxed);
+  shouldStop_.store(false, std::memory_order_relaxed);
+  thread_ = std::thread([this] {
+    while (!shouldStop_.load(std::memory_order_relaxed)) {
+      drain();
+      std::this_thread::sleep_for(kDrainInterval);
+    }
+  });
+
+  return true;
+}
+
+void RegisterTraceRecorder::stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+
+  shouldStop_.store(true, std::memory_order_relaxed);
+  thread_.join();
+
+  // Write the rest recorded after the last drain of the thread.
+  drain();
+  stream_->flush();
+  stream_.reset();
+}
+
+void RegisterTraceRecorder::record(std::uint8_t chip, std::uint64_t sampleIndex,
+                                   const Register& change) noexcept {
+  auto& ring = *rings_[chip];
+  const std::size_t tail = ring.tail.load(std::memory_order_relaxed);
+  if (kRingCapacity <= tail - ring.head.load(std::memory_order_acquire)) {
+    droppedWriteCount_.fetch_add(1u, std::memory_order_relaxed);
+    return;
+  }
+
+  ring.writes[tail % kRingCapacity] = {
+      .sampleIndex{sampleIndex}, .chip{chip}, .change{change}};
+  ring.tail.store(tail + 1u, std::memory_order_release);
+}
+
+void RegisterTraceRecorder::drain() {
+  std::array<std::uint8_t, kRecordSize> record{};
+  for (auto& ring : rings_) {
+    const std::size_t head = ring->head.load(std::memory_order_relaxed);
+    const std::size_t tail = ring->tail.load(std::memory_order_acquire);
+    for (std::size_t i = head; i != tail; ++i) {
+      const auto& write = ring->writes[i % kRingCapacity];
+      putLittleEndian(record.data(), write.sampleIndex, 8);
+      record[8] = write.chip;
+      record[9] = write.change.pinA1 ? 1u : 0u;
+      record[10] = write.change.address;
+      record[11] = write.change.data;
+      stream_->write(record.data(), record.size());
+    }
+    ring->head.store(tail, std::memory_order_release);
+  }
+}
+}  // namespace audio
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "register.h"
+
+namespace audio {
+/**
+ * @brief Properties of the chips which wrote a trace.
+ */
+struct TraceFormat {
+  std::uint8_t chipCount{};    ///< The number of chips.
+  std::uint32_t clockHz{};     ///< Input clock of chips.
+  std::uint32_t sampleRate{};  ///< Output rate of chips (Hz.)
+};
+
+/**
+ * @brief Register write applied to an emulator.
+ */
+struct TracedWrite {
+  /// Index of sample in synthesis rate when the write was applied.
+  std::uint64_t sampleIndex{};
+
+  std::uint8_t chip{};  ///< Index of the chip.
+  Register change;      ///< Register write.
+};
+
+/**
+ * @brief Register writes read from a trace file.
+ */
+struct RegisterTrace {
+  TraceFormat format;               ///< Properties of chips.
+  std::vector<TracedWrite> writes;  ///< Writes in the order of the file.
+};
+
+/**
+ * @brief Read a trace file.
+ * @details A file has a header of 16 bytes followed by records of 12 bytes in
+ * little endian:
+ * - Header: "OPNT", version, chip count, 2 reserved bytes, clock (32-bit) and
+ *   output rate (32-bit.)
+ * - Record: sample index (64-bit), chip, pin A1, address and data.
+ *
+ * Records of a chip are in the order of application, and records of different
+ * chips may interleave in any order.
+ * @param[in] file Trace file.
+ * @return Trace, or @c std::nullopt if the file is not a trace.
+ */
+std::optional<RegisterTrace> readRegisterTrace(const juce::File& file);
+
+/**
+ * @brief Recorder of register writes applied to emulators.
+ * @details Each chip has a preallocated single-producer single-consumer ring,
+ * so recording never locks or allocates even if chips render on different
+ * threads. A background thread drains rings to a file. When a ring is full, a
+ * write is discarded and counted.
+ */
+class RegisterTraceRecorder {
+ public:
+  /// The number of writes which a ring of a chip holds.
+  static constexpr std::size_t kRingCapacity{std::size_t{1} << 16};
+
+  /**
+   * @brief Constructor.
+   */
+  RegisterTraceRecorder() = default;
+
+  /**
+   * @brief Destructor, which stops recording.
+   */
+  ~RegisterTraceRecorder();
+
+  /**
+   * @brief Open a file and start the thread to write traces.
+   * @param[in] file Trace file. It is overwritten.
+   * @param[in] format Properties of chips.
+   * @return @c true if the file is opened.
+   * @note Chips must not record while starting.
+   */
+  bool start(const juce::File& file, const TraceFormat& format);
+
+  /**
+   * @brief Write all recorded writes and close the file.
+   * @note Chips must not record while stopping.
+   */
+  void stop();
+
+  /**
+   * @brief Record a register write.
+   * @param[in] chip Index of the chip. Each chip must record on one thread.
+   * @param[in] sampleIndex Index of sample when the write is applied.
+   * @param[in] change Register write.
+   */
+  void record(std::uint8_t chip, std::uint64_t sampleIndex,
+              const Register& change) noexcept;
+
+  /**
+   * @brief Get the number of writes discarded because a ring was full.
+   * @return The number of discarded writes since start.
+   */
+  std::uint64_t droppedWriteCount() const noexcept {
+    return droppedWriteCount_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /**
+   * @brief Ring of writes of a chip.
+   */
+  struct Ring {
+    std::vector<TracedWrite> writes;  ///< Storage of @c kRingCapacity writes.
+    std::atomic_size_t head{};        ///< Position read next by the thread.
+    std::atomic_size_t tail{};        ///< Position written next by the chip.
+  };
+
+  /// Rings of chips.
+  std::vector<std::unique_ptr<Ring>> rings_;
+
+  /// Output stream, which is touched only by the thread after start.
+  std::unique_ptr<juce::FileOutputStream> stream_;
+
+  /// Thread which drains rings.
+  std::thread thread_;
+
+  /// Whether the thread should finish.
+  std::atomic_bool shouldStop_{};
+
+  /// The number of discarded writes.
+  std::atomic_uint64_t droppedWriteCount_{};
+
+  /**
+   * @brief Write writes in rings to the stream.
+   */
+  void drain();
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RegisterTraceRecorder)
+};
+}  // namespace audio
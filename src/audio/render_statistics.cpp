@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "render_statistics.h"
+
+#include <bit>
+#include <type_traits>
+
+namespace audio {
+namespace {
+/// Words of @c BlockStatistics.
+using Words =
+    std::array<std::uint64_t, sizeof(BlockStatistics) / sizeof(std::uint64_t)>;
+
+static_assert(sizeof(Words) == sizeof(BlockStatistics),
+              "BlockStatistics must consist of 64-bit words.");
+static_assert(std::is_trivially_copyable_v<BlockStatistics>);
+}  // namespace
+
+void RenderStatistics::publish(const BlockStatistics& statistics) noexcept {
+  const auto words = std::bit_cast<Words>(statistics);
+
+  const std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1u, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (std::size_t i = 0; i < kWordCount; ++i) {
+    words_[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  sequence_.store(sequence + 2u, std::memory_order_release);
+}
+
+BlockStatistics RenderStatistics::snapshot() const noexcept {
+  Words words;
+  while (true) {
+    const std::uint64_t sequence = sequence_.load(std::memory_order_acquire);
+    if (sequence % 2u) {
+      // The audio thread is writing.
+      continue;
+    }
+
+    for (std::size_t i = 0; i < kWordCount; ++i) {
+      words[i] = words_[i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) == sequence) {
+      return std::bit_cast<BlockStatistics>(words);
+    }
+  }
+}
+}  // namespace audio
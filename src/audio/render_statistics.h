@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace audio {
+/**
+ * @brief Measurements of a processed block.
+ * @details Durations are in nanoseconds. Fields named "total" are cumulative
+ * since the processor is constructed, and the others are of the latest block.
+ */
+struct BlockStatistics {
+  std::uint64_t totalBlockCount{};  ///< The number of processed blocks.
+  std::uint64_t sampleCount{};      ///< Block size in host sample rate.
+
+  /// Real time which the block represents.
+  std::uint64_t budgetNanoseconds{};
+
+  /// Time spent for the whole block.
+  std::uint64_t processNanoseconds{};
+
+  /// Time spent for emulation.
+  std::uint64_t emulationNanoseconds{};
+
+  /// Time spent for resampling except emulation and conversion.
+  std::uint64_t resamplingNanoseconds{};
+
+  /// Time spent for conversion of emulator output to float.
+  std::uint64_t conversionNanoseconds{};
+
+  std::uint64_t midiEventCount{};        ///< The number of MIDI events.
+  std::uint64_t parameterChangeCount{};  ///< Changes dequeued from the queue.
+  std::uint64_t registerWriteCount{};    ///< Writes applied to emulators.
+
+  /// The number of times rendering of a chip was split by timestamped writes.
+  std::uint64_t renderSplitCount{};
+
+  /// The number of blocks whose processing took longer than the budget.
+  std::uint64_t totalOverloadedBlockCount{};
+
+  /// The number of register writes discarded because a queue was full.
+  std::uint64_t totalOverflowedRegisterWriteCount{};
+
+  /**
+   * @brief Get DSP load of the block.
+   * @return Ratio of processing time to the budget. 1 or more means overrun.
+   */
+  double load() const noexcept {
+    return budgetNanoseconds ? static_cast<double>(processNanoseconds) /
+                                   static_cast<double>(budgetNanoseconds)
+                             : 0.;
+  }
+};
+
+/**
+ * @brief Statistics of rendering published by the audio thread.
+ * @details It is a sequence lock over atomic words. The audio thread never
+ * waits, and readers on any thread retry until they get a consistent copy.
+ */
+class RenderStatistics {
+ public:
+  /**
+   * @brief Publish statistics of a block.
+   * @param[in] statistics Statistics.
+   * @note It must be called from only one thread.
+   */
+  void publish(const BlockStatistics& statistics) noexcept;
+
+  /**
+   * @brief Get statistics of the latest block.
+   * @return Statistics.
+   */
+  BlockStatistics snapshot() const noexcept;
+
+ private:
+  /// The number of words in @c BlockStatistics.
+  static constexpr std::size_t kWordCount{sizeof(BlockStatistics) /
+                                          sizeof(std::uint64_t)};
+
+  /// Sequence number. It is odd while writing.
+  std::atomic<std::uint64_t> sequence_{};
+
+  /// Published statistics.
+  std::array<std::atomic<std::uint64_t>, kWordCount> words_{};
+};
+}  // namespace audio
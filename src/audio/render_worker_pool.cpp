@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "render_worker_pool.h"
+
+namespace audio {
+namespace {
+/// The number of polls before a worker parks.
+constexpr int kSpinCount{4096};
+
+/// Shift of the number of tasks in a task claim.
+constexpr int kTaskCountShift{32};
+
+/// Mask of the index of the next task in a task claim.
+constexpr std::uint64_t kNextTaskMask{(std::uint64_t{1} << kTaskCountShift) -
+                                      1u};
+}  // namespace
+
+RenderWorkerPool::RenderWorkerPool(std::size_t workerCount) {
+  workers_.reserve(workerCount);
+  for (std::size_t i = 0; i < workerCount; ++i) {
+    workers_.emplace_back([this] { workerLoop(); });
+  }
+}
+
+RenderWorkerPool::~RenderWorkerPool() {
+  shouldStop_.store(true, std::memory_order_relaxed);
+  generation_.fetch_add(1u, std::memory_order_release);
+  generation_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void RenderWorkerPool::dispatch(std::size_t taskCount, TaskFunction function,
+                                void* context) {
+  if (workers_.empty() || taskCount <= 1u) {
+    for (std::size_t i = 0; i < taskCount; ++i) {
+      function(context, i);
+    }
+    return;
+  }
+
+  // All tasks of the previous dispatch completed, so nobody reads them now.
+  taskFunction_ = function;
+  taskContext_ = context;
+  completedTaskCount_.store(0u, std::memory_order_relaxed);
+
+  // Claims of the previous dispatch are discarded, and workers which claim a
+  // task from now on see the task above.
+  taskClaim_.store(std::uint64_t{taskCount} << kTaskCountShift,
+                   std::memory_order_release);
+
+  generation_.fetch_add(1u, std::memory_order_release);
+  generation_.notify_all();
+
+  runTasks();
+
+  // Tasks claimed by workers may be still running.
+  while (completedTaskCount_.load(std::memory_order_acquire) != taskCount) {
+    std::this_thread::yield();
+  }
+}
+
+void RenderWorkerPool::runTasks() {
+  while (true) {
+    const std::uint64_t claim =
+        taskClaim_.fetch_add(1u, std::memory_order_acq_rel);
+    const std::uint64_t index = claim & kNextTaskMask;
+    if ((claim >> kTaskCountShift) <= index) {
+      return;
+    }
+
+    taskFunction_(taskContext_, static_cast<std::size_t>(index));
+    completedTaskCount_.fetch_add(1u, std::memory_order_release);
+  }
+}
+
+void RenderWorkerPool::workerLoop() {
+  std::uint64_t seenGeneration{};
+
+  while (true) {
+    // Spin for a while to catch the next dispatch quickly, then park.
+    std::uint64_t generation = generation_.load(std::memory_order_acquire);
+    for (int i = 0; generation == seenGeneration && i < kSpinCount; ++i) {
+      std::this_thread::yield();
+      generation = generation_.load(std::memory_order_acquire);
+    }
+    while (generation == seenGeneration) {
+      generation_.wait(seenGeneration, std::memory_order_acquire);
+      generation = generation_.load(std::memory_order_acquire);
+    }
+    seenGeneration = generation;
+
+    if (shouldStop_.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    runTasks();
+  }
+}
+}  // namespace audio
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace audio {
+/**
+ * @brief Pool of pre-spawned threads which run indexed tasks in parallel.
+ * @details Workers spin for a while after finishing tasks, then park on an
+ * atomic until the next dispatch. Dispatch never allocates nor creates a
+ * thread, so it can be used on the audio thread.
+ *
+ * The number of tasks and the index of the next one are packed in an atomic
+ * word which is replaced by each dispatch, so a worker which wakes late claims
+ * only tasks of the current dispatch. Dispatch returns when all tasks have
+ * completed, without waiting for workers which have not woken.
+ * @note @c run() must be called from only one thread at a time.
+ */
+class RenderWorkerPool {
+ public:
+  /**
+   * @brief Constructor. Spawn workers.
+   * @param[in] workerCount The number of worker threads. The caller of
+   * @c run() also runs tasks.
+   */
+  explicit RenderWorkerPool(std::size_t workerCount);
+
+  /**
+   * @brief Destructor. Stop and join workers.
+   */
+  ~RenderWorkerPool();
+
+  RenderWorkerPool(const RenderWorkerPool&) = delete;
+  RenderWorkerPool& operator=(const RenderWorkerPool&) = delete;
+
+  /**
+   * @brief Get the number of worker threads.
+   * @return Worker count.
+   */
+  std::size_t workerCount() const noexcept { return workers_.size(); }
+
+  /**
+   * @brief Call @c task with each index in [0, @c taskCount) in parallel and
+   * wait for all of them.
+   * @tparam F Callable type with an index argument.
+   * @param[in] taskCount The number of tasks.
+   * @param[in] task Task. It must be safe to call concurrently with different
+   * indices.
+   */
+  template <class F>
+  void run(std::size_t taskCount, F& task) {
+    dispatch(taskCount, &invoke<F>, &task);
+  }
+
+ private:
+  /// Type-erased task.
+  using TaskFunction = void (*)(void*, std::size_t);
+
+  /// Worker threads.
+  std::vector<std::thread> workers_;
+
+  /// Task of the current dispatch.
+  TaskFunction taskFunction_{};
+
+  /// Context given to @c taskFunction_.
+  void* taskContext_{};
+
+  /// The number of tasks of the current dispatch in the upper 32 bits, and
+  /// index of the next task to be claimed in the lower 32 bits.
+  std::atomic<std::uint64_t> taskClaim_{};
+
+  /// The number of tasks of the current dispatch which have completed.
+  std::atomic<std::size_t> completedTaskCount_{};
+
+  /// Counter incremented by each dispatch to wake workers.
+  std::atomic<std::uint64_t> generation_{};
+
+  /// Whether workers should exit.
+  std::atomic_bool shouldStop_{};
+
+  /**
+   * @brief Call a task of type @c F.
+   * @param[in] context Pointer to the task.
+   * @param[in] index Task index.
+   */
+  template <class F>
+  static void invoke(void* context, std::size_t index) {
+    (*static_cast<F*>(context))(index);
+  }
+
+  /**
+   * @brief Publish tasks to workers, help them and wait for completion.
+   * @param[in] taskCount The number of tasks.
+   * @param[in] function Type-erased task.
+   * @param[in] context Context given to @c function.
+   */
+  void dispatch(std::size_t taskCount, TaskFunction function, void* context);
+
+  /**
+   * @brief Claim and run tasks until no task is left.
+   */
+  void runTasks();
+
+  /**
+   * @brief Main loop of worker threads.
+   */
+  void workerLoop();
+};
+}  // namespace audio
@@ -0,0 +1,590 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "sample_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPN_SAMPLE_CONVERSION_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define OPN_SAMPLE_CONVERSION_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace audio {
+namespace sample_conversion {
+namespace {
+/// The number of channels in emulator output.
+constexpr std::size_t kInterleavedChannelCount{3};
+
+static_assert(sizeof(ymfm::ym2608::output_data) ==
+                  kInterleavedChannelCount * sizeof(std::int32_t),
+              "Vector kernels assume output_data is packed int32_t[3].");
+
+/// The number of frames processed by a vector iteration.
+constexpr std::size_t kFramesPerVector{4};
+
+/// Cutoff frequency of the DC blocker.
+constexpr double kDcBlockerCutoffHz{5.};
+
+/// Input level where the soft clipper reaches full scale.
+constexpr float kSoftClipKnee{1.5f};
+
+/// Coefficient of the cubic term of the soft clipper.
+constexpr float kSoftClipCubic{4.f / 27.f};
+
+/**
+ * @brief Offset which flushes a denormal value to zero when it is added and
+ * subtracted. It is far below a step of emulator output.
+ */
+constexpr float kDenormalGuard{1e-18f};
+
+/**
+ * @brief Flush a denormal value to zero without branches.
+ * @param[in] value Value.
+ * @return Value, or zero if it is too small.
+ */
+inline float flushDenormal(float value) noexcept {
+  return (value + kDenormalGuard) - kDenormalGuard;
+}
+
+/**
+ * @brief Pass a sample of a channel through the output stage.
+ * @tparam IsDcBlocked Whether DC offset is removed.
+ * @tparam IsSoftClipped Whether the sample is saturated.
+ * @param[in] x Sample.
+ * @param[in] stage Coefficients.
+ * @param[in,out] lastInput The last input of the DC blocker.
+ * @param[in,out] lastOutput The last output of the DC blocker.
+ * @return Processed sample.
+ */
+template <bool IsDcBlocked, bool IsSoftClipped>
+inline float applyStage(float x, const OutputStage& stage, float& lastInput,
+                        float& lastOutput) noexcept {
+  if constexpr (IsDcBlocked) {
+    const float y = x - lastInput + stage.polePowers[0] * lastOutput;
+    lastInput = x;
+    lastOutput = flushDenormal(y);
+    x = lastOutput;
+  }
+
+  x *= stage.gain;
+
+  if constexpr (IsSoftClipped) {
+    const float c = std::clamp(x, -kSoftClipKnee, kSoftClipKnee);
+    x = c * (1.f - kSoftClipCubic * c * c);
+  }
+
+  return x;
+}
+
+/**
+ * @brief Call a function with enabled processes of a stage as constants.
+ * @param[in] stage Coefficients.
+ * @param[in] function Function called with @c std::bool_constant of whether
+ * the DC blocker and the soft clipper are enabled.
+ */
+template <typename Function>
+void dispatchStage(const OutputStage& stage, Function&& function) {
+  if (stage.isDcBlockerEnabled) {
+    if (stage.isSoftClipEnabled) {
+      function(std::true_type{}, std::true_type{});
+    } else {
+      function(std::true_type{}, std::false_type{});
+    }
+  } else {
+    if (stage.isSoftClipEnabled) {
+      function(std::false_type{}, std::true_type{});
+    } else {
+      function(std::false_type{}, std::false_type{});
+    }
+  }
+}
+
+#if defined(OPN_SAMPLE_CONVERSION_SSE2)
+/**
+ * @brief Load 4 frames and convert left and right channels to float.
+ * @param[in] frames Pointer to 4 interleaved frames.
+ * @param[out] left Left channel.
+ * @param[out] right Right channel.
+ */
+inline void loadStereo(const std::int32_t* frames, __m128& left,
+                       __m128& right) noexcept {
+  // v0 = [L0 R0 S0 L1], v1 = [R1 S1 L2 R2], v2 = [S2 L3 R3 S3]
+  const __m128 v0 = _mm_cvtepi32_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(frames)));
+  const __m128 v1 = _mm_cvtepi32_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(frames + 4)));
+  const __m128 v2 = _mm_cvtepi32_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(frames + 8)));
+
+  const __m128 l23 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 1, 2, 2));
+  left = _mm_shuffle_ps(v0, l23, _MM_SHUFFLE(2, 0, 3, 0));
+
+  const __m128 r01 = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0, 0, 1, 1));
+  const __m128 r23 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 2, 3, 3));
+  right = _mm_shuffle_ps(r01, r23, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+ * @brief Accumulate levels of 4 lanes.
+ * @param[in] samples Samples of a channel.
+ * @param[in,out] peak Maximum absolute values of lanes.
+ * @param[in,out] sumOfSquares Sums of squared samples of lanes.
+ */
+inline void accumulateLevel(__m128 samples, __m128& peak,
+                            __m128& sumOfSquares) noexcept {
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  peak = _mm_max_ps(peak, _mm_and_ps(samples, absMask));
+  sumOfSquares = _mm_add_ps(sumOfSquares, _mm_mul_ps(samples, samples));
+}
+
+/**
+ * @brief Move lanes to later time and fill the first lanes with zeros.
+ * @tparam Count The number of lanes to move.
+ * @param[in] v Vector.
+ * @return Moved vector.
+ */
+template <int Count>
+inline __m128 shiftLanes(__m128 v) noexcept {
+  return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4 * Count));
+}
+
+/**
+ * @brief Coefficients of the output stage in vectors.
+ */
+struct StageVectors {
+  __m128 gain;
+  __m128 pole;
+  __m128 pole2;
+  __m128 polePowers;
+  __m128 knee;
+  __m128 cubic;
+  __m128 one;
+  __m128 guard;
+
+  explicit StageVectors(const OutputStage& stage) noexcept
+      : gain(_mm_set1_ps(stage.gain)),
+        pole(_mm_set1_ps(stage.polePowers[0])),
+        pole2(_mm_set1_ps(stage.polePowers[1])),
+        polePowers(_mm_loadu_ps(stage.polePowers)),
+        knee(_mm_set1_ps(kSoftClipKnee)),
+        cubic(_mm_set1_ps(kSoftClipCubic)),
+        one(_mm_set1_ps(1.f)),
+        guard(_mm_set1_ps(kDenormalGuard)) {}
+};
+
+/**
+ * @brief Pass 4 samples of a channel through the output stage.
+ * @details The recursion of the DC blocker, y[k] = d[k] + p y[k - 1] where
+ * d[k] = x[k] - x[k - 1], is solved by a prefix scan across lanes.
+ * @tparam IsDcBlocked Whether DC offset is removed.
+ * @tparam IsSoftClipped Whether samples are saturated.
+ * @param[in] x Samples in order of time.
+ * @param[in] v Coefficients.
+ * @param[in,out] lastInput The last input of the DC blocker in all lanes.
+ * @param[in,out] lastOutput The last output of the DC blocker in all lanes.
+ * @return Processed samples.
+ */
+template <bool IsDcBlocked, bool IsSoftClipped>
+inline __m128 applyStage(__m128 x, const StageVectors& v, __m128& lastInput,
+                         __m128& lastOutput) noexcept {
+  if constexpr (IsDcBlocked) {
+    const __m128 previous = _mm_move_ss(
+        _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 1, 0, 0)), lastInput);
+    const __m128 d = _mm_sub_ps(x, previous);
+    __m128 y = _mm_add_ps(d, _mm_mul_ps(v.pole, shiftLanes<1>(d)));
+    y = _mm_add_ps(y, _mm_mul_ps(v.pole2, shiftLanes<2>(y)));
+    y = _mm_add_ps(y, _mm_mul_ps(v.polePowers, lastOutput));
+
+    lastInput = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+    lastOutput = _mm_sub_ps(
+        _mm_add_ps(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)), v.guard),
+        v.guard);
+    x = y;
+  }
+
+  x = _mm_mul_ps(x, v.gain);
+
+  if constexpr (IsSoftClipped) {
+    const __m128 c = _mm_min_ps(
+        _mm_max_ps(x, _mm_sub_ps(_mm_setzero_ps(), v.knee)), v.knee);
+    x = _mm_mul_ps(c,
+                   _mm_sub_ps(v.one, _mm_mul_ps(v.cubic, _mm_mul_ps(c, c))));
+  }
+
+  return x;
+}
+#elif defined(OPN_SAMPLE_CONVERSION_NEON)
+/**
+ * @brief Coefficients of the output stage in vectors.
+ */
+struct StageVectors {
+  float32x4_t polePowers;
+  float gain;
+  float pole;
+  float pole2;
+
+  explicit StageVectors(const OutputStage& stage) noexcept
+      : polePowers(vld1q_f32(stage.polePowers)),
+        gain(stage.gain),
+        pole(stage.polePowers[0]),
+        pole2(stage.polePowers[1]) {}
+};
+
+/**
+ * @brief Pass 4 samples of a channel through the output stage.
+ * @details The recursion of the DC blocker, y[k] = d[k] + p y[k - 1] where
+ * d[k] = x[k] - x[k - 1], is solved by a prefix scan across lanes.
+ * @tparam IsDcBlocked Whether DC offset is removed.
+ * @tparam IsSoftClipped Whether samples are saturated.
+ * @param[in] x Samples in order of time.
+ * @param[in] v Coefficients.
+ * @param[in,out] lastInput The last input of the DC blocker in all lanes.
+ * @param[in,out] lastOutput The last output of the DC blocker in all lanes.
+ * @return Processed samples.
+ */
+template <bool IsDcBlocked, bool IsSoftClipped>
+inline float32x4_t applyStage(float32x4_t x, const StageVectors& v,
+                              float32x4_t& lastInput,
+                              float32x4_t& lastOutput) noexcept {
+  if constexpr (IsDcBlocked) {
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    const float32x4_t d = vsubq_f32(x, vextq_f32(lastInput, x, 3));
+    float32x4_t y = vmlaq_n_f32(d, vextq_f32(zero, d, 3), v.pole);
+    y = vmlaq_n_f32(y, vextq_f32(zero, y, 2), v.pole2);
+    y = vmlaq_f32(y, v.polePowers, lastOutput);
+
+    lastInput = vdupq_n_f32(vgetq_lane_f32(x, 3));
+    lastOutput = vdupq_n_f32(flushDenormal(vgetq_lane_f32(y, 3)));
+    x = y;
+  }
+
+  x = vmulq_n_f32(x, v.gain);
+
+  if constexpr (IsSoftClipped) {
+    const float32x4_t c = vminq_f32(
+        vmaxq_f32(x, vdupq_n_f32(-kSoftClipKnee)), vdupq_n_f32(kSoftClipKnee));
+    x = vmulq_f32(
+        c, vmlsq_n_f32(vdupq_n_f32(1.f), vmulq_f32(c, c), kSoftClipCubic));
+  }
+
+  return x;
+}
+#endif
+
+/// Lanes of levels of left and right channels accumulated by vector kernels.
+struct LevelLanes {
+  float peak[2][kFramesPerVector]{};
+  float sumOfSquares[2][kFramesPerVector]{};
+
+  /**
+   * @brief Reduce lanes into levels.
+   * @param[in,out] level Levels.
+   */
+  void reduceInto(StereoLevel& level) const noexcept {
+    for (std::size_t ch = 0; ch < 2; ++ch) {
+      for (std::size_t i = 0; i < kFramesPerVector; ++i) {
+        level.peak[ch] = std::max(level.peak[ch], peak[ch][i]);
+        level.sumOfSquares[ch] += sumOfSquares[ch][i];
+      }
+    }
+  }
+};
+
+/**
+ * @brief Accumulate levels of a frame.
+ * @param[in] left Sample of left channel.
+ * @param[in] right Sample of right channel.
+ * @param[in,out] level Levels.
+ */
+inline void accumulateLevel(float left, float right,
+                            StereoLevel& level) noexcept {
+  level.peak[0] = std::max(level.peak[0], std::abs(left));
+  level.peak[1] = std::max(level.peak[1], std::abs(right));
+  level.sumOfSquares[0] += left * left;
+  level.sumOfSquares[1] += right * right;
+}
+
+/**
+ * @brief Deinterleave emulator output.
+ * @tparam IsMetered Whether levels are measured.
+ */
+template <bool IsMetered>
+void deinterleaveFrames(const ymfm::ym2608::output_data* input,
+                        std::size_t numSamples, float* left, float* right,
+                        float gain, StereoLevel* level) noexcept {
+  std::size_t n = 0;
+  [[maybe_unused]] LevelLanes lanes;
+
+#if defined(OPN_SAMPLE_CONVERSION_SSE2)
+  const __m128 g = _mm_set1_ps(gain);
+  [[maybe_unused]] __m128 peakL = _mm_setzero_ps(), peakR = _mm_setzero_ps(),
+                          sumL = _mm_setzero_ps(), sumR = _mm_setzero_ps();
+  for (; n + kFramesPerVector <= numSamples; n += kFramesPerVector) {
+    __m128 l, r;
+    loadStereo(input[n].data, l, r);
+    _mm_storeu_ps(left + n, _mm_mul_ps(l, g));
+    _mm_storeu_ps(right + n, _mm_mul_ps(r, g));
+    if constexpr (IsMetered) {
+      accumulateLevel(l, peakL, sumL);
+      accumulateLevel(r, peakR, sumR);
+    }
+  }
+  if constexpr (IsMetered) {
+    _mm_storeu_ps(lanes.peak[0], peakL);
+    _mm_storeu_ps(lanes.peak[1], peakR);
+    _mm_storeu_ps(lanes.sumOfSquares[0], sumL);
+    _mm_storeu_ps(lanes.sumOfSquares[1], sumR);
+  }
+#elif defined(OPN_SAMPLE_CONVERSION_NEON)
+  [[maybe_unused]] float32x4_t peakL = vdupq_n_f32(0.f),
+                               peakR = vdupq_n_f32(0.f),
+                               sumL = vdupq_n_f32(0.f),
+                               sumR = vdupq_n_f32(0.f);
+  for (; n + kFramesPerVector <= numSamples; n += kFramesPerVector) {
+    const int32x4x3_t v = vld3q_s32(input[n].data);
+    const float32x4_t l = vcvtq_f32_s32(v.val[0]);
+    const float32x4_t r = vcvtq_f32_s32(v.val[1]);
+    vst1q_f32(left + n, vmulq_n_f32(l, gain));
+    vst1q_f32(right + n, vmulq_n_f32(r, gain));
+    if constexpr (IsMetered) {
+      peakL = vmaxq_f32(peakL, vabsq_f32(l));
+      peakR = vmaxq_f32(peakR, vabsq_f32(r));
+      sumL = vmlaq_f32(sumL, l, l);
+      sumR = vmlaq_f32(sumR, r, r);
+    }
+  }
+  if constexpr (IsMetered) {
+    vst1q_f32(lanes.peak[0], peakL);
+    vst1q_f32(lanes.peak[1], peakR);
+    vst1q_f32(lanes.sumOfSquares[0], sumL);
+    vst1q_f32(lanes.sumOfSquares[1], sumR);
+  }
+#endif
+
+  for (; n < numSamples; ++n) {
+    const auto l = static_cast<float>(input[n].data[0]);
+    const auto r = static_cast<float>(input[n].data[1]);
+    left[n] = l * gain;
+    right[n] = r * gain;
+    if constexpr (IsMetered) {
+      accumulateLevel(l, r, *level);
+    }
+  }
+
+  if constexpr (IsMetered) {
+    lanes.reduceInto(*level);
+  }
+}
+
+/**
+ * @brief Mix down emulator output.
+ * @tparam IsMetered Whether levels are measured.
+ */
+template <bool IsMetered>
+void mixDownFrames(const ymfm::ym2608::output_data* input,
+                   std::size_t numSamples, float* mono, float gain,
+                   StereoLevel* level) noexcept {
+  std::size_t n = 0;
+  [[maybe_unused]] LevelLanes lanes;
+
+#if defined(OPN_SAMPLE_CONVERSION_SSE2)
+  const __m128 g = _mm_set1_ps(gain);
+  [[maybe_unused]] __m128 peakL = _mm_setzero_ps(), peakR = _mm_setzero_ps(),
+                          sumL = _mm_setzero_ps(), sumR = _mm_setzero_ps();
+  for (; n + kFramesPerVector <= numSamples; n += kFramesPerVector) {
+    __m128 l, r;
+    loadStereo(input[n].data, l, r);
+    _mm_storeu_ps(mono + n, _mm_mul_ps(_mm_add_ps(l, r), g));
+    if constexpr (IsMetered) {
+      accumulateLevel(l, peakL, sumL);
+      accumulateLevel(r, peakR, sumR);
+    }
+  }
+  if constexpr (IsMetered) {
+    _mm_storeu_ps(lanes.peak[0], peakL);
+    _mm_storeu_ps(lanes.peak[1], peakR);
+    _mm_storeu_ps(lanes.sumOfSquares[0], sumL);
+    _mm_storeu_ps(lanes.sumOfSquares[1], sumR);
+  }
+#elif defined(OPN_SAMPLE_CONVERSION_NEON)
+  [[maybe_unused]] float32x4_t peakL = vdupq_n_f32(0.f),
+                               peakR = vdupq_n_f32(0.f),
+                               sumL = vdupq_n_f32(0.f),
+                               sumR = vdupq_n_f32(0.f);
+  for (; n + kFramesPerVector <= numSamples; n += kFramesPerVector) {
+    const int32x4x3_t v = vld3q_s32(input[n].data);
+    const float32x4_t l = vcvtq_f32_s32(v.val[0]);
+    const float32x4_t r = vcvtq_f32_s32(v.val[1]);
+    vst1q_f32(mono + n, vmulq_n_f32(vaddq_f32(l, r), gain));
+    if constexpr (IsMetered) {
+      peakL = vmaxq_f32(peakL, vabsq_f32(l));
+      peakR = vmaxq_f32(peakR, vabsq_f32(r));
+      sumL = vmlaq_f32(sumL, l, l);
+      sumR = vmlaq_f32(sumR, r, r);
+    }
+  }
+  if constexpr (IsMetered) {
+    vst1q_f32(lanes.peak[0], peakL);
+    vst1q_f32(lanes.peak[1], peakR);
+    vst1q_f32(lanes.sumOfSquares[0], sumL);
+    vst1q_f32(lanes.sumOfSquares[1], sumR);
+  }
+#endif
+
+  for (; n < numSamples; ++n) {
+    const auto l = static_cast<float>(input[n].data[0]);
+    const auto r = static_cast<float>(input[n].data[1]);
+    mono[n] = (l + r) * gain;
+    if constexpr (IsMetered) {
+      accumulateLevel(l, r, *level);
+    }
+  }
+
+  if constexpr (IsMetered) {
+    lanes.reduceInto(*level);
+  }
+}
+
+/**
+ * @brief Deinterleave emulator output through the output stage.
+ * @tparam IsDcBlocked Whether DC offset is removed.
+ * @tparam IsSoftClipped Whether samples are saturated.
+ */
+template <bool IsDcBlocked, bool IsSoftClipped>
+void deinterleaveThroughStage(const ymfm::ym2608::output_data* input,
+                              std::size_t numSamples, float* left,
+                              float* right, const OutputStage& stage,
+                              OutputStageState& state,
+                              StereoLevel& level) noexcept {
+  std::size_t n = 0;
+  LevelLanes lanes;
+
+#if defined(OPN_SAMPLE_CONVERSION_SSE2)
+  const StageVectors v(stage);
+  __m128 lastInputL = _mm_set1_ps(state.input[0]),
+         lastInputR = _mm_set1_ps(state.input[1]),
+         lastOutputL = _mm_set1_ps(state.output[0]),
+         lastOutputR = _mm_set1_ps(state.output[1]);
+  __m128 peakL = _mm_setzero_ps(), peakR = _mm_setzero_ps(),
+         sumL = _mm_setzero_ps(), sumR = _mm_setzero_ps();
+  for (; n + kFramesPerVector <= numSamples; n += kFramesPerVector) {
+    __m128 l, r;
+    loadStereo(input[n].data, l, r);
+    _mm_storeu_ps(left + n, applyStage<IsDcBlocked, IsSoftClipped>(
+                                l, v, lastInputL, lastOutputL));
+    _mm_storeu_ps(right + n, applyStage<IsDcBlocked, IsSoftClipped>(
+                                 r, v, lastInputR, lastOutputR));
+    accumulateLevel(l, peakL, sumL);
+    accumulateLevel(r, peakR, sumR);
+  }
+  _mm_storeu_ps(lanes.peak[0], peakL);
+  _mm_storeu_ps(lanes.peak[1], peakR);
+  _mm_storeu_ps(lanes.sumOfSquares[0], sumL);
+  _mm_storeu_ps(lanes.sumOfSquares[1], sumR);
+  state.input[0] = _mm_cvtss_f32(lastInputL);
+  state.input[1] = _mm_cvtss_f32(lastInputR);
+  state.output[0] = _mm_cvtss_f32(lastOutputL);
+  state.output[1] = _mm_cvtss_f32(lastOutputR);
+#elif defined(OPN_SAMPLE_CONVERSION_NEON)
+  const StageVectors v(stage);
+  float32x4_t lastInputL = vdupq_n_f32(state.input[0]),
+              lastInputR = vdupq_n_f32(state.input[1]),
+              lastOutputL = vdupq_n_f32(state.output[0]),
+              lastOutputR = vdupq_n_f32(state.output[1]);
+  float32x4_t peakL = vdupq_n_f32(0.f), peakR = vdupq_n_f32(0.f),
+              sumL = vdupq_n_f32(0.f), sumR = vdupq_n_f32(0.f);
+  for (; n + kFramesPerVector <= numSamples; n += kFramesPerVector) {
+    const int32x4x3_t frames = vld3q_s32(input[n].data);
+    const float32x4_t l = vcvtq_f32_s32(frames.val[0]);
+    const float32x4_t r = vcvtq_f32_s32(frames.val[1]);
+    vst1q_f32(left + n, applyStage<IsDcBlocked, IsSoftClipped>(
+                            l, v, lastInputL, lastOutputL));
+    vst1q_f32(right + n, applyStage<IsDcBlocked, IsSoftClipped>(
+                             r, v, lastInputR, lastOutputR));
+    peakL = vmaxq_f32(peakL, vabsq_f32(l));
+    peakR = vmaxq_f32(peakR, vabsq_f32(r));
+    sumL = vmlaq_f32(sumL, l, l);
+    sumR = vmlaq_f32(sumR, r, r);
+  }
+  vst1q_f32(lanes.peak[0], peakL);
+  vst1q_f32(lanes.peak[1], peakR);
+  vst1q_f32(lanes.sumOfSquares[0], sumL);
+  vst1q_f32(lanes.sumOfSquares[1], sumR);
+  state.input[0] = vgetq_lane_f32(lastInputL, 0);
+  state.input[1] = vgetq_lane_f32(lastInputR, 0);
+  state.output[0] = vgetq_lane_f32(lastOutputL, 0);
+  state.output[1] = vgetq_lane_f32(lastOutputR, 0);
+#endif
+
+  for (; n < numSamples; ++n) {
+    const auto l = static_cast<float>(input[n].data[0]);
+    const auto r = static_cast<float>(input[n].data[1]);
+    left[n] = applyStage<IsDcBlocked, IsSoftClipped>(
+        l, stage, state.input[0], state.output[0]);
+    right[n] = applyStage<IsDcBlocked, IsSoftClipped>(
+        r, stage, state.input[1], state.output[1]);
+    accumulateLevel(l, r, level);
+  }
+
+  lanes.reduceInto(level);
+}
+
+}  // namespace
+
+OutputStage::OutputStage(const OutputStageSettings& settings, float scale,
+                         double sampleRate) noexcept
+    : gain(scale * std::pow(10.f, settings.gainDecibels / 20.f)),
+      isDcBlockerEnabled(settings.isDcBlockerEnabled),
+      isSoftClipEnabled(settings.isSoftClipEnabled) {
+  const auto pole = static_cast<float>(
+      std::exp(-2. * std::numbers::pi * kDcBlockerCutoffHz / sampleRate));
+  float power{1.f};
+  for (auto& polePower : polePowers) {
+    power *= pole;
+    polePower = power;
+  }
+}
+
+void deinterleave(const ymfm::ym2608::output_data* input,
+                  std::size_t numSamples, float* left, float* right,
+                  float gain) noexcept {
+  deinterleaveFrames<false>(input, numSamples, left, right, gain, nullptr);
+}
+
+void deinterleave(const ymfm::ym2608::output_data* input,
+                  std::size_t numSamples, float* left, float* right,
+                  float gain, StereoLevel& level) noexcept {
+  deinterleaveFrames<true>(input, numSamples, left, right, gain, &level);
+}
+
+void deinterleave(const ymfm::ym2608::output_data* input,
+                  std::size_t numSamples, float* left, float* right,
+                  const OutputStage& stage, OutputStageState& state,
+                  StereoLevel& level) noexcept {
+  dispatchStage(stage, [&](auto isDcBlocked, auto isSoftClipped) {
+    deinterleaveThroughStage<decltype(isDcBlocked)::value,
+                             decltype(isSoftClipped)::value>(
+        input, numSamples, left, right, stage, state, level);
+  });
+}
+
+void mixDown(const ymfm::ym2608::output_data* input, std::size_t numSamples,
+             float* mono, float gain) noexcept {
+  mixDownFrames<false>(input, numSamples, mono, gain, nullptr);
+}
+
+void mixDown(const ymfm::ym2608::output_data* input, std::size_t numSamples,
+             float* mono, float gain, StereoLevel& level) noexcept {
+  mixDownFrames<true>(input, numSamples, mono, gain, &level);
+}
+}  // namespace sample_conversion
+}  // namespace audio
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <ymfm_opn.h>
+
+#include <cstddef>
+
+namespace audio {
+namespace sample_conversion {
+/**
+ * @brief Levels of emulator output measured while converting samples.
+ * @details Values are in the scale of emulator output regardless of gain.
+ * They are accumulated, so the caller clears them at the start of a window.
+ */
+struct StereoLevel {
+  float peak[2]{};          ///< Maximum absolute value of left and right.
+  float sumOfSquares[2]{};  ///< Sum of squared samples of left and right.
+};
+
+/**
+ * @brief Settings of the output stage applied while converting samples.
+ */
+struct OutputStageSettings {
+  bool isDcBlockerEnabled{};  ///< Whether DC offset is removed.
+  float gainDecibels{};       ///< Master gain in decibels.
+  bool isSoftClipEnabled{};   ///< Whether output is saturated smoothly.
+
+  /**
+   * @brief Whether the stage changes output.
+   * @return @c true if any process is enabled.
+   */
+  bool isActive() const noexcept {
+    return isDcBlockerEnabled || gainDecibels != 0.f || isSoftClipEnabled;
+  }
+
+  bool operator==(const OutputStageSettings&) const = default;
+};
+
+/**
+ * @brief Coefficients of the output stage, which are calculated only when
+ * settings or the sample rate change.
+ * @details Samples pass a one-pole DC blocker, gain and a soft clipper in this
+ * order. The soft clipper is a cubic curve which keeps unity slope around
+ * zero and reaches full scale smoothly at 1.5 times of it.
+ */
+struct OutputStage {
+  /// Gain which converts emulator output to full scale of 1.
+  float gain{};
+
+  /// Powers of the pole of the DC blocker from the first to the fourth.
+  float polePowers[4]{};
+
+  bool isDcBlockerEnabled{};  ///< Whether DC offset is removed.
+  bool isSoftClipEnabled{};   ///< Whether output is saturated smoothly.
+
+  /**
+   * @brief Constructor which makes no stage.
+   */
+  OutputStage() = default;
+
+  /**
+   * @brief Constructor.
+   * @param[in] settings Settings.
+   * @param[in] scale Gain which converts emulator output to full scale of 1
+   * without master gain.
+   * @param[in] sampleRate Sample rate of emulator output.
+   */
+  OutputStage(const OutputStageSettings& settings, float scale,
+              double sampleRate) noexcept;
+};
+
+/**
+ * @brief State of DC blockers carried over blocks.
+ */
+struct OutputStageState {
+  float input[2]{};   ///< The last input of left and right.
+  float output[2]{};  ///< The last output of left and right.
+};
+
+/**
+ * @brief Deinterleave left and right channels of emulator output into float
+ * buffers with scaling.
+ * @param[in] input Emulator output.
+ * @param[in] numSamples The number of samples.
+ * @param[out] left Buffer of left channel.
+ * @param[out] right Buffer of right channel.
+ * @param[in] gain Gain multiplied to each sample.
+ */
+void deinterleave(const ymfm::ym2608::output_data* input,
+                  std::size_t numSamples, float* left, float* right,
+                  float gain) noexcept;
+
+/**
+ * @brief Deinterleave left and right channels of emulator output into float
+ * buffers with scaling, and measure their levels in the same pass.
+ * @param[in] input Emulator output.
+ * @param[in] numSamples The number of samples.
+ * @param[out] left Buffer of left channel.
+ * @param[out] right Buffer of right channel.
+ * @param[in] gain Gain multiplied to each sample.
+ * @param[in,out] level Levels accumulated with the samples.
+ */
+void deinterleave(const ymfm::ym2608::output_data* input,
+                  std::size_t numSamples, float* left, float* right,
+                  float gain, StereoLevel& level) noexcept;
+
+/**
+ * @brief Deinterleave left and right channels of emulator output into float
+ * buffers through the output stage, and measure their levels in the same pass.
+ * @param[in] input Emulator output.
+ * @param[in] numSamples The number of samples.
+ * @param[out] left Buffer of left channel.
+ * @param[out] right Buffer of right channel.
+ * @param[in] stage Coefficients of the output stage.
+ * @param[in,out] state State of DC blockers.
+ * @param[in,out] level Levels accumulated with the samples before the stage.
+ */
+void deinterleave(const ymfm::ym2608::output_data* input,
+                  std::size_t numSamples, float* left, float* right,
+                  const OutputStage& stage, OutputStageState& state,
+                  StereoLevel& level) noexcept;
+
+/**
+ * @brief Mix left and right channels of emulator output into a float buffer
+ * with scaling.
+ * @param[in] input Emulator output.
+ * @param[in] numSamples The number of samples.
+ * @param[out] mono Buffer of mixed samples.
+ * @param[in] gain Gain multiplied to the sum of both channels.
+ */
+void mixDown(const ymfm::ym2608::output_data* input, std::size_t numSamples,
+             float* mono, float gain) noexcept;
+
+/**
+ * @brief Mix left and right channels of emulator output into a float buffer
+ * with scaling, and measure levels of both channels in the same pass.
+ * @param[in] input Emulator output.
+ * @param[in] numSamples The number of samples.
+ * @param[out] mono Buffer of mixed samples.
+ * @param[in] gain Gain multiplied to the sum of both channels.
+ * @param[in,out] level Levels accumulated with the samples before mixing.
+ */
+void mixDown(const ymfm::ym2608::output_data* input, std::size_t numSamples,
+             float* mono, float gain, StereoLevel& level) noexcept;
+}  // namespace sample_conversion
+}  // namespace audio
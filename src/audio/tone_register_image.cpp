@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "tone_register_image.h"
+
+namespace audio {
+static_assert(kChipRegisterLayouts.size() == 1u,
+              "ToneRegisterImage holds only LFO register as chip register.");
+
+ToneRegisterImage::ToneRegisterImage(const FmParameters& parameters) noexcept
+    : lfoData_(kChipRegisterLayouts[0].dataOf(parameters)), noteOnMask_() {
+  for (std::size_t i = 0; i < kChannelRegisterLayouts.size(); ++i) {
+    channelData_[channelToneRegisterIndexOf(i)] =
+        kChannelRegisterLayouts[i].dataOf(parameters);
+  }
+
+  for (std::size_t n = 0; n < kSlotCount; ++n) {
+    const auto& op = parameters.slot[n];
+    for (std::size_t i = 0; i < kOperatorRegisterLayouts.size(); ++i) {
+      channelData_[operatorToneRegisterIndexOf(n, i)] =
+          kOperatorRegisterLayouts[i].dataOf(op);
+    }
+
+    noteOnMask_ |= static_cast<std::uint8_t>(op.isEnabled.rawValue())
+                   << (n + 4u);
+  }
+}
+}  // namespace audio
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "./parameter/parameter.h"
+#include "tone_register_layout.h"
+
+namespace audio {
+/**
+ * @brief Register data of tone parameters.
+ * @details It is computed from @c FmParameters in advance, so a patch can be
+ * written without converting parameters.
+ */
+class ToneRegisterImage {
+ public:
+  /// Data of tone registers of a channel. Addresses of the registers are in
+  /// @c kToneRegisterAddresses at the same index.
+  using ChannelData = std::array<std::uint8_t, kChannelToneRegisterCount>;
+
+  /**
+   * @brief Constructor.
+   * @param[in] parameters Tone parameters.
+   */
+  explicit ToneRegisterImage(
+      const FmParameters& parameters = defaultFmParameters) noexcept;
+
+  /**
+   * @brief Get data of tone registers of a channel.
+   * @return Data which is the same in all channels.
+   */
+  const ChannelData& channelData() const noexcept { return channelData_; }
+
+  /**
+   * @brief Get data of LFO register ($22).
+   * @return Data.
+   */
+  std::uint8_t lfoData() const noexcept { return lfoData_; }
+
+  /**
+   * @brief Get operator mask of note-on in the high nibble of $28.
+   * @return Mask of enabled operators.
+   */
+  std::uint8_t noteOnMask() const noexcept { return noteOnMask_; }
+
+ private:
+  ChannelData channelData_;
+  std::uint8_t lfoData_;
+  std::uint8_t noteOnMask_;
+};
+}  // namespace audio
@@ -0,0 +1,405 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+
+#include "./parameter/parameter.h"
+
+namespace audio {
+/// The number of FM channels of a chip.
+inline constexpr std::size_t kFmChannelCount{6};
+
+/**
+ * @brief Calculate address added channel offset.
+ * @param[in] channel Number of channel.
+ * @param[in] baseAddress Address where @c channel is 0.
+ * @return Address added offset, or @c baseAddress if @c channel is invalid
+ * value.
+ */
+constexpr std::uint16_t addressOfChannel(std::size_t channel,
+                                         std::uint16_t baseAddress) noexcept {
+  constexpr std::uint16_t kOffset[kFmChannelCount]{0x0u,   0x1u,   0x2u,
+                                                   0x100u, 0x101u, 0x102u};
+  return (channel < kFmChannelCount) ? (baseAddress + kOffset[channel])
+                                     : baseAddress;
+}
+
+/**
+ * @brief Calculate address added operator offset.
+ * @param[in] slot Operator (slot) number.
+ * @param[in] baseAddress Address where @c slot is 0.
+ * @return Address added offset, or @c baseAddress if @c slot is invalid.
+ */
+constexpr std::uint16_t addressOfOperator(std::size_t slot,
+                                          std::uint16_t baseAddress) noexcept {
+  constexpr std::uint16_t kOffset[]{0u, 8u, 4u, 12u};
+  return (slot < std::size(kOffset)) ? (baseAddress + kOffset[slot])
+                                     : baseAddress;
+}
+
+/**
+ * @brief Convert detune value from signed to unsigned.
+ * @param[in] value Signed detune value.
+ * @return Unsigned detune value.
+ */
+inline std::uint8_t convertDetuneAsRegisterValue(
+    const parameter::DetuneValue& value) {
+  return (value.rawValue() < 0 ? 4u : 0u) |
+         static_cast<std::uint8_t>(std::abs(value.rawValue()));
+}
+
+/// Mask of panning set at $b4-$b6. This means "we set panning to center."
+inline constexpr std::uint8_t kPanningMask{0xf0u};
+
+/// Unit which a tone register belongs to.
+enum class ToneRegisterScope {
+  Operator,  ///< Register of an operator in each channel.
+  Channel,   ///< Register of each channel.
+  Chip,      ///< Register shared by all channels.
+};
+
+/**
+ * @brief Layout of a tone register.
+ * @tparam Parameters Parameters which data is made from.
+ */
+template <class Parameters>
+struct ToneRegisterLayout {
+  /// Address of channel 0 and slot 0.
+  std::uint16_t address;
+
+  /// Function to make data from parameters.
+  std::uint8_t (*dataOf)(const Parameters&);
+};
+
+/// Layouts of registers of an operator.
+inline constexpr std::array<ToneRegisterLayout<FmParameters::Operator>, 7>
+    kOperatorRegisterLayouts{{
+        {0x30u,
+         [](const FmParameters::Operator& op) -> std::uint8_t {
+           return (convertDetuneAsRegisterValue(op.dt) << 4) |
+                  op.ml.rawValue();
+         }},
+        {0x40u,
+         [](const FmParameters::Operator& op) -> std::uint8_t {
+           return op.tl.rawValue();
+         }},
+        {0x50u,
+         [](const FmParameters::Operator& op) -> std::uint8_t {
+           const std::uint8_t rawAr = op.ssgeg.isEnabled
+                                          ? parameter::AttackRateValue::kMaximum
+                                          : op.ar.rawValue();
+           return (op.ks.rawValue() << 6) | rawAr;
+         }},
+        {0x60u,
+         [](const FmParameters::Operator& op) -> std::uint8_t {
+           return (static_cast<std::uint8_t>(op.am.rawValue()) << 7) |
+                  op.dr.rawValue();
+         }},
+        {0x70u,
+         [](const FmParameters::Operator& op) -> std::uint8_t {
+           return op.sr.rawValue();
+         }},
+        {0x80u,
+         [](const FmParameters::Operator& op) -> std::uint8_t {
+           return (op.sl.rawValue() << 4) | op.rr.rawValue();
+         }},
+        {0x90u,
+         [](const FmParameters::Operator& op) -> std::uint8_t {
+           return op.ssgeg.isEnabled ? op.ssgeg.shape.rawValue() : 0u;
+         }},
+    }};
+
+/// Layouts of registers of a channel.
+inline constexpr std::array<ToneRegisterLayout<FmParameters>, 2>
+    kChannelRegisterLayouts{{
+        {0xb0u,
+         [](const FmParameters& parameters) -> std::uint8_t {
+           return (parameters.fb.rawValue() << 3) | parameters.al.rawValue();
+         }},
+        {0xb4u,
+         [](const FmParameters& parameters) -> std::uint8_t {
+           return kPanningMask | (parameters.lfo.ams.rawValue() << 4) |
+                  parameters.lfo.pms.rawValue();
+         }},
+    }};
+
+/// Layouts of registers shared by all channels.
+inline constexpr std::array<ToneRegisterLayout<FmParameters>, 1>
+    kChipRegisterLayouts{{
+        {0x22u,
+         [](const FmParameters& parameters) -> std::uint8_t {
+           return (parameters.lfo.isEnabled ? 8u : 0u) |
+                  parameters.lfo.frequency.rawValue();
+         }},
+    }};
+
+/// The number of tone registers of a channel.
+inline constexpr std::size_t kChannelToneRegisterCount{
+    kChannelRegisterLayouts.size() +
+    kOperatorRegisterLayouts.size() * kSlotCount};
+
+/**
+ * @brief Get index of a channel register in tone registers of a channel.
+ * @details Channel registers come first, and operator registers follow in
+ * the order of slots.
+ * @param[in] layoutIndex Index in @c kChannelRegisterLayouts.
+ * @return Index of the register.
+ */
+constexpr std::size_t channelToneRegisterIndexOf(
+    std::size_t layoutIndex) noexcept {
+  return layoutIndex;
+}
+
+/**
+ * @brief Get index of an operator register in tone registers of a channel.
+ * @param[in] slot Slot number.
+ * @param[in] layoutIndex Index in @c kOperatorRegisterLayouts.
+ * @return Index of the register.
+ */
+constexpr std::size_t operatorToneRegisterIndexOf(
+    std::size_t slot, std::size_t layoutIndex) noexcept {
+  return kChannelRegisterLayouts.size() +
+         slot * kOperatorRegisterLayouts.size() + layoutIndex;
+}
+
+/// Addresses of a register in all channels. The index is channel number.
+using ChannelAddresses = std::array<std::uint16_t, kFmChannelCount>;
+
+/**
+ * @brief Addresses of tone registers generated at compile time.
+ * @details The first index is given by @c channelToneRegisterIndexOf() or
+ * @c operatorToneRegisterIndexOf(), and the second is channel number.
+ * Channel is innermost so that writing a register to all channels reads a
+ * contiguous row.
+ */
+inline constexpr auto kToneRegisterAddresses = [] {
+  std::array<ChannelAddresses, kChannelToneRegisterCount> table{};
+  for (std::size_t i = 0; i < kChannelRegisterLayouts.size(); ++i) {
+    for (std::size_t channel = 0; channel < kFmChannelCount; ++channel) {
+      table[channelToneRegisterIndexOf(i)][channel] =
+          addressOfChannel(channel, kChannelRegisterLayouts[i].address);
+    }
+  }
+
+  for (std::size_t slot = 0; slot < kSlotCount; ++slot) {
+    for (std::size_t i = 0; i < kOperatorRegisterLayouts.size(); ++i) {
+      const std::uint16_t address =
+          addressOfOperator(slot, kOperatorRegisterLayouts[i].address);
+      for (std::size_t channel = 0; channel < kFmChannelCount; ++channel) {
+        table[operatorToneRegisterIndexOf(slot, i)][channel] =
+            addressOfChannel(channel, address);
+      }
+    }
+  }
+  return table;
+}();
+
+/**
+ * @brief Get a bit of a layout which has the address.
+ * @param[in] layouts Layouts.
+ * @param[in] address Address of the register.
+ * @return Bit whose position is the index of the layout.
+ */
+template <class Layouts>
+consteval std::uint32_t layoutBitOf(const Layouts& layouts,
+                                    std::uint16_t address) {
+  for (std::size_t i = 0; i < layouts.size(); ++i) {
+    if (layouts[i].address == address) {
+      return std::uint32_t{1} << i;
+    }
+  }
+  throw "No layout has the address.";
+}
+
+/**
+ * @brief Mapping from a parameter to tone registers.
+ * @details Each specialization has:
+ * - @c kScope: Scope of registers.
+ * - @c field(): Function returning a reference to the field in
+ *   @c FmParameters::Operator for operator scope, in @c FmParameters
+ *   otherwise.
+ * - @c kLayoutMask: Bits of the layouts of the scope whose data depend on the
+ *   field.
+ * @tparam T Parameter value type.
+ */
+template <class T>
+struct ToneParameterMapping;
+
+/// Parameter which is written to tone registers through its mapping.
+template <class T>
+concept MappedToneParameter = requires {
+  {
+    ToneParameterMapping<T>::kScope
+  } -> std::convertible_to<ToneRegisterScope>;
+  {
+    ToneParameterMapping<T>::kLayoutMask
+  } -> std::convertible_to<std::uint32_t>;
+};
+
+/**
+ * @brief Base of mappings to registers of an operator.
+ * @tparam Addresses Addresses of dependent registers.
+ */
+template <std::uint16_t... Addresses>
+struct OperatorParameterMapping {
+  static constexpr ToneRegisterScope kScope{ToneRegisterScope::Operator};
+  static constexpr std::uint32_t kLayoutMask{
+      (layoutBitOf(kOperatorRegisterLayouts, Addresses) | ...)};
+};
+
+/**
+ * @brief Base of mappings to registers of a channel.
+ * @tparam Address Address of the dependent register.
+ */
+template <std::uint16_t Address>
+struct ChannelParameterMapping {
+  static constexpr ToneRegisterScope kScope{ToneRegisterScope::Channel};
+  static constexpr std::uint32_t kLayoutMask{
+      layoutBitOf(kChannelRegisterLayouts, Address)};
+};
+
+/**
+ * @brief Base of mappings to registers shared by all channels.
+ * @tparam Address Address of the dependent register.
+ */
+template <std::uint16_t Address>
+struct ChipParameterMapping {
+  static constexpr ToneRegisterScope kScope{ToneRegisterScope::Chip};
+  static constexpr std::uint32_t kLayoutMask{
+      layoutBitOf(kChipRegisterLayouts, Address)};
+};
+
+// Mappings of operator parameters.
+template <>
+struct ToneParameterMapping<parameter::AttackRateValue>
+    : OperatorParameterMapping<0x50u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.ar; }
+};
+
+template <>
+struct ToneParameterMapping<parameter::DecayRateValue>
+    : OperatorParameterMapping<0x60u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.dr; }
+};
+
+template <>
+struct ToneParameterMapping<parameter::SustainRateValue>
+    : OperatorParameterMapping<0x70u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.sr; }
+};
+
+template <>
+struct ToneParameterMapping<parameter::ReleaseRateValue>
+    : OperatorParameterMapping<0x80u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.rr; }
+};
+
+template <>
+struct ToneParameterMapping<parameter::SustainLevelValue>
+    : OperatorParameterMapping<0x80u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.sl; }
+};
+
+template <>
+struct ToneParameterMapping<parameter::TotalLevelValue>
+    : OperatorParameterMapping<0x40u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.tl; }
+};
+
+template <>
+struct ToneParameterMapping<parameter::KeyScaleValue>
+    : OperatorParameterMapping<0x50u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.ks; }
+};
+
+template <>
+struct ToneParameterMapping<parameter::MultipleValue>
+    : OperatorParameterMapping<0x30u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.ml; }
+};
+
+template <>
+struct ToneParameterMapping<parameter::DetuneValue>
+    : OperatorParameterMapping<0x30u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.dt; }
+};
+
+template <>
+struct ToneParameterMapping<parameter::AmValue>
+    : OperatorParameterMapping<0x60u> {
+  static auto& field(FmParameters::Operator& op) noexcept { return op.am; }
+};
+
+/// Attack rate is overridden while SSG-EG is enabled.
+template <>
+struct ToneParameterMapping<parameter::SsgegEnabledValue>
+    : OperatorParameterMapping<0x50u, 0x90u> {
+  static auto& field(FmParameters::Operator& op) noexcept {
+    return op.ssgeg.isEnabled;
+  }
+};
+
+template <>
+struct ToneParameterMapping<parameter::SsgegShapeValue>
+    : OperatorParameterMapping<0x90u> {
+  static auto& field(FmParameters::Operator& op) noexcept {
+    return op.ssgeg.shape;
+  }
+};
+
+// Mappings of channel parameters.
+template <>
+struct ToneParameterMapping<parameter::AlgorithmValue>
+    : ChannelParameterMapping<0xb0u> {
+  static auto& field(FmParameters& parameters) noexcept {
+    return parameters.al;
+  }
+};
+
+template <>
+struct ToneParameterMapping<parameter::FeedbackValue>
+    : ChannelParameterMapping<0xb0u> {
+  static auto& field(FmParameters& parameters) noexcept {
+    return parameters.fb;
+  }
+};
+
+template <>
+struct ToneParameterMapping<parameter::LfoPmsValue>
+    : ChannelParameterMapping<0xb4u> {
+  static auto& field(FmParameters& parameters) noexcept {
+    return parameters.lfo.pms;
+  }
+};
+
+template <>
+struct ToneParameterMapping<parameter::LfoAmsValue>
+    : ChannelParameterMapping<0xb4u> {
+  static auto& field(FmParameters& parameters) noexcept {
+    return parameters.lfo.ams;
+  }
+};
+
+// Mappings of parameters shared by all channels.
+template <>
+struct ToneParameterMapping<parameter::LfoEnabledValue>
+    : ChipParameterMapping<0x22u> {
+  static auto& field(FmParameters& parameters) noexcept {
+    return parameters.lfo.isEnabled;
+  }
+};
+
+template <>
+struct ToneParameterMapping<parameter::LfoFrequency>
+    : ChipParameterMapping<0x22u> {
+  static auto& field(FmParameters& parameters) noexcept {
+    return parameters.lfo.frequency;
+  }
+};
+}  // namespace audio
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+
+namespace audio {
+/**
+ * @brief Lock-free triple buffer passing the latest value from a writer thread
+ * to a reader thread.
+ * @details The writer fills the back buffer and swaps it with the middle one,
+ * and the reader swaps the front buffer with the middle one when it has a new
+ * value. Neither side waits or allocates, and a value which the reader has not
+ * picked up is overwritten by the next one.
+ * @tparam T Value type.
+ * @note It supports only one writer thread and one reader thread.
+ */
+template <std::copyable T>
+class TripleBuffer {
+ public:
+  /**
+   * @brief Get the buffer to write the next value.
+   * @return Back buffer, which keeps a value written before.
+   * @note It must be called from the writer thread.
+   */
+  T& back() noexcept { return buffers_[back_]; }
+
+  /**
+   * @brief Publish the back buffer to the reader.
+   * @note It must be called from the writer thread.
+   */
+  void publish() noexcept {
+    back_ = middle_.exchange(back_ | kNewBit, std::memory_order_acq_rel) &
+            kIndexMask;
+  }
+
+  /**
+   * @brief Get the latest published value.
+   * @return Front buffer. It is valid until the next call.
+   * @note It must be called from the reader thread.
+   */
+  const T& read() noexcept {
+    if (middle_.load(std::memory_order_relaxed) & kNewBit) {
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    }
+    return buffers_[front_];
+  }
+
+ private:
+  /// Bit of @c middle_ which represents a value not read yet.
+  static constexpr std::uint8_t kNewBit{0b100u};
+
+  /// Bits of @c middle_ which represent buffer index.
+  static constexpr std::uint8_t kIndexMask{0b011u};
+
+  /// Buffers.
+  std::array<T, 3> buffers_{};
+
+  /// Index of the buffer owned by the writer.
+  std::uint8_t back_{0u};
+
+  /// Index of the buffer exchanged between threads and whether it is new.
+  std::atomic<std::uint8_t> middle_{1u};
+
+  /// Index of the buffer owned by the reader.
+  std::uint8_t front_{2u};
+};
+}  // namespace audio
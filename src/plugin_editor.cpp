@@ -16,18 +16,25 @@
 #include "ui/envelope_graph.h"
 #include "ui/fm_operator_parameters_tab_content.h"
 #include "ui/fm_operator_parameters_tabbed_component.h"
+#include "ui/level_meter.h"
 #include "ui/nestable_grid.h"
 
+namespace {
+/// Refresh rate of the statistics overlay.
+constexpr int kStatisticsRefreshRateHz{10};
+}  // namespace
+
 //==============================================================================
 PluginEditor::PluginEditor(
     PluginProcessor& processor,
-    std::weak_ptr<PluginStore<PluginState, PluginAction>> store,
+    std::weak_ptr<PluginStore<PluginState, PluginAction, PluginReducer>> store,
     juce::AudioProcessorValueTreeState& parameters)
-    : AudioProcessorEditor(&processor), store_(store) {
+    : AudioProcessorEditor(&processor), processor_(processor), store_(store) {
   envelopeGraph_ = std::make_shared<ui::EnvelopeGraph>(parameters);
   addAndMakeVisible(envelopeGraph_.get());
   if (auto storePtr = store.lock()) {
     storePtr->subscribe(
+        [](const PluginState& state) { return state.envelopeGraphFrontSlot; },
         [weakGraph = std::weak_ptr(envelopeGraph_)](const auto& state) {
           if (auto graph = weakGraph.lock()) {
             graph->render(state);
@@ -57,6 +64,29 @@ PluginEditor::PluginEditor(
   panicButton_->onClick = [&processor] { processor.resetAudioSource(); };
   addAndMakeVisible(panicButton_.get());
 
+  // Statistics of rendering.
+  statisticsOverlay_ = std::make_unique<juce::Label>();
+  statisticsOverlay_->setJustificationType(juce::Justification::topRight);
+  statisticsOverlay_->setInterceptsMouseClicks(false, false);
+  addChildComponent(statisticsOverlay_.get());
+
+  statisticsButton_ = std::make_unique<juce::ToggleButton>("Stats");
+  statisticsButton_->onClick = [this] {
+    const bool isShown = statisticsButton_->getToggleState();
+    statisticsOverlay_->setVisible(isShown);
+    if (isShown) {
+      timerCallback();
+      startTimerHz(kStatisticsRefreshRateHz);
+    } else {
+      stopTimer();
+    }
+  };
+  addAndMakeVisible(statisticsButton_.get());
+
+  // Meter of output levels and voices.
+  levelMeter_ = std::make_unique<ui::LevelMeter>(processor.outputMeter());
+  addAndMakeVisible(levelMeter_.get());
+
   // Pitch bend sensitivity.
   pitchBendSensitivityPair_ = makeLabeledSlider(
       ap::idAsString(ap::PluginParameter::PitchBendSensitivity),
@@ -88,10 +118,10 @@ PluginEditor::PluginEditor(
           apvtsUiAttachments_.emplace_back(
               std::make_unique<ApvtsAttachmentForUi>(
                   parameters, ap::idAsString(slot, parameterType),
-                  [weakGraph =
-                       std::weak_ptr(envelopeGraph_)](float /*newValue*/) {
+                  [weakGraph = std::weak_ptr(envelopeGraph_),
+                   slot](float /*newValue*/) {
                     if (auto graph = weakGraph.lock()) {
-                      graph->updateControllerPosition();
+                      graph->updateControllerPosition(slot);
                     }
                   }));
         };
@@ -109,9 +139,8 @@ PluginEditor::PluginEditor(
       std::make_unique<ui::FmOperatorParametersTabbedComponent>(
           juce::TabbedButtonBar::TabsAtTop, [store](int tabIndex) {
             if (auto storePtr = store.lock()) {
-              storePtr->dispatch(PluginAction{
-                  .type{PluginAction::Type::CurrentEditingOperatorChanged},
-                  .payload{static_cast<std::size_t>(tabIndex)}});
+              storePtr->dispatch(action::CurrentEditingOperatorChanged{
+                  .slot{static_cast<std::size_t>(tabIndex)}});
             }
           });
   for (std::size_t slot = 0; slot < audio::kSlotCount; ++slot) {
@@ -130,7 +159,7 @@ PluginEditor::PluginEditor(
   resized();
 }
 
-PluginEditor::~PluginEditor() {}
+PluginEditor::~PluginEditor() { stopTimer(); }
 
 //==============================================================================
 void PluginEditor::paint(juce::Graphics& g) {
@@ -179,10 +208,20 @@ void PluginEditor::resized() {
     buttonGrid.setTemplateColumns({1_fr, 1_fr});
     buttonGrid.setTemplateRows({1_fr});
 
-    buttonGrid.setItems({panicButton_.get(), {}});
+    buttonGrid.setItems({panicButton_.get(), statisticsButton_.get()});
     buttonGrid.performLayout(buttonArea);
   }
 
+  {
+    constexpr int gap{kRowHeight / 2};
+    const auto meterArea =
+        leftArea.withTrimmedTop(gap).withHeight(kRowHeight * 2);
+    levelMeter_->setBounds(meterArea);
+  }
+
+  statisticsOverlay_->setBounds(
+      getLocalBounds().reduced(kContentAreaPadding).removeFromTop(kRowHeight));
+
   // Right area.
   {
     constexpr int gap{kRowHeight / 2};
@@ -193,3 +232,24 @@ void PluginEditor::resized() {
 
   envelopeGraph_->setBounds(rightArea);
 }
+
+void PluginEditor::timerCallback() {
+  const auto statistics = processor_.renderStatistics().snapshot();
+  constexpr double kMicroseconds{1e-3};
+
+  statisticsOverlay_->setText(
+      juce::String::formatted(
+          "DSP %.1f%% | emu %.0f us, rs %.0f us, cv %.0f us | MIDI %d, "
+          "params %d, writes %d, splits %d | xruns %d, overflows %d",
+          statistics.load() * 100.,
+          statistics.emulationNanoseconds * kMicroseconds,
+          statistics.resamplingNanoseconds * kMicroseconds,
+          statistics.conversionNanoseconds * kMicroseconds,
+          static_cast<int>(statistics.midiEventCount),
+          static_cast<int>(statistics.parameterChangeCount),
+          static_cast<int>(statistics.registerWriteCount),
+          static_cast<int>(statistics.renderSplitCount),
+          static_cast<int>(statistics.totalOverloadedBlockCount),
+          static_cast<int>(statistics.totalOverflowedRegisterWriteCount)),
+      juce::dontSendNotification);
+}
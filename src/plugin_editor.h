@@ -15,6 +15,7 @@
 #include "action.h"
 #include "apvts_attachment.h"
 #include "audio/parameter/parameter.h"
+#include "reducer.h"
 #include "state.h"
 #include "store.h"
 #include "ui/attached_component.h"
@@ -25,10 +26,11 @@ namespace ui {
 class AlgorithmGraph;
 class EnvelopeGraph;
 class FmOperatorParametersTabbedComponent;
+class LevelMeter;
 }  // namespace ui
 
 //==============================================================================
-class PluginEditor : public juce::AudioProcessorEditor {
+class PluginEditor : public juce::AudioProcessorEditor, private juce::Timer {
  public:
   /**
    * @brief Constructor.
@@ -36,9 +38,11 @@ class PluginEditor : public juce::AudioProcessorEditor {
    * @param[in] store Store.
    * @param[in] parameters APVTS.
    */
-  PluginEditor(PluginProcessor& processor,
-               std::weak_ptr<PluginStore<PluginState, PluginAction>> store,
-               juce::AudioProcessorValueTreeState& parameters);
+  PluginEditor(
+      PluginProcessor& processor,
+      std::weak_ptr<PluginStore<PluginState, PluginAction, PluginReducer>>
+          store,
+      juce::AudioProcessorValueTreeState& parameters);
   ~PluginEditor() override;
 
   //============================================================================
@@ -46,13 +50,25 @@ class PluginEditor : public juce::AudioProcessorEditor {
   void resized() override;
 
  private:
+  // Processor.
+  PluginProcessor& processor_;
+
   // Store.
-  std::weak_ptr<PluginStore<PluginState, PluginAction>> store_;
+  std::weak_ptr<PluginStore<PluginState, PluginAction, PluginReducer>> store_;
 
   // [Control] -----------------------------------------------------------------
   // Panic button.
   std::unique_ptr<juce::TextButton> panicButton_;
 
+  // Button to show statistics of rendering.
+  std::unique_ptr<juce::ToggleButton> statisticsButton_;
+
+  // Overlay of statistics of rendering.
+  std::unique_ptr<juce::Label> statisticsOverlay_;
+
+  // Meter of output levels and voices.
+  std::unique_ptr<ui::LevelMeter> levelMeter_;
+
   // Label and slider pairs.
   std::unique_ptr<ui::LabeledSliderWithAttachment> pitchBendSensitivityPair_;
   std::unique_ptr<ui::LabeledSliderWithAttachment> alPair_, fbPair_;
@@ -69,5 +85,10 @@ class PluginEditor : public juce::AudioProcessorEditor {
   // Algorithm graph.
   std::shared_ptr<ui::AlgorithmGraph> algorithmGraph_;
 
+  /**
+   * @brief Update the overlay with the latest statistics.
+   */
+  void timerCallback() override;
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginEditor)
 };
@@ -5,10 +5,14 @@
 
 #include "plugin_processor.h"
 
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 
 #include "audio/fm_audio_source.h"
+#include "audio/parameter/state_chunk.h"
 #include "audio/pitch_util.h"
 #include "plugin_editor.h"
 #include "reducer.h"
@@ -17,6 +21,167 @@ namespace {
 /// Default pitch bend sensitivity.
 constexpr std::uint8_t kDefaultPitchBendSensitivity{2};
 
+/// Choices of quality parameter.
+const juce::StringArray kQualityChoices{"Eco", "Normal", "High"};
+
+/// Default index of quality choices, which is the cheapest.
+constexpr int kDefaultQualityIndex{0};
+
+/**
+ * @brief Get the number of taps of the resampler from quality.
+ * @param[in] qualityIndex Index of quality choices.
+ * @param[in] isOffline Whether the host renders offline.
+ * @return The number of taps per phase.
+ */
+std::size_t tapCountOf(int qualityIndex, bool isOffline) {
+  // Offline rendering has no deadline, so spend more on quality.
+  if (isOffline) {
+    return audio::PolyphaseResampler::kHighQualityTapCount;
+  }
+
+  switch (qualityIndex) {
+    case 1:
+      return audio::PolyphaseResampler::kDefaultTapCount;
+    case 2:
+      return audio::PolyphaseResampler::kHighQualityTapCount;
+    default:
+      return audio::PolyphaseResampler::kEcoTapCount;
+  }
+}
+
+/**
+ * @brief Get elapsed time.
+ * @param[in] begin Start time.
+ * @return Nanoseconds from @c begin.
+ */
+std::uint64_t nanosecondsSince(std::chrono::steady_clock::time_point begin) {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - begin)
+          .count());
+}
+
+/**
+ * @brief Visit fields of tone parameters which are plugin parameters.
+ * @param[in] fm Tone parameters.
+ * @param[in] function Function called with parameter ID and field.
+ */
+template <class Parameters, class F>
+  requires std::is_same_v<std::remove_const_t<Parameters>, audio::FmParameters>
+void forEachParameterField(Parameters& fm, F&& function) {
+  namespace ap = audio::parameter;
+
+  function(ap::idAsString(ap::FmToneParameter::Al), fm.al);
+  function(ap::idAsString(ap::FmToneParameter::Fb), fm.fb);
+  function(ap::idAsString(ap::FmToneParameter::LfoEnabled), fm.lfo.isEnabled);
+  function(ap::idAsString(ap::FmToneParameter::LfoFrequency),
+           fm.lfo.frequency);
+  function(ap::idAsString(ap::FmToneParameter::Pms), fm.lfo.pms);
+  function(ap::idAsString(ap::FmToneParameter::Ams), fm.lfo.ams);
+
+  for (std::size_t n = 0; n < audio::kSlotCount; ++n) {
+    auto& slot = fm.slot[n];
+    function(ap::idAsString(n, ap::FmOperatorParameter::OperatorEnabled),
+             slot.isEnabled);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Ar), slot.ar);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Dr), slot.dr);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Sr), slot.sr);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Rr), slot.rr);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Sl), slot.sl);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Tl), slot.tl);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Ks), slot.ks);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Ml), slot.ml);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Dt), slot.dt);
+    function(ap::idAsString(n, ap::FmOperatorParameter::Amon), slot.am);
+    function(ap::idAsString(n, ap::FmOperatorParameter::SsgegEnabled),
+             slot.ssgeg.isEnabled);
+    function(ap::idAsString(n, ap::FmOperatorParameter::SsgegShape),
+             slot.ssgeg.shape);
+  }
+}
+
+/**
+ * @brief Visit fields of a state chunk which are plugin parameters.
+ * @param[in] chunk State chunk.
+ * @param[in] function Function called with parameter ID and field.
+ */
+template <class Chunk, class F>
+  requires std::is_same_v<std::remove_const_t<Chunk>,
+                          audio::parameter::StateChunk>
+void forEachParameterField(Chunk& chunk, F&& function) {
+  namespace ap = audio::parameter;
+
+  function(ap::idAsString(ap::PluginParameter::PitchBendSensitivity),
+           chunk.pitchBendSensitivity);
+  function(ap::idAsString(ap::PluginParameter::Quality), chunk.quality);
+  function(ap::idAsString(ap::PluginParameter::DcBlockerEnabled),
+           chunk.isDcBlockerEnabled);
+  function(ap::idAsString(ap::PluginParameter::OutputGain), chunk.outputGain);
+  function(ap::idAsString(ap::PluginParameter::SoftClipEnabled),
+           chunk.isSoftClipEnabled);
+  function(ap::idAsString(ap::PluginParameter::ChipCount), chunk.chipCount);
+  function(ap::idAsString(ap::PluginParameter::ParallelRenderingEnabled),
+           chunk.isParallelRenderingEnabled);
+  forEachParameterField(chunk.fmParameters, function);
+}
+
+/**
+ * @brief Make a state chunk from the current parameter values.
+ * @param[in] parameters APVTS.
+ * @return State chunk.
+ */
+audio::parameter::StateChunk makeStateChunk(
+    const juce::AudioProcessorValueTreeState& parameters) {
+  audio::parameter::StateChunk chunk;
+  forEachParameterField(chunk, [&](const juce::String& id, auto& field) {
+    if (const auto* value = parameters.getRawParameterValue(id)) {
+      field = audio::parameter::parameterCast<
+          std::remove_cvref_t<decltype(field)>>(value->load());
+    }
+  });
+  return chunk;
+}
+
+/**
+ * @brief Set parameter values from fields.
+ * @param[in] values State chunk or tone parameters.
+ * @param[in] parameters APVTS.
+ */
+template <class T>
+void setParameterValues(const T& values,
+                        juce::AudioProcessorValueTreeState& parameters) {
+  forEachParameterField(values, [&](const juce::String& id, const auto& field) {
+    if (auto* parameter = parameters.getParameter(id)) {
+      parameter->setValueNotifyingHost(
+          parameter->convertTo0to1(static_cast<float>(field.rawValue())));
+    }
+  });
+}
+
+/**
+ * @brief Set parameter values from fields to a state tree of APVTS.
+ * @details Values are stored as properties of the tree, so the host is not
+ * notified until the tree replaces the state.
+ * @param[in] values State chunk.
+ * @param[in,out] state Copy of the state of APVTS.
+ */
+void setStateValues(const audio::parameter::StateChunk& values,
+                    juce::ValueTree& state) {
+  static const juce::Identifier kParameterType{"PARAM"};
+  static const juce::Identifier kId{"id"};
+  static const juce::Identifier kValue{"value"};
+
+  forEachParameterField(values, [&](const juce::String& id, const auto& field) {
+    auto child = state.getChildWithProperty(kId, id);
+    if (!child.isValid()) {
+      child = juce::ValueTree(kParameterType);
+      child.setProperty(kId, id, nullptr);
+      state.appendChild(child, nullptr);
+    }
+    child.setProperty(kValue, static_cast<float>(field.rawValue()), nullptr);
+  });
+}
+
 juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout() {
   juce::AudioProcessorValueTreeState::ParameterLayout layout;
 
@@ -28,6 +193,44 @@ juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout() {
       ap::PitchBendSensitivityValue::kMinimum,
       ap::PitchBendSensitivityValue::kMaximum, kDefaultPitchBendSensitivity));
 
+  layout.add(std::make_unique<juce::AudioParameterChoice>(
+      ap::id(ap::PluginParameter::Quality),
+      ap::name(ap::PluginParameter::Quality), kQualityChoices,
+      kDefaultQualityIndex,
+      juce::AudioParameterChoiceAttributes().withAutomatable(false)));
+
+  const audio::parameter::StateChunk defaultChunk;
+
+  layout.add(std::make_unique<juce::AudioParameterBool>(
+      ap::id(ap::PluginParameter::DcBlockerEnabled),
+      ap::name(ap::PluginParameter::DcBlockerEnabled),
+      defaultChunk.isDcBlockerEnabled.rawValue()));
+
+  layout.add(std::make_unique<juce::AudioParameterInt>(
+      ap::id(ap::PluginParameter::OutputGain),
+      ap::name(ap::PluginParameter::OutputGain), ap::OutputGainValue::kMinimum,
+      ap::OutputGainValue::kMaximum, defaultChunk.outputGain.rawValue(),
+      juce::AudioParameterIntAttributes().withLabel("dB")));
+
+  layout.add(std::make_unique<juce::AudioParameterBool>(
+      ap::id(ap::PluginParameter::SoftClipEnabled),
+      ap::name(ap::PluginParameter::SoftClipEnabled),
+      defaultChunk.isSoftClipEnabled.rawValue()));
+
+  // Chips are reallocated when the host prepares the plugin, so the chip count
+  // is a setting rather than an automation target.
+  layout.add(std::make_unique<juce::AudioParameterInt>(
+      ap::id(ap::PluginParameter::ChipCount),
+      ap::name(ap::PluginParameter::ChipCount), ap::ChipCountValue::kMinimum,
+      ap::ChipCountValue::kMaximum, defaultChunk.chipCount.rawValue(),
+      juce::AudioParameterIntAttributes().withAutomatable(false)));
+
+  layout.add(std::make_unique<juce::AudioParameterBool>(
+      ap::id(ap::PluginParameter::ParallelRenderingEnabled),
+      ap::name(ap::PluginParameter::ParallelRenderingEnabled),
+      defaultChunk.isParallelRenderingEnabled.rawValue(),
+      juce::AudioParameterBoolAttributes().withAutomatable(false)));
+
   const auto& fmParameters = audio::defaultFmParameters;
 
   layout.add(std::make_unique<juce::AudioParameterInt>(
@@ -40,6 +243,26 @@ juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout() {
       ap::AlgorithmValue::kMinimum, ap::AlgorithmValue::kMaximum,
       fmParameters.al.rawValue()));
 
+  layout.add(std::make_unique<juce::AudioParameterBool>(
+      ap::id(ap::FmToneParameter::LfoEnabled),
+      ap::name(ap::FmToneParameter::LfoEnabled),
+      fmParameters.lfo.isEnabled.rawValue()));
+
+  layout.add(std::make_unique<juce::AudioParameterInt>(
+      ap::id(ap::FmToneParameter::LfoFrequency),
+      ap::name(ap::FmToneParameter::LfoFrequency), ap::LfoFrequency::kMinimum,
+      ap::LfoFrequency::kMaximum, fmParameters.lfo.frequency.rawValue()));
+
+  layout.add(std::make_unique<juce::AudioParameterInt>(
+      ap::id(ap::FmToneParameter::Pms), ap::name(ap::FmToneParameter::Pms),
+      ap::LfoPmsValue::kMinimum, ap::LfoPmsValue::kMaximum,
+      fmParameters.lfo.pms.rawValue()));
+
+  layout.add(std::make_unique<juce::AudioParameterInt>(
+      ap::id(ap::FmToneParameter::Ams), ap::name(ap::FmToneParameter::Ams),
+      ap::LfoAmsValue::kMinimum, ap::LfoAmsValue::kMaximum,
+      fmParameters.lfo.ams.rawValue()));
+
   for (std::size_t n = 0; n < audio::kSlotCount; ++n) {
     const auto& slot = fmParameters.slot[n];
 
@@ -95,6 +318,21 @@ juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout() {
         ap::id(n, ap::FmOperatorParameter::Dt),
         ap::name(n, ap::FmOperatorParameter::Dt), ap::DetuneValue::kMinimum,
         ap::DetuneValue::kMaximum, slot.dt.rawValue()));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        ap::id(n, ap::FmOperatorParameter::Amon),
+        ap::name(n, ap::FmOperatorParameter::Amon), slot.am.rawValue()));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        ap::id(n, ap::FmOperatorParameter::SsgegEnabled),
+        ap::name(n, ap::FmOperatorParameter::SsgegEnabled),
+        slot.ssgeg.isEnabled.rawValue()));
+
+    layout.add(std::make_unique<juce::AudioParameterInt>(
+        ap::id(n, ap::FmOperatorParameter::SsgegShape),
+        ap::name(n, ap::FmOperatorParameter::SsgegShape),
+        ap::SsgegShapeValue::kMinimum, ap::SsgegShapeValue::kMaximum,
+        slot.ssgeg.shape.rawValue()));
   }
 
   return layout;
@@ -112,12 +350,28 @@ PluginProcessor::PluginProcessor()
               .withOutput("Output", juce::AudioChannelSet::stereo(), true)
 #endif
               ),
-      store_(std::make_shared<PluginStore<PluginState, PluginAction>>(
-          PluginReducer{})),
+      store_(std::make_shared<
+             PluginStore<PluginState, PluginAction, PluginReducer>>()),
       parameters_(*this, nullptr, "PARAMETERS", createParameterLayout()),
-      audioSource_(std::make_unique<audio::FmAudioSource>()) {
+      audioSource_(std::make_unique<audio::FmAudioSource>(
+          audio::FmAudioSource::kDefaultChipCount)) {
   namespace ap = audio::parameter;
 
+  // The audio thread reads quality and the output stage from raw values every
+  // block.
+  quality_ = parameters_.getRawParameterValue(
+      ap::idAsString(ap::PluginParameter::Quality));
+  isDcBlockerEnabled_ = parameters_.getRawParameterValue(
+      ap::idAsString(ap::PluginParameter::DcBlockerEnabled));
+  outputGain_ = parameters_.getRawParameterValue(
+      ap::idAsString(ap::PluginParameter::OutputGain));
+  isSoftClipEnabled_ = parameters_.getRawParameterValue(
+      ap::idAsString(ap::PluginParameter::SoftClipEnabled));
+  chipCount_ = parameters_.getRawParameterValue(
+      ap::idAsString(ap::PluginParameter::ChipCount));
+  isParallelRenderingEnabled_ = parameters_.getRawParameterValue(
+      ap::idAsString(ap::PluginParameter::ParallelRenderingEnabled));
+
   // Set attachments to parameters.
   attachments_.emplace_back(std::make_unique<ApvtsAttachment>(
       parameters_, ap::idAsString(ap::PluginParameter::PitchBendSensitivity),
@@ -138,6 +392,31 @@ PluginProcessor::PluginProcessor()
         reserveParameterChange(ap::parameterCast<ap::FeedbackValue>(newValue));
       }));
 
+  attachments_.emplace_back(std::make_unique<ApvtsAttachment>(
+      parameters_, ap::idAsString(ap::FmToneParameter::LfoEnabled),
+      [&](float newValue) {
+        reserveParameterChange(
+            ap::parameterCast<ap::LfoEnabledValue>(newValue));
+      }));
+
+  attachments_.emplace_back(std::make_unique<ApvtsAttachment>(
+      parameters_, ap::idAsString(ap::FmToneParameter::LfoFrequency),
+      [&](float newValue) {
+        reserveParameterChange(ap::parameterCast<ap::LfoFrequency>(newValue));
+      }));
+
+  attachments_.emplace_back(std::make_unique<ApvtsAttachment>(
+      parameters_, ap::idAsString(ap::FmToneParameter::Pms),
+      [&](float newValue) {
+        reserveParameterChange(ap::parameterCast<ap::LfoPmsValue>(newValue));
+      }));
+
+  attachments_.emplace_back(std::make_unique<ApvtsAttachment>(
+      parameters_, ap::idAsString(ap::FmToneParameter::Ams),
+      [&](float newValue) {
+        reserveParameterChange(ap::parameterCast<ap::LfoAmsValue>(newValue));
+      }));
+
   for (std::size_t slot = 0u; slot < audio::kSlotCount; ++slot) {
     attachments_.emplace_back(std::make_unique<ApvtsAttachment>(
         parameters_,
@@ -209,10 +488,34 @@ PluginProcessor::PluginProcessor()
           reserveParameterChange(ap::SlotAndValue{
               slot, ap::parameterCast<ap::DetuneValue>(newValue)});
         }));
+
+    attachments_.emplace_back(std::make_unique<ApvtsAttachment>(
+        parameters_, ap::idAsString(slot, ap::FmOperatorParameter::Amon),
+        [&, slot](float newValue) {
+          reserveParameterChange(ap::SlotAndValue{
+              slot, ap::parameterCast<ap::AmValue>(newValue)});
+        }));
+
+    attachments_.emplace_back(std::make_unique<ApvtsAttachment>(
+        parameters_,
+        ap::idAsString(slot, ap::FmOperatorParameter::SsgegEnabled),
+        [&, slot](float newValue) {
+          reserveParameterChange(ap::SlotAndValue{
+              slot, ap::parameterCast<ap::SsgegEnabledValue>(newValue)});
+        }));
+
+    attachments_.emplace_back(std::make_unique<ApvtsAttachment>(
+        parameters_, ap::idAsString(slot, ap::FmOperatorParameter::SsgegShape),
+        [&, slot](float newValue) {
+          reserveParameterChange(ap::SlotAndValue{
+              slot, ap::parameterCast<ap::SsgegShapeValue>(newValue)});
+        }));
   }
+
+  patchBank_.loadDirectory(audio::PatchBank::defaultDirectory());
 }
 
-PluginProcessor::~PluginProcessor() {}
+PluginProcessor::~PluginProcessor() { cancelPendingUpdate(); }
 
 //==============================================================================
 const juce::String PluginProcessor::getName() const { return JucePlugin_Name; }
@@ -244,20 +547,31 @@ bool PluginProcessor::isMidiEffect() const {
 double PluginProcessor::getTailLengthSeconds() const { return 0.0; }
 
 int PluginProcessor::getNumPrograms() {
-  return 1;  // NB: some hosts don't cope very well if you tell them there are 0
-             // programs, so this should be at least 1, even if you're not
-             // really implementing programs.
+  return static_cast<int>(audio::PatchBank::kPatchCount);
 }
 
-int PluginProcessor::getCurrentProgram() { return 0; }
+int PluginProcessor::getCurrentProgram() { return currentProgram_.load(); }
 
 void PluginProcessor::setCurrentProgram(int index) {
-  juce::ignoreUnused(index);
+  if (index < 0 || getNumPrograms() <= index) {
+    return;
+  }
+
+  currentProgram_.store(index);
+  pendingProgram_.store(index, std::memory_order_release);
+
+  // Changes enqueued by listeners of these parameters write no register
+  // because the audio source switches the patch before them.
+  const auto& patch = patchBank_.patch(static_cast<std::size_t>(index));
+  setParameterValues(patch.parameters, parameters_);
 }
 
 const juce::String PluginProcessor::getProgramName(int index) {
-  juce::ignoreUnused(index);
-  return {};
+  if (index < 0 || getNumPrograms() <= index) {
+    return {};
+  }
+
+  return patchBank_.patch(static_cast<std::size_t>(index)).name;
 }
 
 void PluginProcessor::changeProgramName(int index,
@@ -267,19 +581,37 @@ void PluginProcessor::changeProgramName(int index,
 
 //==============================================================================
 void PluginProcessor::prepareToPlay(double sampleRate, int samplesPerBlock) {
-  audioSource_->prepareToPlay(samplesPerBlock, sampleRate);
+  // The audio thread is stopped here, so chips are reallocated for the chip
+  // count of the current state.
+  audioSource_->setChipCount(static_cast<std::size_t>(chipCount_->load()));
+
+  // Workers are spawned here rather than on the audio thread, and park until
+  // parallel rendering is enabled.
+  audioSource_->spawnWorkers();
 
-  resampler_ = std::make_unique<juce::ResamplingAudioSource>(
-      audioSource_.get(), false, getMainBusNumOutputChannels());
-  const auto synRate = audioSource_->synthesisRate();
-  const auto ratio = synRate / sampleRate;
-  resampler_->setResamplingRatio(ratio);
+  const bool isOffline = isNonRealtime();
+
+  // The resampler prepares the audio source at synthesis rate.
+  resampler_ = std::make_unique<audio::PolyphaseResampler>(
+      audioSource_.get(),
+      tapCountOf(static_cast<int>(quality_->load()), isOffline));
   resampler_->prepareToPlay(samplesPerBlock, sampleRate);
 }
 
+void PluginProcessor::handleAsyncUpdate() {
+  if (isProgramChangedByMidi_.exchange(false)) {
+    const auto& patch =
+        patchBank_.patch(static_cast<std::size_t>(currentProgram_.load()));
+    setParameterValues(patch.parameters, parameters_);
+    updateHostDisplay(ChangeDetails().withProgramChanged(true));
+  }
+}
+
 void PluginProcessor::releaseResources() {
-  audioSource_->releaseResources();
-  resampler_->releaseResources();
+  if (resampler_) {
+    resampler_->releaseResources();
+  }
+  audioSource_->joinWorkers();
 }
 
 bool PluginProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const {
@@ -316,14 +648,15 @@ void PluginProcessor::processBlockBypassed(juce::AudioBuffer<float>& buffer,
                                            juce::MidiBuffer& midiMessages) {
   buffer.clear(0, buffer.getNumSamples());
 
-  auto dummyBuffer = [&] {
-    juce::AudioBuffer<float> dummy;
-    dummy.makeCopyOf(buffer);
-    return dummy;
-  }();
+  if (!resampler_) {
+    return;
+  }
 
-  // Run audio source, but drop generated samples.
-  fillBuffer(dummyBuffer, midiMessages);
+  // Keep the emulator state up to date without generating samples. The
+  // resampler does not advance, so all changes are applied at the top of the
+  // block.
+  reserveChanges(midiMessages, false);
+  audioSource_->triggerReservedChanges();
 }
 
 void PluginProcessor::fillBuffer(juce::AudioBuffer<float>& buffer,
@@ -334,58 +667,136 @@ void PluginProcessor::fillBuffer(juce::AudioBuffer<float>& buffer,
     return;
   }
 
+  const auto begin = std::chrono::steady_clock::now();
+  const std::uint64_t emulationNanoseconds = resampler_->emulationNanoseconds();
+  const std::uint64_t conversionNanoseconds =
+      resampler_->conversionNanoseconds();
+  const std::uint64_t registerWriteCount =
+      audioSource_->appliedRegisterWriteCount();
+  const std::uint64_t renderSplitCount = audioSource_->renderSplitCount();
+
+  reserveChanges(midiMessages, true);
+
+  // Offline rendering has no deadline, so use all chips in parallel to finish
+  // faster.
+  audioSource_->setParallelRenderingEnabled(
+      isNonRealtime() || isParallelRenderingEnabled_->load() >= 0.5f);
+
+  // Quality changes only the filter, so the emulator keeps playing.
+  resampler_->setTapCount(
+      tapCountOf(static_cast<int>(quality_->load()), isNonRealtime()));
+  resampler_->setOutputStage({
+      .isDcBlockerEnabled = isDcBlockerEnabled_->load() >= 0.5f,
+      .gainDecibels = outputGain_->load(),
+      .isSoftClipEnabled = isSoftClipEnabled_->load() >= 0.5f,
+  });
+
+  juce::AudioSourceChannelInfo channelInfo(&buffer, 0, buffer.getNumSamples());
+  const auto resamplingBegin = std::chrono::steady_clock::now();
+  resampler_->getNextAudioBlock(channelInfo);
+  const std::uint64_t resamplingNanoseconds = nanosecondsSince(resamplingBegin);
+
+  // Let the host know the block is silent. The resampler and the DC blocker
+  // may still output a tail after the chips become idle, so wait for it to
+  // settle.
+  if (audioSource_->isIdle() &&
+      buffer.getMagnitude(0, buffer.getNumSamples()) == 0.f) {
+    buffer.clear();
+  }
+
+  // Publish statistics of the block.
+  auto& statistics = blockStatistics_;
+  ++statistics.totalBlockCount;
+  statistics.sampleCount = static_cast<std::uint64_t>(buffer.getNumSamples());
+  statistics.budgetNanoseconds = static_cast<std::uint64_t>(
+      buffer.getNumSamples() * 1e9 / getSampleRate());
+  statistics.processNanoseconds = nanosecondsSince(begin);
+  statistics.emulationNanoseconds =
+      resampler_->emulationNanoseconds() - emulationNanoseconds;
+  statistics.conversionNanoseconds =
+      resampler_->conversionNanoseconds() - conversionNanoseconds;
+  statistics.resamplingNanoseconds =
+      resamplingNanoseconds - std::min(resamplingNanoseconds,
+                                       statistics.emulationNanoseconds +
+                                           statistics.conversionNanoseconds);
+  statistics.registerWriteCount =
+      audioSource_->appliedRegisterWriteCount() - registerWriteCount;
+  statistics.renderSplitCount =
+      audioSource_->renderSplitCount() - renderSplitCount;
+  if (statistics.budgetNanoseconds < statistics.processNanoseconds) {
+    ++statistics.totalOverloadedBlockCount;
+  }
+  statistics.totalOverflowedRegisterWriteCount =
+      audioSource_->overflowedRegisterWriteCount();
+  renderStatistics_.publish(statistics);
+}
+
+void PluginProcessor::reserveChanges(const juce::MidiBuffer& midiMessages,
+                                     bool isTimestamped) {
   if (shouldResetAudioSource_.exchange(false)) {
     audioSource_->reset();
   }
 
-  {
-    // Reflect parameter changes modified by sliders.
-    std::lock_guard guard{parameterQueueMutex_};
-
-    if (!parameterChangeQueue_.empty()) {
-      while (!parameterChangeQueue_.empty()) {
-        auto&& parameter = parameterChangeQueue_.dequeue();
-        std::visit(
-            [this](const auto& param) {
-              audioSource_->tryReserveParameterChange(param);
-            },
-            parameter);
-      }
-
-      audioSource_->triggerReservedChanges();
+  // Reflect parameter changes modified by sliders at the top of the block.
+  audioSource_->setReservationTimestamp(synthesisTimestampAt(0));
+  blockStatistics_.parameterChangeCount = 0;
+
+  // Apply a whole patch before individual changes. If the message thread is
+  // still writing it, it is applied in the next block.
+  if (hasPendingPatch_.load(std::memory_order_acquire)) {
+    const juce::SpinLock::ScopedTryLockType lock(pendingPatchLock_);
+    if (lock.isLocked()) {
+      hasPendingPatch_.store(false, std::memory_order_relaxed);
+      ++blockStatistics_.parameterChangeCount;
+      audioSource_->applyPatch(pendingPatch_);
     }
   }
 
-  int sampleStartPosition{};
+  if (const int program = pendingProgram_.exchange(-1); program >= 0) {
+    ++blockStatistics_.parameterChangeCount;
+    const auto& patch = patchBank_.patch(static_cast<std::size_t>(program));
+    audioSource_->applyPatch(patch.parameters, patch.image);
+  }
 
-  // Fill buffer considering MIDI events.
-  for (auto iter = midiMessages.begin(); iter != midiMessages.end();) {
-    const int position = (*iter).samplePosition;
+  while (!parameterChangeQueue_.empty()) {
+    ++blockStatistics_.parameterChangeCount;
+    audioSource_->tryReserveParameterChange(parameterChangeQueue_.dequeue());
+  }
 
-    // Try to change a state of audio source.
-    if (!audioSource_->tryReserveChangeFromMidiMessage(
-            (*iter++).getMessage())) {
-      continue;
-    }
+  // Reserve MIDI events with their timestamps in synthesis rate. The audio
+  // source applies them at the right sample while generating a whole block.
+  // Messages are decoded in batches, which drop redundant pitch wheel and
+  // controller messages at the same sample position.
+  for (auto it = midiMessages.cbegin(); it != midiMessages.cend();) {
+    it = midiEvents_.decode(it, midiMessages.cend());
+
+    for (const auto& event : midiEvents_.events()) {
+      if (isTimestamped) {
+        audioSource_->setReservationTimestamp(
+            synthesisTimestampAt(event.samplePosition));
+      }
+      if (event.type == audio::MidiEvent::Type::ProgramChange) {
+        // Switch the patch here, and let the message thread update parameters.
+        const int program = event.number;
+        const auto& patch =
+            patchBank_.patch(static_cast<std::size_t>(program));
+        audioSource_->applyPatch(patch.parameters, patch.image);
+        currentProgram_.store(program);
+        isProgramChangedByMidi_.store(true);
+        triggerAsyncUpdate();
+        continue;
+      }
 
-    if (iter != midiMessages.end() && (*iter).samplePosition == position) {
-      // Continue to read next event which is placed at the same position.
-      continue;
+      audioSource_->tryReserveMidiEvent(event);
     }
-
-    juce::AudioSourceChannelInfo channelInfo(&buffer, sampleStartPosition,
-                                             position - sampleStartPosition);
-    resampler_->getNextAudioBlock(channelInfo);
-    sampleStartPosition = position;
-
-    audioSource_->triggerReservedChanges();
   }
+  blockStatistics_.midiEventCount =
+      static_cast<std::uint64_t>(midiMessages.getNumEvents());
+}
 
-  // Fill a rest of buffer.
-  juce::AudioSourceChannelInfo channelInfo(
-      &buffer, sampleStartPosition,
-      buffer.getNumSamples() - sampleStartPosition);
-  resampler_->getNextAudioBlock(channelInfo);
+std::uint64_t PluginProcessor::synthesisTimestampAt(
+    int samplePosition) const noexcept {
+  return resampler_->sourceFrameAt(static_cast<std::size_t>(samplePosition));
 }
 
 //==============================================================================
@@ -399,12 +810,27 @@ juce::AudioProcessorEditor* PluginProcessor::createEditor() {
 
 //==============================================================================
 void PluginProcessor::getStateInformation(juce::MemoryBlock& destData) {
-  const auto state = parameters_.copyState();
-  std::unique_ptr<juce::XmlElement> xml(state.createXml());
-  copyXmlToBinary(*xml, destData);
+  audio::parameter::encode(makeStateChunk(parameters_), destData);
 }
 
 void PluginProcessor::setStateInformation(const void* data, int sizeInBytes) {
+  if (sizeInBytes <= 0) {
+    return;
+  }
+
+  if (const auto chunk = audio::parameter::decode(
+          data, static_cast<std::size_t>(sizeInBytes))) {
+    reservePatch(chunk->fmParameters);
+
+    // Loading a session is not an edit, so parameters are replaced without
+    // notifying the host of each change.
+    auto state = parameters_.copyState();
+    setStateValues(*chunk, state);
+    parameters_.replaceState(state);
+    return;
+  }
+
+  // Sessions saved before the binary format are stored as XML.
   std::unique_ptr<juce::XmlElement> xmlState(
       getXmlFromBinary(data, sizeInBytes));
   if (!xmlState || !xmlState->hasTagName(parameters_.state.getType())) {
@@ -421,14 +847,27 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter() {
 }
 
 //==============================================================================
-// void PluginProcessor::reserveParameterChange(
-//     audio::ParameterTypeVariant parameter) {
-//   std::lock_guard<std::mutex> guard(parameterQueueMutex_);
-//   parameterChangeQueue_.enqueue(parameter);
-// }
-
 void PluginProcessor::reserveParameterChange(
     const audio::parameter::ParameterVariant& parameter) {
-  std::lock_guard guard{parameterQueueMutex_};
   parameterChangeQueue_.enqueue(parameter);
 }
+
+audio::OutputMeter& PluginProcessor::outputMeter() noexcept {
+  return audioSource_->outputMeter();
+}
+
+void PluginProcessor::applyPatch(const audio::FmParameters& patch) {
+  reservePatch(patch);
+
+  // Changes enqueued by listeners of these parameters write no register
+  // because the audio source applies the patch before them.
+  setParameterValues(patch, parameters_);
+}
+
+void PluginProcessor::reservePatch(const audio::FmParameters& patch) {
+  {
+    const juce::SpinLock::ScopedLockType lock(pendingPatchLock_);
+    pendingPatch_ = patch;
+  }
+  hasPendingPatch_.store(true, std::memory_order_release);
+}
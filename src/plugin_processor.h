@@ -7,22 +7,29 @@
 
 #include <JuceHeader.h>
 
+#include <cstdint>
 #include <memory>
-#include <mutex>
 #include <vector>
 
 #include "action.h"
 #include "apvts_attachment.h"
+#include "audio/midi_event_batch.h"
 #include "audio/parameter/parameter.h"
 #include "audio/parameter/parameter_change_queue.h"
+#include "audio/patch_bank.h"
+#include "audio/polyphase_resampler.h"
+#include "audio/render_statistics.h"
+#include "reducer.h"
 #include "state.h"
 #include "store.h"
 
 namespace audio {
 class FmAudioSource;
-}
+class OutputMeter;
+}  // namespace audio
 
-class PluginProcessor : public juce::AudioProcessor {
+class PluginProcessor : public juce::AudioProcessor,
+                        private juce::AsyncUpdater {
  public:
   //============================================================================
   PluginProcessor();
@@ -70,16 +77,40 @@ class PluginProcessor : public juce::AudioProcessor {
   void reserveParameterChange(
       const audio::parameter::ParameterVariant& parameter);
 
+  /**
+   * @brief Load a whole patch at once.
+   * @details The audio source applies it at the top of the next block with
+   * the minimum register writes, and parameters are updated to it.
+   * @param[in] patch Tone parameters.
+   * @note It must be called from the message thread.
+   */
+  void applyPatch(const audio::FmParameters& patch);
+
   /**
    * @brief Reset audio source.
    */
   void resetAudioSource() noexcept { shouldResetAudioSource_.store(true); }
 
+  /**
+   * @brief Get statistics of rendering published by the audio thread.
+   * @return Statistics which can be read on any thread.
+   */
+  const audio::RenderStatistics& renderStatistics() const noexcept {
+    return renderStatistics_;
+  }
+
+  /**
+   * @brief Get the meter of output and voices published by the audio thread.
+   * @return Meter, which must be read from only one thread.
+   */
+  audio::OutputMeter& outputMeter() noexcept;
+
  private:
   //============================================================================
 
   /// Redux store.
-  std::shared_ptr<PluginStore<PluginState, PluginAction>> store_;
+  std::shared_ptr<PluginStore<PluginState, PluginAction, PluginReducer>>
+      store_;
 
   /// Parameters of plugin.
   juce::AudioProcessorValueTreeState parameters_;
@@ -91,16 +122,76 @@ class PluginProcessor : public juce::AudioProcessor {
   std::unique_ptr<audio::FmAudioSource> audioSource_;
 
   /// Resampler.
-  std::unique_ptr<juce::ResamplingAudioSource> resampler_;
+  std::unique_ptr<audio::PolyphaseResampler> resampler_;
+
+  /// Raw value of the index of quality choices.
+  std::atomic<float>* quality_{};
 
-  std::mutex parameterQueueMutex_;
+  /// Raw value of whether the DC blocker of the output stage is enabled.
+  std::atomic<float>* isDcBlockerEnabled_{};
 
-  /// Queue storing notifications of parameter change.
+  /// Raw value of the master gain of the output stage in decibels.
+  std::atomic<float>* outputGain_{};
+
+  /// Raw value of whether the soft clipper of the output stage is enabled.
+  std::atomic<float>* isSoftClipEnabled_{};
+
+  /// Raw value of the number of emulator instances, which is applied when the
+  /// plugin is prepared.
+  std::atomic<float>* chipCount_{};
+
+  /// Raw value of whether chips are rendered in parallel on worker threads.
+  std::atomic<float>* isParallelRenderingEnabled_{};
+
+  /// Queue storing notifications of parameter change. It is lock-free because
+  /// it is filled by listener threads and drained by the audio thread.
   audio::parameter::ParameterChangeQueue parameterChangeQueue_;
 
   /// Flag that an audio source should be reset.
   std::atomic_bool shouldResetAudioSource_;
 
+  /// Patch which the audio thread should apply.
+  audio::FmParameters pendingPatch_;
+
+  /// Lock of @c pendingPatch_. The audio thread only tries to acquire it.
+  juce::SpinLock pendingPatchLock_;
+
+  /// Whether @c pendingPatch_ is not applied yet.
+  std::atomic_bool hasPendingPatch_{};
+
+  /// Patches switched by program change.
+  audio::PatchBank patchBank_;
+
+  /// Index of the current program.
+  std::atomic_int currentProgram_{};
+
+  /// Program which the audio thread should switch to, or -1 if none.
+  std::atomic_int pendingProgram_{-1};
+
+  /// Whether a MIDI program change is not reflected to parameters yet.
+  std::atomic_bool isProgramChangedByMidi_{};
+
+  /// MIDI events of the current block, which is used only by the audio thread.
+  audio::MidiEventBatch midiEvents_;
+
+  /// Statistics of blocks published for the editor and external readers.
+  audio::RenderStatistics renderStatistics_;
+
+  /// Statistics of the current block, which is used only by the audio thread.
+  audio::BlockStatistics blockStatistics_;
+
+  /**
+   * @brief Pass a whole patch to the audio source without updating parameters.
+   * @param[in] patch Tone parameters applied at the top of the next block.
+   */
+  void reservePatch(const audio::FmParameters& patch);
+
+  /**
+   * @brief Apply changes requested from other threads on the message thread.
+   * @details Parameters are updated to the program switched by MIDI.
+   */
+  void handleAsyncUpdate() override;
+
   /**
    * @brief Fill generated samples to given buffer.
    * @param[in] buffer Zero-padded buffer which is stored samples.
@@ -109,5 +200,23 @@ class PluginProcessor : public juce::AudioProcessor {
   void fillBuffer(juce::AudioBuffer<float>& buffer,
                   juce::MidiBuffer& midiMessages);
 
+  /**
+   * @brief Reserve changes of parameters and MIDI events in the current block.
+   * @param[in] midiMessages Received MIDI messages.
+   * @param[in] isTimestamped Whether MIDI events are reserved at their sample
+   * positions. Otherwise they are reserved at the top of the block.
+   */
+  void reserveChanges(const juce::MidiBuffer& midiMessages, bool isTimestamped);
+
+  /**
+   * @brief Convert a sample position in the current block to timestamp of
+   * audio source.
+   * @details It follows the frames which the resampler consumes, so events
+   * keep their spacing however long the host plays.
+   * @param[in] samplePosition Sample position in host sample rate.
+   * @return Sample index in synthesis rate.
+   */
+  std::uint64_t synthesisTimestampAt(int samplePosition) const noexcept;
+
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginProcessor)
 };
@@ -3,26 +3,22 @@
 
 #include "reducer.h"
 
-PluginState PluginReducer::operator()(
-    [[maybe_unused]] const PluginState& oldState, const PluginAction& action) {
-  PluginState newState{};
-
-  switch (action.type) {
-    using enum PluginAction::Type;
-
-    default:
-    case InvalidAction:
-      break;
-
-    case CurrentEditingOperatorChanged:
-      if (action.payload.type() ==
-          typeid(decltype(newState.envelopeGraphFrontSlot))) {
-        newState.envelopeGraphFrontSlot =
-            std::any_cast<decltype(newState.envelopeGraphFrontSlot)>(
-                action.payload);
-      }
-      break;
-  }
+namespace {
+/**
+ * @brief Reflect change of the operator which is edited.
+ * @param[in,out] state State.
+ * @param[in] action Action.
+ */
+void reduce(PluginState& state,
+            const action::CurrentEditingOperatorChanged& action) noexcept {
+  state.envelopeGraphFrontSlot = action.slot;
+}
+}  // namespace
 
+PluginState PluginReducer::operator()(
+    const PluginState& oldState, const PluginAction& action) const {
+  PluginState newState = oldState;
+  std::visit([&newState](const auto& typed) { reduce(newState, typed); },
+             action);
   return newState;
 }
@@ -3,8 +3,6 @@
 
 #pragma once
 
-#include <variant>
-
 #include "action.h"
 #include "state.h"
 
@@ -19,5 +17,5 @@ struct PluginReducer {
    * @return New state changed from \c oldState by handling @c action.
    */
   PluginState operator()(const PluginState& oldState,
-                         const PluginAction& action);
+                         const PluginAction& action) const;
 };
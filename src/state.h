@@ -8,4 +8,6 @@
 /// State of plugin except for plugin parameters.
 struct PluginState {
   std::size_t envelopeGraphFrontSlot{};
+
+  bool operator==(const PluginState&) const = default;
 };
@@ -4,58 +4,132 @@
 #pragma once
 
 #include <concepts>
-#include <functional>
+#include <memory>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 /**
  * @brief Store class.
- * @tparam State State class.
- * @tparam Action Action class which needs to have two members: @c type and \c
- * payload.
+ * @details Actions are alternatives of @c Action, which is typically a
+ * @c std::variant, and the reducer is called without type erasure. Dispatch
+ * does not allocate memory as long as @c State does not.
+ *
+ * Each subscriber selects a slice of the state, and it is notified only when
+ * the slice is changed.
+ * @tparam State State class. It must be equality comparable to subscribe the
+ * whole state.
+ * @tparam Action Action class.
+ * @tparam Reducer Reducer functor which returns a new state from a state and
+ * an action.
  */
-template <class State, class Action>
-  requires requires(Action a) {
-    a.type;
-    a.payload;
-  }
+template <std::copyable State, class Action, class Reducer>
+  requires std::is_invocable_r_v<State, const Reducer&, const State&,
+                                 const Action&>
 class PluginStore {
  public:
   /**
-   * @brief Construct a new Plugin Store object
-   * @param[in] reducer
+   * @brief Constructor.
+   * @param[in] reducer Reducer.
    */
-  PluginStore(std::function<State(const State&, const Action&)> reducer)
-      : reducer_(reducer) {}
+  explicit PluginStore(Reducer reducer = Reducer{})
+      : reducer_(std::move(reducer)) {}
 
   /**
-   * @brief Subscribe state changes.
-   * @param[in] callback Function called when the state is changed. Note that
-   * there is no guarantee that this callback will be invoked in the message
-   * thread.
+   * @brief Get the current state.
+   * @return State.
    */
-  void subscribe(std::function<void(const State&)> callback) {
-    subscribers_.emplace_back(std::move(callback));
+  const State& state() const noexcept { return state_; }
+
+  /**
+   * @brief Subscribe changes of a slice of the state.
+   * @param[in] selector Function which returns the slice from a state. The
+   * slice must be equality comparable.
+   * @param[in] callback Function called with the new state when the slice is
+   * changed. Note that there is no guarantee that this callback will be
+   * invoked in the message thread.
+   */
+  template <class Selector, class Callback>
+    requires std::equality_comparable<
+                 std::invoke_result_t<const Selector&, const State&>> &&
+             std::invocable<Callback&, const State&>
+  void subscribe(Selector&& selector, Callback&& callback) {
+    subscribers_.emplace_back(
+        std::make_unique<
+            Subscriber<std::decay_t<Selector>, std::decay_t<Callback>>>(
+            std::forward<Selector>(selector),
+            std::forward<Callback>(callback)));
   }
 
   /**
-   * @brief Dispatch an acton to update the state.
-   * @param[in] action Dispatched action.
+   * @brief Subscribe changes of the whole state.
+   * @param[in] callback Function called with the new state when the state is
+   * changed.
    */
-  void dispatch(const Action& action) {
-    if (!reducer_) {
-      return;
-    }
+  template <class Callback>
+    requires std::equality_comparable<State> &&
+             std::invocable<Callback&, const State&>
+  void subscribe(Callback&& callback) {
+    subscribe([](const State& state) -> const State& { return state; },
+              std::forward<Callback>(callback));
+  }
 
-    state_ = reducer_(state_, action);
+  /**
+   * @brief Dispatch actions to update the state.
+   * @details Actions are reduced in order, and subscribers are notified once
+   * after all of them.
+   * @param[in] actions Dispatched actions.
+   */
+  template <class... Actions>
+    requires(sizeof...(Actions) > 0 &&
+             (std::constructible_from<Action, const Actions&> && ...))
+  void dispatch(const Actions&... actions) {
+    const State oldState = state_;
+    ((state_ = reducer_(state_, Action(actions))), ...);
 
     for (auto& subscriber : subscribers_) {
-      subscriber(state_);
+      subscriber->notify(oldState, state_);
     }
   }
 
  private:
+  /**
+   * @brief Interface of subscribers.
+   */
+  struct SubscriberBase {
+    virtual ~SubscriberBase() = default;
+
+    /**
+     * @brief Call the callback if the selected slice is changed.
+     * @param[in] oldState State before dispatch.
+     * @param[in] newState State after dispatch.
+     */
+    virtual void notify(const State& oldState, const State& newState) = 0;
+  };
+
+  /**
+   * @brief Subscriber of a slice.
+   * @tparam Selector Type of selector.
+   * @tparam Callback Type of callback.
+   */
+  template <class Selector, class Callback>
+  struct Subscriber final : public SubscriberBase {
+    Selector selector;  ///< Selector of the slice.
+    Callback callback;  ///< Callback.
+
+    template <class S, class C>
+    Subscriber(S&& selector, C&& callback)
+        : selector(std::forward<S>(selector)),
+          callback(std::forward<C>(callback)) {}
+
+    void notify(const State& oldState, const State& newState) override {
+      if (!(selector(oldState) == selector(newState))) {
+        callback(newState);
+      }
+    }
+  };
+
   State state_;
-  std::function<State(const State&, const Action&)> reducer_;
-  std::vector<std::function<void(const State&)>> subscribers_;
+  const Reducer reducer_;
+  std::vector<std::unique_ptr<SubscriberBase>> subscribers_;
 };
@@ -3,6 +3,8 @@
 
 #include "algorithm_graph.h"
 
+#include <algorithm>
+#include <memory>
 #include <tuple>
 
 #include "../audio/parameter/parameter.h"
@@ -38,52 +40,89 @@ const std::pair<const char*, int>
                        BinaryData::algorithm8_svgSize)};
 }  // namespace
 
+/**
+ * @brief SVG images of all algorithms whose colours are replaced.
+ */
+class AlgorithmGraph::SvgDrawables {
+  static_assert(std::size(kAlgorithmSvgs) == kAlgorithmCount);
+
+ public:
+  SvgDrawables() {
+    for (std::size_t i = 0; i < kAlgorithmCount; ++i) {
+      auto& svg = drawables_[i];
+      svg = std::apply(juce::Drawable::createFromImageData, kAlgorithmSvgs[i]);
+
+      for (std::size_t slot = 0; slot < audio::kSlotCount; ++slot) {
+        svg->replaceColour(colour::graph::algorithm::kSvgStrokeSlot[slot],
+                           colour::graph::kSlot[slot].withAlpha(
+                               colour::graph::kSlotStrokeAlpha));
+        svg->replaceColour(colour::graph::algorithm::kSvgFillSlot[slot],
+                           colour::graph::kSlot[slot].withAlpha(
+                               colour::graph::kSlotFillAlpha));
+      }
+      svg->replaceColour(colour::graph::algorithm::kSvgStrokeOut,
+                         colour::graph::algorithm::kOut.withAlpha(
+                             colour::graph::kSlotStrokeAlpha));
+      svg->replaceColour(colour::graph::algorithm::kSvgFillOut,
+                         colour::graph::algorithm::kOut.withAlpha(
+                             colour::graph::kSlotFillAlpha));
+    }
+  }
+
+  /**
+   * @brief Get SVG image of an algorithm.
+   * @param[in] index Index of algorithm.
+   * @return Drawable.
+   */
+  const juce::Drawable& operator[](std::size_t index) const {
+    return *drawables_[index];
+  }
+
+ private:
+  std::array<std::unique_ptr<juce::Drawable>, kAlgorithmCount> drawables_;
+};
+
 AlgorithmGraph::AlgorithmGraph(juce::AudioProcessorValueTreeState& parameters)
     : parameters_(parameters) {
   update();
 }
 
-void AlgorithmGraph::update() {
-  removeAllChildren();
+AlgorithmGraph::~AlgorithmGraph() = default;
 
+void AlgorithmGraph::update() {
   const auto al =
       audio::parameter::parameterCast<audio::parameter::AlgorithmValue>(
           parameters_
               .getRawParameterValue(audio::parameter::idAsString(
                   audio::parameter::FmToneParameter::Al))
               ->load());
-  const auto index = al.rawValue() - audio::parameter::AlgorithmValue::kMinimum;
-  svg_ = std::apply(juce::Drawable::createFromImageData, kAlgorithmSvgs[index]);
-
-  for (std::size_t slot = 0; slot < audio::kSlotCount; ++slot) {
-    svg_->replaceColour(
-        colour::graph::algorithm::kSvgStrokeSlot[slot],
-        colour::graph::kSlot[slot].withAlpha(colour::graph::kSlotStrokeAlpha));
-    svg_->replaceColour(
-        colour::graph::algorithm::kSvgFillSlot[slot],
-        colour::graph::kSlot[slot].withAlpha(colour::graph::kSlotFillAlpha));
-  }
-  svg_->replaceColour(colour::graph::algorithm::kSvgStrokeOut,
-                      colour::graph::algorithm::kOut.withAlpha(
-                          colour::graph::kSlotStrokeAlpha));
-  svg_->replaceColour(
-      colour::graph::algorithm::kSvgFillOut,
-      colour::graph::algorithm::kOut.withAlpha(colour::graph::kSlotFillAlpha));
-
-  addAndMakeVisible(svg_.get());
+  algorithmIndex_ = static_cast<std::size_t>(
+      al.rawValue() - audio::parameter::AlgorithmValue::kMinimum);
 
-  resized();
+  repaint();
 }
 
 void AlgorithmGraph::paint(juce::Graphics& graphics) {
   graphics.fillAll(colour::graph::kBackground);
-}
 
-void AlgorithmGraph::resized() {
-  if (!svg_) {
+  if (imageBounds_.isEmpty()) {
     return;
   }
 
+  const float scale =
+      graphics.getInternalContext().getPhysicalPixelScaleFactor();
+  if (imageScale_ != scale) {
+    std::ranges::fill(images_, juce::Image{});
+    imageScale_ = scale;
+  }
+  if (!images_[algorithmIndex_].isValid()) {
+    renderImage(scale);
+  }
+
+  graphics.drawImage(images_[algorithmIndex_], imageBounds_);
+}
+
+void AlgorithmGraph::resized() {
   constexpr int padding{10};
   const auto localBounds = getLocalBounds().reduced(padding).toFloat();
 
@@ -92,10 +131,30 @@ void AlgorithmGraph::resized() {
       localBounds.getHeight() / kMaxSvgSize.getHeight();
   const auto scale = juce::jmin(widthProportion, heightProportion);
 
-  const auto originalSvgBounds = svg_->getDrawableBounds();
+  // All images have the same size, so they are rendered again in the size.
+  imageBounds_ = kMaxSvgSize.transformedBy(juce::AffineTransform::scale(scale))
+                     .withCentre(localBounds.getCentre());
+  std::ranges::fill(images_, juce::Image{});
+}
+
+void AlgorithmGraph::renderImage(float scale) {
+  const auto& svg = (*drawables_)[algorithmIndex_];
+
+  auto& image = images_[algorithmIndex_];
+  image = juce::Image(
+      juce::Image::ARGB,
+      juce::jmax(1, juce::roundToInt(imageBounds_.getWidth() * scale)),
+      juce::jmax(1, juce::roundToInt(imageBounds_.getHeight() * scale)),
+      true);
+
+  juce::Graphics graphics(image);
+  const auto imageArea = image.getBounds().toFloat();
   const auto scaledViewBox =
-      originalSvgBounds.transformedBy(juce::AffineTransform::scale(scale))
-          .withCentre(localBounds.getCentre());
-  svg_->setTransformToFit(scaledViewBox, juce::RectanglePlacement::centred);
+      svg.getDrawableBounds()
+          .transformedBy(juce::AffineTransform::scale(
+              imageArea.getWidth() / kMaxSvgSize.getWidth()))
+          .withCentre(imageArea.getCentre());
+  svg.drawWithin(graphics, scaledViewBox, juce::RectanglePlacement::centred,
+                 1.f);
 }
 }  // namespace ui
@@ -5,11 +5,15 @@
 
 #include <JuceHeader.h>
 
-#include <memory>
+#include <array>
+#include <cstddef>
 
 namespace ui {
 /**
  * @brief Graph displayed FM algorithm.
+ * @details SVG images are parsed once and shared by all instances. The
+ * displayed one is rasterised for the current size and pixel scale, and the
+ * image is reused until the graph is resized.
  */
 class AlgorithmGraph : public juce::Component {
  public:
@@ -19,6 +23,11 @@ class AlgorithmGraph : public juce::Component {
    */
   AlgorithmGraph(juce::AudioProcessorValueTreeState& parameters);
 
+  /**
+   * @brief Destructor.
+   */
+  ~AlgorithmGraph() override;
+
   /**
    * @brief Update displayed image.
    */
@@ -28,10 +37,34 @@ class AlgorithmGraph : public juce::Component {
   void resized() override;
 
  private:
+  /// The number of algorithms.
+  static constexpr std::size_t kAlgorithmCount{8};
+
+  /// SVG images of all algorithms shared by instances.
+  class SvgDrawables;
+
   /// Parameters of plugin.
   juce::AudioProcessorValueTreeState& parameters_;
 
-  /// Displayed SVG image.
-  std::unique_ptr<juce::Drawable> svg_;
+  /// Parsed SVG images.
+  juce::SharedResourcePointer<SvgDrawables> drawables_;
+
+  /// Index of the displayed algorithm.
+  std::size_t algorithmIndex_{};
+
+  /// Rasterised images of algorithms, or invalid images if not rendered yet.
+  std::array<juce::Image, kAlgorithmCount> images_;
+
+  /// Physical pixel scale which @c images_ are rendered at.
+  float imageScale_{};
+
+  /// Area where the image is drawn.
+  juce::Rectangle<float> imageBounds_;
+
+  /**
+   * @brief Rasterise the displayed SVG image to @c images_.
+   * @param[in] scale Physical pixel scale.
+   */
+  void renderImage(float scale);
 };
 }  // namespace ui
@@ -33,6 +33,13 @@ inline const auto kOut = juce::Colour::fromHSL(0.f, 0.f, 0.7f, 1.f);
 }  // namespace algorithm
 }  // namespace graph
 
+namespace meter {
+inline const auto kRms = juce::Colour::fromHSL(.42f, .50f, .40f, 1.f);
+inline const auto kPeak = juce::Colour::fromHSL(.42f, .70f, .60f, 1.f);
+inline const auto kClip = juce::Colour::fromHSL(0.f, .80f, .55f, 1.f);
+inline const auto kVoice = juce::Colour::fromHSL(.60f, .70f, .60f, 1.f);
+}  // namespace meter
+
 namespace tab {
 inline const juce::Colour kSlot[audio::kSlotCount]{
     juce::Colour::fromHSL(.42f, .30f, .30f, 1.f),
@@ -6,10 +6,8 @@
 #include <algorithm>
 #include <cstdint>
 #include <map>
-#include <numeric>
 #include <type_traits>
 #include <utility>
-#include <vector>
 
 #include "../util.h"
 #include "colour.h"
@@ -121,7 +119,7 @@ void EnvelopeGraph::mouseDrag(const juce::MouseEvent& event) {
       onController4Dragged(draggingTopLeftPosition);
     }
 
-    repaint();
+    // The graph is repainted when parameter changes are notified.
   } else {
     juce::Component::mouseDrag(event);
   }
@@ -338,11 +336,35 @@ void EnvelopeGraph::updateControllerPosition() {
     updateTopLeftPositionOfController2(slot, topLeftBounds);
     updateTopLeftPositionOfController3(slot, topLeftBounds);
     updateTopLeftPositionOfController4(slot, topLeftBounds);
+    updateEnvelopePath(slot);
   }
 
+  backImage_ = {};
   repaint();
 }
 
+void EnvelopeGraph::updateControllerPosition(std::size_t slot) {
+  if (audio::kSlotCount <= slot) {
+    return;
+  }
+
+  const auto topLeftBounds = getLocalBounds().transformedBy(kControllerShift);
+  const auto oldBounds = envelopePaths_[slot].bounds;
+
+  updateTopLeftPositionOfController1(slot, topLeftBounds);
+  updateTopLeftPositionOfController2(slot, topLeftBounds);
+  updateTopLeftPositionOfController3(slot, topLeftBounds);
+  updateTopLeftPositionOfController4(slot, topLeftBounds);
+  updateEnvelopePath(slot);
+
+  if (slot != frontSlot_) {
+    backImage_ = {};
+  }
+
+  // Repaint the area where the envelope was and is.
+  repaint(oldBounds.getUnion(envelopePaths_[slot].bounds));
+}
+
 void EnvelopeGraph::updateTopLeftPositionOfController1(
     std::size_t slot, const juce::Rectangle<int>& topLeftBounds) {
   auto& controller1 = controllers_[slot][0];
@@ -512,84 +534,105 @@ void EnvelopeGraph::updateTopLeftPositionOfController4(
 }
 
 void EnvelopeGraph::paint(juce::Graphics& graphics) {
-  // Background.
-  graphics.fillAll(colour::graph::kBackground);
+  const float scale =
+      graphics.getInternalContext().getPhysicalPixelScaleFactor();
+  if (!backImage_.isValid() || backImageScale_ != scale) {
+    renderBackImage(scale);
+  }
+  graphics.drawImage(backImage_, getLocalBounds().toFloat());
+
+  // Front envelope.
+  const auto& envelope = envelopePaths_[frontSlot_];
+  const auto linkColour = linkColourOf(frontSlot_);
+  graphics.setColour(linkColour);
+  graphics.strokePath(
+      envelope.stroke,
+      juce::PathStrokeType{linkStrokeThicknessList_[frontSlot_]});
+
+  const auto gradientColour = [&] {
+    const auto peakY =
+        visibleControllers_[0]->getBounds().toFloat().getCentreY();
+    auto gradient = juce::ColourGradient::vertical(
+        colour::graph::kBackground, static_cast<float>(getHeight()),
+        linkColour, peakY);
+    gradient.multiplyOpacity(
+        colour::graph::kEnvelopeFillGradientOpacityMultiply);
+    return gradient;
+  }();
+  graphics.setGradientFill(gradientColour);
+  graphics.fillPath(envelope.fill);
+}
 
+void EnvelopeGraph::updateEnvelopePath(std::size_t slot) {
   // Flip y-axis for convenience.
   const auto flipYAxis =
       juce::AffineTransform::verticalFlip(static_cast<float>(getHeight()));
-  graphics.addTransform(flipYAxis);
-
-  const auto sortedSlotIndices = [&] {
-    auto itr = std::ranges::find_if(controllers_, [&](auto&& cs) {
-      return cs[0] == visibleControllers_[0];
-    });
-    const auto visibleIndex =
-        static_cast<size_t>(std::distance(std::begin(controllers_), itr));
-    std::array<std::size_t, kControllerCount_> indices;
-    std::iota(std::begin(indices), std::end(indices), 0u);
-    std::ranges::remove(indices, visibleIndex).front() = visibleIndex;
-    return indices;
-  }();
 
-  for (std::size_t slot : sortedSlotIndices) {
-    const auto& controllers = controllers_[slot];
-
-    std::vector<juce::Point<float>> points;
-    std::ranges::transform(
-        controllers, std::back_inserter(points),
-        [&flipYAxis](auto&& controller) {
-          return controller->getBounds().toFloat().getCentre().transformedBy(
-              flipYAxis);
-        });
-
-    // Envelope.
-    juce::Path envelopePath;
-    envelopePath.startNewSubPath({});
-    // Draw a line as cubic-bezier, but actual Attack is exponential change.
-    envelopePath.cubicTo(points[0].x * .5f, points[0].y * .8f,
-                         points[0].x * .7f, points[0].y, points[0].x,
-                         points[0].y);
-    envelopePath.lineTo(points[1]);
-    envelopePath.lineTo(points[2]);
-    envelopePath.lineTo(points[3]);
-
-    const float strokeThickness = linkStrokeThicknessList_[slot];
-
-    if (points[3].x == getLocalBounds().toFloat().getRight()) {
-      // Close path to fill colour.
-      const auto outerPoint = points[3].translated(strokeThickness, 0.f);
-      envelopePath.lineTo(outerPoint);
-      envelopePath.lineTo(outerPoint.withY(0.f));
-    }
+  std::array<juce::Point<float>, kControllerCount_> points;
+  std::ranges::transform(
+      controllers_[slot], points.begin(), [&flipYAxis](auto&& controller) {
+        return controller->getBounds().toFloat().getCentre().transformedBy(
+            flipYAxis);
+      });
+
+  auto& envelope = envelopePaths_[slot];
+  auto& path = envelope.stroke;
+  path.clear();
+  path.startNewSubPath({});
+  // Draw a line as cubic-bezier, but actual Attack is exponential change.
+  path.cubicTo(points[0].x * .5f, points[0].y * .8f, points[0].x * .7f,
+               points[0].y, points[0].x, points[0].y);
+  path.lineTo(points[1]);
+  path.lineTo(points[2]);
+  path.lineTo(points[3]);
+
+  const float strokeThickness = linkStrokeThicknessList_[slot];
+
+  if (points[3].x == getLocalBounds().toFloat().getRight()) {
+    // Close path to fill colour.
+    const auto outerPoint = points[3].translated(strokeThickness, 0.f);
+    path.lineTo(outerPoint);
+    path.lineTo(outerPoint.withY(0.f));
+  }
+
+  path.applyTransform(flipYAxis);
+
+  envelope.fill = path;
+  envelope.fill.closeSubPath();
+
+  envelope.bounds =
+      path.getBounds().expanded(strokeThickness).getSmallestIntegerContainer();
+}
+
+void EnvelopeGraph::renderBackImage(float scale) {
+  backImageScale_ = scale;
+  backImage_ = juce::Image(
+      juce::Image::RGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+      juce::jmax(1, juce::roundToInt(getHeight() * scale)), false);
+
+  juce::Graphics graphics(backImage_);
+  graphics.addTransform(juce::AffineTransform::scale(scale));
 
-    const auto linkColour = [&] {
-      auto c = colour::graph::kSlot[slot];
-      return (controllers == visibleControllers_)
-                 ? c
-                 : c.withLightness(colour::graph::kBackLightness);
-    }();
-    graphics.setColour(linkColour);
-    graphics.strokePath(envelopePath, juce::PathStrokeType{strokeThickness});
+  // Background.
+  graphics.fillAll(colour::graph::kBackground);
 
-    if (controllers != visibleControllers_) {
+  for (std::size_t slot = 0u; slot < audio::kSlotCount; ++slot) {
+    if (slot == frontSlot_) {
       continue;
     }
 
-    const auto gradientColour = [linkColour,
-                                 y = static_cast<float>(points[0].y)] {
-      auto gradient = juce::ColourGradient::vertical(colour::graph::kBackground,
-                                                     0.f, linkColour, y);
-      gradient.multiplyOpacity(
-          colour::graph::kEnvelopeFillGradientOpacityMultiply);
-      return gradient;
-    }();
-    graphics.setGradientFill(gradientColour);
-    envelopePath.closeSubPath();
-    graphics.fillPath(envelopePath);
+    graphics.setColour(linkColourOf(slot));
+    graphics.strokePath(envelopePaths_[slot].stroke,
+                        juce::PathStrokeType{linkStrokeThicknessList_[slot]});
   }
 }
 
+juce::Colour EnvelopeGraph::linkColourOf(std::size_t slot) const {
+  const auto c = colour::graph::kSlot[slot];
+  return (slot == frontSlot_) ? c
+                              : c.withLightness(colour::graph::kBackLightness);
+}
+
 void EnvelopeGraph::resized() {
   const auto quarterWidth = getWidth() / 4;
 
@@ -626,10 +669,17 @@ void EnvelopeGraph::setFrontEnvelopeOperator(std::size_t slot) {
 
     if (isVisible) {
       visibleControllers_ = controllers_[i];
+      frontSlot_ = i;
     }
 
     linkStrokeThicknessList_[i] =
         isVisible ? stroke_thickness::kFrontLink : stroke_thickness::kBackLink;
   }
+
+  // Thickness of links changes the paths.
+  for (std::size_t i = 0u; i < audio::kSlotCount; ++i) {
+    updateEnvelopePath(i);
+  }
+  backImage_ = {};
 }
 }  // namespace ui
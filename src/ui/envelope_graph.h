@@ -105,6 +105,10 @@ class ControlPoint : public juce::Component {
  *
  * When Release Rate is 0 (the minimum value), it is placed at the right end of
  * the graph at the same hight as C3.
+ *
+ * Paths of envelopes are cached, and envelopes behind the front one are
+ * rasterised into an image with the background. A parameter change rebuilds
+ * only the path of its operator and repaints the area it covers.
  */
 class EnvelopeGraph : public juce::Component {
  public:
@@ -124,6 +128,13 @@ class EnvelopeGraph : public juce::Component {
    */
   void updateControllerPosition();
 
+  /**
+   * @brief Update position of controllers of an operator following parameter
+   * values of plugin.
+   * @param[in] slot Operator number.
+   */
+  void updateControllerPosition(std::size_t slot);
+
   /**
    * @brief Update state.
    * @param[in] state State.
@@ -140,6 +151,15 @@ class EnvelopeGraph : public juce::Component {
  private:
   static constexpr std::size_t kControllerCount_{4u};
 
+  /**
+   * @brief Cached paths of an envelope in local coordinates.
+   */
+  struct EnvelopePath {
+    juce::Path stroke;              ///< Path of the envelope line.
+    juce::Path fill;                ///< Closed path to fill under the line.
+    juce::Rectangle<int> bounds{};  ///< Area to repaint the envelope.
+  };
+
   /// Parameters of plugin.
   juce::AudioProcessorValueTreeState& parameters_;
 
@@ -159,6 +179,18 @@ class EnvelopeGraph : public juce::Component {
   /// List of stroke thickness for envelope line.
   float linkStrokeThicknessList_[audio::kSlotCount]{};
 
+  /// Operator number drawn on the front.
+  std::size_t frontSlot_{};
+
+  /// Envelope paths of operators.
+  std::array<EnvelopePath, audio::kSlotCount> envelopePaths_;
+
+  /// Background and back envelopes, or invalid image if it is outdated.
+  juce::Image backImage_;
+
+  /// Physical pixel scale which @c backImage_ is rendered at.
+  float backImageScale_{};
+
   /// Parameter ID names.
   juce::String frontArId_, frontTlId_, frontDrId_, frontSlId_, frontSrId_,
       frontRrId_;
@@ -223,6 +255,26 @@ class EnvelopeGraph : public juce::Component {
   void updateTopLeftPositionOfController4(
       std::size_t slot, const juce::Rectangle<int>& topLeftBounds);
 
+  /**
+   * @brief Rebuild the cached envelope path of an operator from positions of
+   * its controllers.
+   * @param[in] slot Operator number.
+   */
+  void updateEnvelopePath(std::size_t slot);
+
+  /**
+   * @brief Render the background and back envelopes to @c backImage_.
+   * @param[in] scale Physical pixel scale.
+   */
+  void renderBackImage(float scale);
+
+  /**
+   * @brief Get colour of the envelope line of an operator.
+   * @param[in] slot Operator number.
+   * @return Colour.
+   */
+  juce::Colour linkColourOf(std::size_t slot) const;
+
   /**
    * @brief Set a operator number to draw its envelope on the front.
    * @param[in] slot Operator number.
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "level_meter.h"
+
+#include <algorithm>
+
+#include "colour.h"
+
+namespace ui {
+namespace {
+/// Ratio of the displayed peak kept per refresh.
+constexpr float kPeakFallRatio{.9f};
+
+/// The lowest level displayed by bars in decibels.
+constexpr float kMinDecibels{-60.f};
+
+/// Height of a level bar in pixels.
+constexpr int kBarHeight{4};
+
+/// Gap between elements in pixels.
+constexpr int kGap{2};
+
+/**
+ * @brief Convert a linear level to the proportion of a bar.
+ * @param[in] level Linear level.
+ * @return Proportion from 0 to 1.
+ */
+float proportionOf(float level) {
+  const float decibels = juce::Decibels::gainToDecibels(level, kMinDecibels);
+  return juce::jmap(decibels, kMinDecibels, 0.f, 0.f, 1.f);
+}
+}  // namespace
+
+LevelMeter::LevelMeter(audio::OutputMeter& meter) : meter_(meter) {
+  setInterceptsMouseClicks(false, false);
+  startTimerHz(kRefreshRateHz);
+}
+
+LevelMeter::~LevelMeter() { stopTimer(); }
+
+void LevelMeter::paint(juce::Graphics& graphics) {
+  graphics.fillAll(colour::graph::kBackground);
+
+  auto area = getLocalBounds();
+
+  // Level bars.
+  for (std::size_t ch = 0; ch < heldPeak_.size(); ++ch) {
+    const auto bar = area.removeFromTop(kBarHeight).toFloat();
+    area.removeFromTop(kGap);
+
+    graphics.setColour(colour::meter::kRms);
+    graphics.fillRect(
+        bar.withWidth(bar.getWidth() * proportionOf(frame_.rms[ch])));
+
+    graphics.setColour(heldPeak_[ch] < 1.f ? colour::meter::kPeak
+                                           : colour::meter::kClip);
+    const float peakX =
+        bar.getX() + bar.getWidth() * proportionOf(heldPeak_[ch]);
+    graphics.fillRect(
+        bar.withX(juce::jmax(bar.getX(), peakX - 1.f)).withWidth(1.f));
+  }
+
+  // Voices.
+  if (!frame_.voiceCount) {
+    return;
+  }
+
+  const float cellWidth =
+      static_cast<float>(area.getWidth() + kGap) / frame_.voiceCount;
+  for (std::size_t voice = 0; voice < frame_.voiceCount; ++voice) {
+    const auto cell = area.toFloat()
+                          .withX(area.getX() + cellWidth * voice)
+                          .withWidth(cellWidth - kGap);
+
+    graphics.setColour(colour::meter::kVoice.withAlpha(
+        frame_.voiceLevels[voice] / 255.f));
+    graphics.fillRect(cell);
+
+    if ((frame_.keyOnVoiceMask >> voice) & 1u) {
+      graphics.setColour(colour::meter::kVoice);
+      graphics.drawRect(cell);
+    }
+  }
+}
+
+void LevelMeter::timerCallback() {
+  frame_ = meter_.read();
+
+  for (std::size_t ch = 0; ch < heldPeak_.size(); ++ch) {
+    heldPeak_[ch] = std::max(frame_.peak[ch], heldPeak_[ch] * kPeakFallRatio);
+  }
+
+  repaint();
+}
+}  // namespace ui
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+
+#include "../audio/output_meter.h"
+
+namespace ui {
+/**
+ * @brief Meter of output levels and activity of voices.
+ * @details Bars show RMS and peak of left and right channels, and cells show
+ * envelope levels of voices with outlines while they are keyed on. Frames are
+ * read from the meter by a timer, so the audio thread never waits.
+ */
+class LevelMeter : public juce::Component, private juce::Timer {
+ public:
+  /**
+   * @brief Constructor.
+   * @param[in] meter Meter published by the audio thread.
+   */
+  explicit LevelMeter(audio::OutputMeter& meter);
+
+  /**
+   * @brief Destructor.
+   */
+  ~LevelMeter() override;
+
+  void paint(juce::Graphics& graphics) override;
+
+ private:
+  /// Refresh rate of the meter.
+  static constexpr int kRefreshRateHz{30};
+
+  /// Meter published by the audio thread.
+  audio::OutputMeter& meter_;
+
+  /// The latest frame.
+  audio::MeterFrame frame_;
+
+  /// Displayed peaks of left and right, which fall gradually.
+  std::array<float, 2> heldPeak_{};
+
+  /**
+   * @brief Read the latest frame and repaint.
+   */
+  void timerCallback() override;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LevelMeter)
+};
+}  // namespace ui
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include "ui_sync_hub.h"
+
+#include <bit>
+
+namespace {
+/**
+ * @brief Get a bit of an index in its word.
+ * @param[in] index Index of an entry.
+ * @return Bit mask.
+ */
+constexpr std::uint64_t bitOf(std::size_t index) noexcept {
+  return std::uint64_t{1} << (index % 64u);
+}
+}  // namespace
+
+UiSyncHub::UiSyncHub() { startTimerHz(kRefreshRateHz); }
+
+UiSyncHub::~UiSyncHub() { stopTimer(); }
+
+std::optional<std::size_t> UiSyncHub::add(std::function<void()> callback) {
+  JUCE_ASSERT_MESSAGE_THREAD
+
+  if (!freeIndices_.empty()) {
+    const std::size_t index = freeIndices_.back();
+    freeIndices_.pop_back();
+    callbacks_[index] = std::move(callback);
+    return index;
+  }
+
+  if (callbacks_.size() == kMaxEntryCount) {
+    return std::nullopt;
+  }
+
+  callbacks_.emplace_back(std::move(callback));
+  return callbacks_.size() - 1u;
+}
+
+void UiSyncHub::remove(std::size_t index) {
+  JUCE_ASSERT_MESSAGE_THREAD
+
+  callbacks_[index] = nullptr;
+  dirtyWords_[index / 64u].fetch_and(~bitOf(index), std::memory_order_relaxed);
+  freeIndices_.push_back(index);
+}
+
+void UiSyncHub::markDirty(std::size_t index) noexcept {
+  dirtyWords_[index / 64u].fetch_or(bitOf(index), std::memory_order_release);
+}
+
+void UiSyncHub::timerCallback() {
+  const std::size_t usedWordCount = (callbacks_.size() + 63u) / 64u;
+  for (std::size_t word = 0; word < usedWordCount; ++word) {
+    if (!dirtyWords_[word].load(std::memory_order_relaxed)) {
+      continue;
+    }
+
+    std::uint64_t bits =
+        dirtyWords_[word].exchange(0u, std::memory_order_acquire);
+    while (bits) {
+      const std::size_t index =
+          word * 64u + static_cast<std::size_t>(std::countr_zero(bits));
+      bits &= bits - 1u;
+
+      // Callback may add or remove entries, so call a copy.
+      if (const auto callback = callbacks_[index]) {
+        callback();
+      }
+    }
+  }
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief Hub which runs UI updates requested from other threads once a frame.
+ * @details Requests are flagged in a lock-free bitset, so requesting from the
+ * audio thread neither allocates nor posts messages, and requests of the same
+ * entry in a frame are coalesced into one call. It is intended to be shared
+ * with @c juce::SharedResourcePointer.
+ */
+class UiSyncHub : private juce::Timer {
+ public:
+  /// Maximum number of entries.
+  static constexpr std::size_t kMaxEntryCount{4096};
+
+  /// The number of frames per second.
+  static constexpr int kRefreshRateHz{60};
+
+  UiSyncHub();
+  ~UiSyncHub() override;
+
+  /**
+   * @brief Add an entry.
+   * @param[in] callback Function called in the message thread when the entry
+   * is marked.
+   * @return Index of the entry, or @c std::nullopt if the hub is full.
+   * @note It must be called from the message thread.
+   */
+  std::optional<std::size_t> add(std::function<void()> callback);
+
+  /**
+   * @brief Remove an entry.
+   * @param[in] index Index of the entry.
+   * @note It must be called from the message thread.
+   */
+  void remove(std::size_t index);
+
+  /**
+   * @brief Request to call the callback of an entry in the next frame.
+   * @param[in] index Index of the entry.
+   * @note It can be called from any thread.
+   */
+  void markDirty(std::size_t index) noexcept;
+
+ private:
+  /// The number of words of the bitset.
+  static constexpr std::size_t kWordCount{kMaxEntryCount / 64u};
+
+  /// Flags of entries which should be updated.
+  std::array<std::atomic<std::uint64_t>, kWordCount> dirtyWords_{};
+
+  /// Callbacks of entries. Empty one means unused.
+  std::vector<std::function<void()>> callbacks_;
+
+  /// Indices of removed entries to reuse.
+  std::vector<std::size_t> freeIndices_;
+
+  /**
+   * @brief Call callbacks of marked entries.
+   */
+  void timerCallback() override;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UiSyncHub)
+};
@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include <JuceHeader.h>
+#include <ymfm_opn.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "audio/fm_chip.h"
+#include "audio/fm_only_ym2608.h"
+#include "audio/register.h"
+
+namespace {
+/// The number of samples rendered at once, where channels to clock are updated.
+constexpr std::size_t kBlockSampleCount{512};
+
+/// The number of samples of a keyed note.
+constexpr std::size_t kNoteSampleCount{4096};
+
+/// Lengths of silence between notes, from a short gap to several seconds.
+constexpr std::array<std::size_t, 4> kSilenceSampleCounts{512, 16384, 65536,
+                                                          262144};
+
+/// Total level of carriers of an audible note.
+constexpr std::uint8_t kLoudTotalLevel{0x20};
+
+/// Total level of carriers of a note whose output is always zero.
+constexpr std::uint8_t kQuietTotalLevel{0x7f};
+
+/// The number of failed checks.
+int failureCount{};
+
+/**
+ * @brief Report a check.
+ * @param[in] isPassed Whether the check passed.
+ * @param[in] name Name of the check.
+ */
+void check(bool isPassed, const char* name) {
+  std::printf("%s: %s\n", isPassed ? "PASS" : "FAIL", name);
+  if (!isPassed) {
+    ++failureCount;
+  }
+}
+
+/**
+ * @brief Emulator which clocks all FM channels at every sample as reference.
+ */
+class FullEmulator {
+ public:
+  /**
+   * @brief Constructor, which resets the emulator as @c audio::FmChip does.
+   */
+  FullEmulator() : ym2608_(interface_) {
+    ym2608_.set_fidelity(ymfm::opn_fidelity::OPN_FIDELITY_MIN);
+    ym2608_.reset();
+  }
+
+  /**
+   * @brief Write a register.
+   * @param[in] change Register write.
+   */
+  void write(const audio::Register& change) {
+    if (change.pinA1) {
+      ym2608_.write_address_hi(change.address);
+      ym2608_.write_data_hi(change.data);
+    } else {
+      ym2608_.write_address(change.address);
+      ym2608_.write_data(change.data);
+    }
+  }
+
+  /**
+   * @brief Generate samples of all channels.
+   * @param[out] output Buffer to store samples.
+   * @param[in] numSamples The number of samples to generate.
+   */
+  void render(ymfm::ym2608::output_data* output, std::size_t numSamples) {
+    ym2608_.generateFm(output, static_cast<std::uint32_t>(numSamples),
+                       audio::FmOnlyYm2608::kAllChannelMask);
+  }
+
+ private:
+  ymfm::ymfm_interface interface_;  ///< Emulator interface.
+  audio::FmOnlyYm2608 ym2608_;      ///< Emulator.
+};
+
+/**
+ * @brief Renderer which writes the same registers to a chip and the
+ * reference, and compares their outputs.
+ */
+class Comparison {
+ public:
+  /**
+   * @brief Constructor.
+   */
+  Comparison() : chip_(kQueueCapacity) { chip_.reset(); }
+
+  /**
+   * @brief Apply a register write to both immediately.
+   * @param[in] address Address. Bit 8 represents a state of pin A1.
+   * @param[in] data Data to write.
+   */
+  void write(std::uint16_t address, std::uint8_t data) {
+    const audio::Register change(address, data);
+    chip_.reserveUncoalescedWrite(change);
+    chip_.triggerReservedChanges();
+    reference_.write(change);
+  }
+
+  /**
+   * @brief Program channel 1 with all operators as carriers and vibrato.
+   * @param[in] totalLevel Total level of operators.
+   */
+  void writeTone(std::uint8_t totalLevel) {
+    write(0x22u, 0x0bu);  // LFO on
+    write(0xb0u, 0x07u);  // FB 0, AL 7
+    write(0xb4u, 0xc7u);  // L/R, AMS 0, PMS 7
+    for (std::uint16_t slot = 0; slot < 16u; slot += 4u) {
+      write(0x30u + slot, 0x01u);  // DT 0, ML 1
+      write(0x40u + slot, totalLevel);
+      write(0x50u + slot, 0x0cu);  // KS 0, AR 12
+      write(0x60u + slot, 0x05u);  // DR 5
+      write(0x70u + slot, 0x02u);  // SR 2
+      write(0x80u + slot, 0x13u);  // SL 1, RR 3
+    }
+    write(0xa4u, 0x22u);  // Block 4
+    write(0xa0u, 0x69u);
+  }
+
+  /**
+   * @brief Key on all operators of channel 1.
+   */
+  void keyOn() { write(0x28u, 0xf0u); }
+
+  /**
+   * @brief Key off channel 1.
+   */
+  void keyOff() { write(0x28u, 0x00u); }
+
+  /**
+   * @brief Render both in blocks and record whether they differ.
+   * @param[in] numSamples The number of samples.
+   */
+  void render(std::size_t numSamples) {
+    chipOutput_.resize(numSamples);
+    referenceOutput_.resize(numSamples);
+    for (std::size_t top = 0; top < numSamples; top += kBlockSampleCount) {
+      const std::size_t count = std::min(kBlockSampleCount, numSamples - top);
+      chip_.render(chipOutput_.data() + top, count);
+      reference_.render(referenceOutput_.data() + top, count);
+    }
+
+    for (std::size_t i = 0; i < numSamples; ++i) {
+      for (std::size_t ch = 0; ch < 2; ++ch) {
+        if (chipOutput_[i].data[ch] != referenceOutput_[i].data[ch]) {
+          isMatched_ = false;
+        }
+        if (referenceOutput_[i].data[ch]) {
+          isAudible_ = true;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Whether all rendered samples are the same.
+   * @return @c true if outputs have never differed.
+   */
+  bool isMatched() const noexcept { return isMatched_; }
+
+  /**
+   * @brief Whether the reference has output a nonzero sample.
+   * @return @c true if something is audible.
+   */
+  bool isAudible() const noexcept { return isAudible_; }
+
+ private:
+  /// Capacity of the register write queue of the chip.
+  static constexpr std::size_t kQueueCapacity{256};
+
+  audio::FmChip chip_;      ///< Chip skipping finished channels.
+  FullEmulator reference_;  ///< Emulator clocking all channels.
+
+  std::vector<ymfm::ym2608::output_data> chipOutput_;       ///< Chip output.
+  std::vector<ymfm::ym2608::output_data> referenceOutput_;  ///< Reference.
+
+  bool isMatched_{true};  ///< Whether outputs have never differed.
+  bool isAudible_{};      ///< Whether the reference has output a sample.
+};
+
+/**
+ * @brief Check that skipping finished channels and idle chips does not change
+ * a note played after release.
+ * @param[in] firstTotalLevel Total level of the first note.
+ */
+void testNoteAfterRelease(std::uint8_t firstTotalLevel) {
+  bool isMatched{true};
+  bool isAudible{true};
+  for (const std::size_t silenceSampleCount : kSilenceSampleCounts) {
+    Comparison comparison;
+    comparison.writeTone(firstTotalLevel);
+    comparison.keyOn();
+    comparison.render(kNoteSampleCount);
+    comparison.keyOff();
+    comparison.render(silenceSampleCount);
+
+    comparison.writeTone(kLoudTotalLevel);
+    comparison.keyOn();
+    comparison.render(kNoteSampleCount);
+
+    isMatched = isMatched && comparison.isMatched();
+    isAudible = isAudible && comparison.isAudible();
+  }
+
+  check(isAudible, "second note is audible");
+  check(isMatched, firstTotalLevel == kQuietTotalLevel
+                       ? "masked rendering matches after a quiet note"
+                       : "masked rendering matches after a loud note");
+}
+}  // namespace
+
+int main() {
+  testNoteAfterRelease(kLoudTotalLevel);
+  testNoteAfterRelease(kQuietTotalLevel);
+
+  return failureCount ? 1 : 0;
+}
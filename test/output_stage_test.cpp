@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2023 Rerrah
+
+#include <JuceHeader.h>
+#include <ymfm_opn.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+#include "audio/fm_audio_source.h"
+#include "audio/polyphase_resampler.h"
+#include "audio/sample_conversion.h"
+
+namespace {
+namespace sc = audio::sample_conversion;
+
+/// Sample rate of output.
+constexpr double kSampleRate{48000.};
+
+/// Block size of output.
+constexpr int kBlockSize{512};
+
+/// The number of rendered blocks, which is about 0.3 seconds.
+constexpr int kBlockCount{32};
+
+/// Note number of the sustained note.
+constexpr int kNoteNumber{57};
+
+/// Tolerance of relative error between outputs.
+constexpr float kTolerance{1e-4f};
+
+/// The number of failed checks.
+int failureCount{};
+
+/**
+ * @brief Report a check.
+ * @param[in] isPassed Whether the check passed.
+ * @param[in] name Name of the check.
+ */
+void check(bool isPassed, const char* name) {
+  std::printf("%s: %s\n", isPassed ? "PASS" : "FAIL", name);
+  if (!isPassed) {
+    ++failureCount;
+  }
+}
+
+/**
+ * @brief Render a sustained note through the resampler.
+ * @param[in] settings Output stage.
+ * @return Samples of left channel in output rate.
+ */
+std::vector<float> renderThroughResampler(
+    const sc::OutputStageSettings& settings) {
+  audio::FmAudioSource source(audio::FmAudioSource::kDefaultChipCount);
+  audio::PolyphaseResampler resampler(&source);
+  resampler.prepareToPlay(kBlockSize, kSampleRate);
+  resampler.setOutputStage(settings);
+
+  source.tryReserveChangeFromMidiMessage(
+      juce::MidiMessage::noteOn(1, kNoteNumber, std::uint8_t{100}));
+  source.triggerReservedChanges();
+
+  juce::AudioBuffer<float> buffer(2, kBlockSize);
+  const juce::AudioSourceChannelInfo channelInfo(&buffer, 0, kBlockSize);
+  std::vector<float> output;
+  for (int i = 0; i < kBlockCount; ++i) {
+    resampler.getNextAudioBlock(channelInfo);
+    const float* left = buffer.getReadPointer(0);
+    output.insert(output.end(), left, left + kBlockSize);
+  }
+  return output;
+}
+
+/**
+ * @brief Get the maximum absolute value.
+ * @param[in] samples Samples.
+ * @return Peak.
+ */
+float peakOf(const std::vector<float>& samples) {
+  float peak{};
+  for (const float sample : samples) {
+    peak = std::max(peak, std::abs(sample));
+  }
+  return peak;
+}
+
+/**
+ * @brief Get the maximum absolute difference.
+ * @param[in] a Samples.
+ * @param[in] b Samples of the same length as @c a.
+ * @return Difference.
+ */
+float maxDifferenceOf(const std::vector<float>& a,
+                      const std::vector<float>& b) {
+  float difference{};
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    difference = std::max(difference, std::abs(a[i] - b[i]));
+  }
+  return difference;
+}
+
+/**
+ * @brief Check the output stage applied to output of the resampler.
+ */
+void testResamplerOutput() {
+  const auto reference = renderThroughResampler({});
+  const float peak = peakOf(reference);
+  check(0.f < peak, "resampler outputs the note");
+
+  // Gain is linear, so it scales the resampled output exactly.
+  constexpr float kGainDecibels{-6.f};
+  const float gain = std::pow(10.f, kGainDecibels / 20.f);
+  auto expected = reference;
+  for (auto& sample : expected) {
+    sample *= gain;
+  }
+  check(maxDifferenceOf(renderThroughResampler({.gainDecibels = kGainDecibels}),
+                        expected) <= kTolerance * peak,
+        "gain scales resampled output");
+
+  // The DC blocker changes output, but not a tone far above its cutoff.
+  const auto blocked = renderThroughResampler({.isDcBlockerEnabled = true});
+  const auto sumOfSquaresOf = [](const std::vector<float>& samples) {
+    return std::inner_product(samples.begin(), samples.end(), samples.begin(),
+                              0.);
+  };
+  const double energyRatio =
+      sumOfSquaresOf(blocked) / sumOfSquaresOf(reference);
+  check(kTolerance * peak < maxDifferenceOf(blocked, reference),
+        "DC blocker changes resampled output");
+  check(0.8 < energyRatio && energyRatio < 1.25,
+        "DC blocker keeps the tone");
+
+  // The soft clipper never exceeds full scale before resampling, and the
+  // resampler adds only a small overshoot.
+  constexpr float kLoudGainDecibels{24.f};
+  const auto loud =
+      renderThroughResampler({.gainDecibels = kLoudGainDecibels});
+  const auto clipped = renderThroughResampler(
+      {.gainDecibels = kLoudGainDecibels, .isSoftClipEnabled = true});
+  check(peakOf(clipped) < 1.1f && peakOf(clipped) <= peakOf(loud),
+        "soft clipper limits resampled output");
+}
+
+/**
+ * @brief Check that the DC blocker removes a constant offset.
+ */
+void testDcRemoval() {
+  constexpr double kInputRate{55466.};
+  constexpr std::size_t kFrameCount{static_cast<std::size_t>(kInputRate)};
+  constexpr std::int32_t kOffset{8192};
+
+  std::vector<ymfm::ym2608::output_data> input(kFrameCount);
+  for (auto& frame : input) {
+    frame.data[0] = kOffset;
+    frame.data[1] = -kOffset;
+    frame.data[2] = 0;
+  }
+
+  const sc::OutputStage stage({.isDcBlockerEnabled = true}, 1.f, kInputRate);
+  sc::OutputStageState state;
+  sc::StereoLevel level;
+  std::vector<float> left(kFrameCount);
+  std::vector<float> right(kFrameCount);
+  sc::deinterleave(input.data(), kFrameCount, left.data(), right.data(),
+                   stage, state, level);
+
+  // One second is about 30 time constants of the filter.
+  check(std::abs(left.back()) < 1e-3f * kOffset &&
+            std::abs(right.back()) < 1e-3f * kOffset,
+        "DC blocker removes offset");
+}
+}  // namespace
+
+int main() {
+  testResamplerOutput();
+  testDcRemoval();
+
+  return failureCount ? 1 : 0;
+}